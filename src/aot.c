@@ -0,0 +1,111 @@
+#include "aot.h"
+#include "rom.h"
+
+// 已登记的程序，只在启动时（构造函数中）写入
+static const CHIP8_AOT_PROGRAM *chip8_aot_programs[CHIP8_AOT_MAX_PROGRAMS];
+static int chip8_aot_count;
+
+/**
+ * chip8_aot_register 登记一个预编译程序，由 chip8_aotc 生成的构造函数在 main 之前调用。
+ * 超过 CHIP8_AOT_MAX_PROGRAMS 的程序被忽略，这些 ROM 按 CACHE 引擎执行。
+ *
+ * @param program 预编译程序，生存期为整个进程
+ */
+void chip8_aot_register(const CHIP8_AOT_PROGRAM *program)
+{
+    if (chip8_aot_count < CHIP8_AOT_MAX_PROGRAMS)
+        chip8_aot_programs[chip8_aot_count++] = program;
+}
+
+/**
+ * chip8_aot_find 查找为内容相同的 ROM 生成的预编译程序。
+ *
+ * @param data ROM 内容
+ * @param size ROM 字节数
+ * @return 匹配的程序，没有时返回 NULL
+ */
+const CHIP8_AOT_PROGRAM *chip8_aot_find(const byte *data, size_t size)
+{
+    if (chip8_aot_count == 0)
+        return NULL;
+    qword hash = chip8_rom_hash(data, size);
+    for (int i = 0; i < chip8_aot_count; i++)
+    {
+        const CHIP8_AOT_PROGRAM *program = chip8_aot_programs[i];
+        if (program->hash == hash && program->size == size && memcmp(program->rom, data, size) == 0)
+            return program;
+    }
+    return NULL;
+}
+
+/**
+ * chip8_aot_attach 为刚加载的 ROM 选择预编译程序，由 chip8_load_buffer 调用。
+ * 之后 chip8_load_buffer 对整个 ROM 区调用 chip8_invalidate_code，重新计算过期标记。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param data ROM 内容
+ * @param size ROM 字节数
+ */
+void chip8_aot_attach(CHIP8 *chip8, const byte *data, size_t size)
+{
+    chip8->aot = chip8_aot_find(data, size);
+    memset(chip8->aot_stale, 0, sizeof(chip8->aot_stale));
+}
+
+/**
+ * chip8_aot_invalidate 重新判断覆盖 [addr, addr+len) 的粒度是否过期：
+ * 粒度中属于编译过的指令的字节与编译时的内容不同即为过期，数据和 ROM 以外的字节不影响预编译代码。
+ * 内容被写回原样时清除过期标记。调用者保证 addr + len 不越过内存末尾。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针，chip8->aot 不为 NULL
+ * @param addr 被写入的起始地址
+ * @param len 被写入的字节数
+ */
+void chip8_aot_invalidate(CHIP8 *chip8, word addr, word len)
+{
+    const CHIP8_AOT_PROGRAM *program = chip8->aot;
+    dword rom_end = CHIP8_MEMORY_START_ADDR + program->size;
+    dword last = ((dword)addr + len - 1) / CHIP8_AOT_GRANULE;
+    for (dword g = addr / CHIP8_AOT_GRANULE; g <= last; g++)
+    {
+        dword lo = g * CHIP8_AOT_GRANULE, hi = lo + CHIP8_AOT_GRANULE;
+        if (lo < CHIP8_MEMORY_START_ADDR)
+            lo = CHIP8_MEMORY_START_ADDR;
+        if (hi > rom_end)
+            hi = rom_end;
+        int stale = 0;
+        for (dword i = lo; i < hi && !stale; i++)
+            stale = program->code[i - CHIP8_MEMORY_START_ADDR] && chip8->memory[i] != program->rom[i - CHIP8_MEMORY_START_ADDR];
+        qword bit = 1ULL << (g & 63);
+        if (stale)
+            chip8->aot_stale[g >> 6] |= bit;
+        else
+            chip8->aot_stale[g >> 6] &= ~bit;
+    }
+}
+
+/**
+ * chip8_aot_run 执行预编译代码，pc 不在任何有效块的起点时由参考实现逐条执行，
+ * 直到回到某个块的起点。发生故障时执行完故障指令即返回。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针，chip8->aot 不为 NULL
+ * @param cycles 要执行的指令数
+ * @return 执行的指令数，没有发生故障时等于 cycles
+ */
+dword chip8_aot_run(CHIP8 *chip8, dword cycles)
+{
+    chip8_aot_func run = chip8->aot->run;
+    dword n = 0;
+    while (n < cycles && chip8->error == CHIP8_OK)
+    {
+        // 预编译代码自己更新 cycles
+        n += run(chip8, cycles - n);
+        // 离开了编译过的代码，解释一条指令（chip8_emulate_cycle 自己累加 cycles）
+        if (n < cycles && chip8->error == CHIP8_OK)
+        {
+            chip8_emulate_cycle(chip8);
+            n++;
+        }
+    }
+    return n;
+}
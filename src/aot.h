@@ -0,0 +1,74 @@
+#ifndef __AOT_H__
+#define __AOT_H__
+#include "chip8.h"
+
+/// ******************************预编译（AOT）程序******************************** ///
+// chip8_aotc 离线分析一个 ROM 的控制流，把能静态确定的代码翻译成一个 C 函数：
+// 每个基本块一个标签，简单指令直接写成 C 语句，其余指令调用 opcode.c 中的处理函数，
+// 目标已知的跳转、调用和跳过直接 goto 到目标块，没有取指、译码和分派。
+// 生成的文件与核心库一起编译链接，启动时通过构造函数登记；之后加载内容相同的 ROM
+// （按 chip8_rom_hash 和大小匹配）的实例选择 CHIP8_ENGINE_AOT 时就执行预编译代码。
+//
+// 目标无法静态确定的地方（BNNN、00EE 返回到的地址以外的位置、没有编译的地址）
+// 回到运行时，由解释器逐条执行，直到 pc 回到某个块的起点。
+// 程序写内存时 chip8_invalidate_code 把编译过的指令字节与编译时不同的 16 字节粒度标记为过期
+// （只比较指令字节，与代码相邻的数据被改写不影响代码），
+// 覆盖过期粒度的块不再进入，同样由解释器执行；内容恢复原样后块重新生效。
+//
+// 生成的代码在每条指令之前检查预算，一次调用执行到预算用完、离开编译过的代码或发生故障为止，
+// 返回执行的指令数。与其他引擎一样，调用处理函数之前和返回时把 cycles 写回为已执行的指令数。
+
+// 生成的程序入口：从 chip8->pc 开始执行至多 budget 条指令，返回执行的条数。
+// pc 不是任何块的起点或所在块已过期时返回 0
+typedef dword (*chip8_aot_func)(CHIP8 *chip8, dword budget);
+
+typedef struct chip8_aot_program
+{
+    const char *name;                // ROM 名称
+    qword hash;                      // 编译时 ROM 的 chip8_rom_hash
+    dword size;                      // ROM 字节数
+    const byte *rom;                 // 编译时的 ROM 内容，用于判断内存是否被改写
+    const byte *code;                // 每个 ROM 字节是否属于编译过的指令
+    chip8_aot_func run;              // 程序入口
+    dword blocks;                    // 基本块数
+    dword insns;                     // 编译的指令数
+} CHIP8_AOT_PROGRAM;
+
+// 最多登记的程序数
+#define CHIP8_AOT_MAX_PROGRAMS 64
+
+void chip8_aot_register(const CHIP8_AOT_PROGRAM *program);             // 登记程序（由生成的代码在启动时调用）
+const CHIP8_AOT_PROGRAM *chip8_aot_find(const byte *data, size_t size); // 查找与 ROM 内容匹配的程序，没有时返回 NULL
+
+/// 生成代码使用的宏
+// 块入口：覆盖的粒度过期时回到运行时（stale 为这些粒度在 aot_stale 中的检查表达式）
+#define CHIP8_AOT_ENTER(addr, stale)                            \
+    do {                                                        \
+        if (stale)                                              \
+        {                                                       \
+            chip8->pc = (addr);                                 \
+            goto out;                                           \
+        }                                                       \
+    } while (0)
+// 执行 addr 处的指令之前：预算用完时停在这里，否则计数并记下操作码（n 为本次调用已执行的条数）
+#define CHIP8_AOT_STEP(addr, op)                                \
+    do {                                                        \
+        if (n == budget)                                        \
+        {                                                       \
+            chip8->pc = (addr);                                 \
+            goto out;                                           \
+        }                                                       \
+        n++;                                                    \
+        chip8->opcode = (op);                                   \
+    } while (0)
+// 调用处理函数：pc 与解释器取指之后相同，cycles 为这条指令之前的指令数（base 为进入时的 cycles）
+#define CHIP8_AOT_CALL(addr, N)                                 \
+    do {                                                        \
+        chip8->pc = (word)((addr) + 2);                         \
+        chip8->cycles = base + n - 1;                           \
+        opcode_##N(chip8);                                      \
+    } while (0)
+#define CHIP8_AOT_V(x) (chip8->registers[(x)])
+/// ****************************************************************************** ///
+
+#endif
@@ -0,0 +1,412 @@
+#include "aot.h"
+#include "rom.h"
+#include <ctype.h>
+#include <getopt.h>
+
+/// *****************************预编译器 chip8_aotc****************************** ///
+// 把一个 ROM 翻译成 C 源文件（格式见 aot.h），与核心库一起编译链接后
+// CHIP8_ENGINE_AOT 执行翻译出的代码。
+//
+// 控制流分析从 0x200 开始，沿着能静态确定的边找出所有可达的基本块：
+//   顺序执行            -> 下一条指令
+//   1NNN                -> NNN
+//   2NNN                -> NNN 和返回地址（下一条指令，00EE 返回到这里）
+//   条件跳过            -> 下一条和再下一条指令
+//   FX0A                -> 自身（没有按键时重复执行）和下一条指令
+//   FX33/FX55           -> 下一条指令，写内存后结束基本块，之后的代码重新检查是否过期
+//   00EE、BNNN          -> 运行时按 pc 查找块的起点
+// 只翻译完全位于 ROM 之内的指令；块的起点可以落在已有块的中间，这时两个块各有一份代码。
+#define AOTC_NAME_MAX 64
+// 每个块最多的指令数，块越长过期检查覆盖的范围越大
+#define AOTC_BLOCK_MAX 32
+
+// 一个基本块
+struct aotc_block
+{
+    word start;
+    word count;                      // 指令数
+};
+
+static struct
+{
+    const byte *rom;
+    dword size;
+    byte leader[CHIP8_MEMORY_SIZE];  // 已经是（或排队成为）块的起点
+    byte code[CHIP8_MEMORY_SIZE];    // 属于翻译过的指令的字节
+    word queue[CHIP8_MEMORY_SIZE];   // 待翻译的块起点
+    dword queued;
+    struct aotc_block blocks[CHIP8_MEMORY_SIZE];
+    dword block_count;
+    dword insns;
+} aotc;
+
+#define AOTC_OP_NAME(N) #N,
+static const char *aotc_op_names[CHIP8_OP_COUNT] = {
+    CHIP8_OPCODE_LIST(AOTC_OP_NAME)
+};
+
+// addr 处的指令是否完全位于 ROM 之内
+static int aotc_in_rom(dword addr)
+{
+    return addr >= CHIP8_MEMORY_START_ADDR && addr + 2 <= CHIP8_MEMORY_START_ADDR + aotc.size;
+}
+
+static word aotc_opcode(dword addr)
+{
+    const byte *p = aotc.rom + (addr - CHIP8_MEMORY_START_ADDR);
+    return (word)((p[0] << 8) | p[1]);
+}
+
+// 条件跳过指令
+static int aotc_is_skip(enum chip8_op op)
+{
+    return op == CHIP8_OP_3XNN || op == CHIP8_OP_4XNN || op == CHIP8_OP_5XY0 || op == CHIP8_OP_9XY0 ||
+           op == CHIP8_OP_EX9E || op == CHIP8_OP_EXA1;
+}
+
+// 结束基本块的指令：改变 pc 或写内存
+static int aotc_ends_block(enum chip8_op op)
+{
+    return aotc_is_skip(op) || op == CHIP8_OP_1NNN || op == CHIP8_OP_2NNN || op == CHIP8_OP_00EE ||
+           op == CHIP8_OP_BNNN || op == CHIP8_OP_FX0A || op == CHIP8_OP_FX33 || op == CHIP8_OP_FX55;
+}
+
+// 静态已知的后继，返回个数
+static int aotc_successors(dword addr, word opcode, dword succ[2])
+{
+    enum chip8_op op = chip8_decode(opcode);
+    if (op == CHIP8_OP_1NNN)
+    {
+        succ[0] = NNN(opcode);
+        return 1;
+    }
+    if (op == CHIP8_OP_2NNN)
+    {
+        succ[0] = NNN(opcode);
+        succ[1] = addr + 2;
+        return 2;
+    }
+    if (aotc_is_skip(op))
+    {
+        succ[0] = addr + 2;
+        succ[1] = addr + 4;
+        return 2;
+    }
+    if (op == CHIP8_OP_FX0A)
+    {
+        succ[0] = addr;
+        succ[1] = addr + 2;
+        return 2;
+    }
+    if (op == CHIP8_OP_00EE || op == CHIP8_OP_BNNN)
+        return 0;
+    succ[0] = addr + 2;
+    return 1;
+}
+
+// 把 addr 加入块起点，ROM 之外的地址不翻译
+static void aotc_add_leader(dword addr)
+{
+    if (!aotc_in_rom(addr) || aotc.leader[addr])
+        return;
+    aotc.leader[addr] = 1;
+    aotc.queue[aotc.queued++] = (word)addr;
+}
+
+// 控制流分析：找出所有可达的基本块
+static void aotc_analyze(void)
+{
+    aotc_add_leader(CHIP8_MEMORY_START_ADDR);
+    for (dword q = 0; q < aotc.queued; q++)
+    {
+        dword start = aotc.queue[q], addr = start;
+        word count = 0;
+        for (;;)
+        {
+            word opcode = aotc_opcode(addr);
+            aotc.code[addr] = aotc.code[addr + 1] = 1;
+            count++;
+            if (aotc_ends_block(chip8_decode(opcode)))
+            {
+                dword succ[2];
+                int k = aotc_successors(addr, opcode, succ);
+                for (int i = 0; i < k; i++)
+                    aotc_add_leader(succ[i]);
+                break;
+            }
+            addr += 2;
+            // 顺序执行进入另一个块、达到长度上限或离开 ROM
+            if (!aotc_in_rom(addr) || aotc.leader[addr] || count == AOTC_BLOCK_MAX)
+            {
+                aotc_add_leader(addr);
+                break;
+            }
+        }
+        aotc.blocks[aotc.block_count].start = (word)start;
+        aotc.blocks[aotc.block_count].count = count;
+        aotc.block_count++;
+        aotc.insns += count;
+    }
+}
+
+// 转到 addr：翻译过的地址直接跳到块，否则回到运行时
+static void aotc_emit_goto(FILE *out, dword addr)
+{
+    if (aotc_in_rom(addr))
+        fprintf(out, "goto L_%03X;\n", addr);
+    else
+        fprintf(out, "{ chip8->pc = 0x%03X; goto out; }\n", addr);
+}
+
+// 块覆盖的粒度的过期检查表达式
+static void aotc_emit_stale(FILE *out, const struct aotc_block *block)
+{
+    dword first = block->start / CHIP8_AOT_GRANULE;
+    dword last = (block->start + 2u * block->count - 1) / CHIP8_AOT_GRANULE;
+    const char *sep = "";
+    for (dword w = first >> 6; w <= last >> 6; w++)
+    {
+        qword mask = 0;
+        for (dword g = first; g <= last; g++)
+            if (g >> 6 == w)
+                mask |= 1ULL << (g & 63);
+        fprintf(out, "%s(chip8->aot_stale[%u] & 0x%llXULL)", sep, w, (unsigned long long)mask);
+        sep = " || ";
+    }
+}
+
+// 翻译 addr 处的一条指令，返回非 0 表示指令已经转到了别处
+static int aotc_emit_insn(FILE *out, dword addr, word opcode)
+{
+    enum chip8_op op = chip8_decode(opcode);
+    byte x = X(opcode), y = Y(opcode), nn = NN(opcode);
+    fprintf(out, "    CHIP8_AOT_STEP(0x%03X, 0x%04X);\n", addr, opcode);
+    switch (op) {
+        case CHIP8_OP_1NNN:
+            fprintf(out, "    ");
+            aotc_emit_goto(out, NNN(opcode));
+            return 1;
+        case CHIP8_OP_3XNN:
+        case CHIP8_OP_4XNN:
+        case CHIP8_OP_5XY0:
+        case CHIP8_OP_9XY0:
+        {
+            char rhs[32];
+            if (op == CHIP8_OP_3XNN || op == CHIP8_OP_4XNN)
+                snprintf(rhs, sizeof(rhs), "0x%02X", nn);
+            else
+                snprintf(rhs, sizeof(rhs), "CHIP8_AOT_V(%u)", y);
+            const char *cmp = op == CHIP8_OP_3XNN || op == CHIP8_OP_5XY0 ? "==" : "!=";
+            fprintf(out, "    if (CHIP8_AOT_V(%u) %s %s) ", x, cmp, rhs);
+            aotc_emit_goto(out, addr + 4);
+            fprintf(out, "    ");
+            aotc_emit_goto(out, addr + 2);
+            return 1;
+        }
+        // 以下与 opcode.c 中的处理函数逐句对应，VF 的写入顺序相同（X 或 Y 为 F 时结果一致）
+        case CHIP8_OP_6XNN:
+            fprintf(out, "    CHIP8_AOT_V(%u) = 0x%02X;\n", x, nn);
+            return 0;
+        case CHIP8_OP_7XNN:
+            fprintf(out, "    CHIP8_AOT_V(%u) += 0x%02X;\n", x, nn);
+            return 0;
+        case CHIP8_OP_8XY0:
+            fprintf(out, "    CHIP8_AOT_V(%u) = CHIP8_AOT_V(%u);\n", x, y);
+            return 0;
+        case CHIP8_OP_8XY1:
+            fprintf(out, "    CHIP8_AOT_V(%u) |= CHIP8_AOT_V(%u);\n", x, y);
+            return 0;
+        case CHIP8_OP_8XY2:
+            fprintf(out, "    CHIP8_AOT_V(%u) &= CHIP8_AOT_V(%u);\n", x, y);
+            return 0;
+        case CHIP8_OP_8XY3:
+            fprintf(out, "    CHIP8_AOT_V(%u) ^= CHIP8_AOT_V(%u);\n", x, y);
+            return 0;
+        case CHIP8_OP_8XY4:
+            fprintf(out, "    { word t = (word)(CHIP8_AOT_V(%u) + CHIP8_AOT_V(%u)); CHIP8_AOT_V(%u) = (byte)t; "
+                         "CHIP8_AOT_V(15) = (byte)(t >> 8); }\n", x, y, x);
+            return 0;
+        case CHIP8_OP_8XY5:
+            fprintf(out, "    CHIP8_AOT_V(15) = CHIP8_AOT_V(%u) > CHIP8_AOT_V(%u); CHIP8_AOT_V(%u) -= CHIP8_AOT_V(%u);\n",
+                    x, y, x, y);
+            return 0;
+        case CHIP8_OP_8XY6:
+            fprintf(out, "    CHIP8_AOT_V(15) = CHIP8_AOT_V(%u) & 1; CHIP8_AOT_V(%u) = CHIP8_AOT_V(%u) >> 1;\n", x, x, x);
+            return 0;
+        case CHIP8_OP_8XY7:
+            fprintf(out, "    CHIP8_AOT_V(15) = CHIP8_AOT_V(%u) < CHIP8_AOT_V(%u); "
+                         "CHIP8_AOT_V(%u) = (byte)(CHIP8_AOT_V(%u) - CHIP8_AOT_V(%u));\n", x, y, x, y, x);
+            return 0;
+        case CHIP8_OP_8XYE:
+            fprintf(out, "    CHIP8_AOT_V(15) = CHIP8_AOT_V(%u) >> 7; CHIP8_AOT_V(%u) = (byte)(CHIP8_AOT_V(%u) << 1);\n",
+                    x, x, x);
+            return 0;
+        case CHIP8_OP_ANNN:
+            fprintf(out, "    chip8->index_register = 0x%03X;\n", NNN(opcode));
+            return 0;
+        case CHIP8_OP_FX1E:
+            fprintf(out, "    chip8->index_register += CHIP8_AOT_V(%u);\n", x);
+            return 0;
+        default:
+            break;
+    }
+
+    // 其余指令调用处理函数
+    fprintf(out, "    CHIP8_AOT_CALL(0x%03X, %s);\n", addr, aotc_op_names[op]);
+    if (op == CHIP8_OP_FX33 || op == CHIP8_OP_FX55)
+    {
+        fprintf(out, "    ");
+        aotc_emit_goto(out, addr + 2);
+        return 1;
+    }
+    if (!aotc_ends_block(op))
+        return 0;
+    // 调用栈溢出或为空时 pc 回到指令本身，停下来交给运行时
+    if (op == CHIP8_OP_2NNN || op == CHIP8_OP_00EE)
+        fprintf(out, "    if (chip8->error != CHIP8_OK) goto out;\n");
+    // 处理函数改变了 pc：已知的后继直接跳转
+    dword succ[2];
+    int k = aotc_successors(addr, opcode, succ);
+    for (int i = 0; i < k; i++)
+        if (aotc_in_rom(succ[i]))
+            fprintf(out, "    if (chip8->pc == 0x%03X) goto L_%03X;\n", succ[i], succ[i]);
+    fprintf(out, "    goto dispatch;\n");
+    return 1;
+}
+
+static void aotc_emit(FILE *out, const char *name, const char *id)
+{
+    fprintf(out, "// 由 chip8_aotc 从 %s 生成，不要手工修改\n", name);
+    fprintf(out, "// %u 个基本块，%u 条指令\n", aotc.block_count, aotc.insns);
+    fprintf(out, "#include \"aot.h\"\n\n");
+
+    fprintf(out, "static const byte chip8_aot_%s_rom[%u] = {", id, aotc.size);
+    for (dword i = 0; i < aotc.size; i++)
+        fprintf(out, "%s0x%02X,", i % 16 ? " " : "\n    ", aotc.rom[i]);
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "static const byte chip8_aot_%s_code[%u] = {", id, aotc.size);
+    for (dword i = 0; i < aotc.size; i++)
+        fprintf(out, "%s%u,", i % 32 ? " " : "\n    ", aotc.code[CHIP8_MEMORY_START_ADDR + i]);
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static dword chip8_aot_%s_run(CHIP8 *chip8, dword budget)\n{\n", id);
+    fprintf(out, "    qword base = chip8->cycles;\n    dword n = 0;\ndispatch:\n    switch (chip8->pc) {\n");
+    for (dword b = 0; b < aotc.block_count; b++)
+        fprintf(out, "        case 0x%03X: goto L_%03X;\n", aotc.blocks[b].start, aotc.blocks[b].start);
+    fprintf(out, "        default: goto out;\n    }\n");
+
+    for (dword b = 0; b < aotc.block_count; b++)
+    {
+        const struct aotc_block *block = &aotc.blocks[b];
+        fprintf(out, "\nL_%03X:\n    CHIP8_AOT_ENTER(0x%03X, ", block->start, block->start);
+        aotc_emit_stale(out, block);
+        fprintf(out, ");\n");
+        dword addr = block->start;
+        int left = 0;
+        for (word i = 0; i < block->count; i++, addr += 2)
+            left = aotc_emit_insn(out, addr, aotc_opcode(addr));
+        // 顺序执行进入下一个块或离开 ROM
+        if (!left)
+        {
+            fprintf(out, "    ");
+            aotc_emit_goto(out, addr);
+        }
+    }
+    fprintf(out, "\nout:\n    chip8->cycles = base + n;\n    return n;\n}\n\n");
+
+    fprintf(out, "static const CHIP8_AOT_PROGRAM chip8_aot_%s = {\n", id);
+    fprintf(out, "    \"");
+    for (const char *p = name; *p; p++)
+        fprintf(out, *p == '"' || *p == '\\' ? "\\%c" : "%c", *p);
+    fprintf(out, "\", 0x%016llXULL, %u, chip8_aot_%s_rom, chip8_aot_%s_code, chip8_aot_%s_run, %u, %u\n};\n\n",
+            (unsigned long long)chip8_rom_hash(aotc.rom, aotc.size), aotc.size, id, id, id,
+            aotc.block_count, aotc.insns);
+    fprintf(out, "__attribute__((constructor)) static void chip8_aot_%s_register(void)\n{\n", id);
+    fprintf(out, "    chip8_aot_register(&chip8_aot_%s);\n}\n", id);
+}
+
+static void aotc_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n name] [-o out.c] rom\n"
+                    "  -n  program name, also used for C identifiers (default: ROM file name)\n"
+                    "  -o  output file (default stdout)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = NULL;
+    const char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:o:h")) != -1)
+    {
+        switch (opt) {
+            case 'n':
+                name = optarg;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            default:
+                aotc_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        aotc_usage(argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[optind];
+    CHIP8_ROM rom;
+    int error = chip8_rom_open(&rom, path);
+    if (error != CHIP8_OK)
+    {
+        fprintf(stderr, "cannot read ROM %s: %s\n", path, chip8_error_string((enum chip8_error)error));
+        return 1;
+    }
+    if (rom.size < 2)
+    {
+        fprintf(stderr, "ROM %s is shorter than one instruction\n", path);
+        chip8_rom_close(&rom);
+        return 1;
+    }
+    aotc.rom = rom.data;
+    aotc.size = (dword)rom.size;
+
+    // 默认名称取文件名去掉目录和扩展名
+    char base[AOTC_NAME_MAX], id[AOTC_NAME_MAX];
+    if (name == NULL)
+    {
+        const char *slash = strrchr(path, '/');
+        snprintf(base, sizeof(base), "%s", slash ? slash + 1 : path);
+        char *dot = strrchr(base, '.');
+        if (dot != NULL && dot != base)
+            *dot = '\0';
+        name = base;
+    }
+    // C 标识符：非字母数字的字符换成下划线
+    snprintf(id, sizeof(id), "%s", name);
+    for (char *p = id; *p; p++)
+        if (!isalnum((unsigned char)*p))
+            *p = '_';
+
+    aotc_analyze();
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", out_path);
+        return 1;
+    }
+    aotc_emit(out, name, id);
+    if (out != stdout && fclose(out) != 0)
+    {
+        fprintf(stderr, "cannot write %s\n", out_path);
+        return 1;
+    }
+    fprintf(stderr, "%s: %u blocks, %u instructions of %u bytes\n", name, aotc.block_count, aotc.insns, aotc.size);
+    chip8_rom_close(&rom);
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "audio.h"
+#include "sched.h"
+#include <math.h>
+#include <SDL2/SDL.h>
+
+/// ******************************SDL 音频后端************************************ ///
+// 一个发声区间：[on, off) 指令周期
+typedef struct chip8_audio_segment
+{
+    qword on;
+    qword off;
+} CHIP8_AUDIO_SEGMENT;
+
+static struct
+{
+    SDL_AudioDeviceID device;        // 0 表示未打开
+    float table[CHIP8_AUDIO_TABLE_SIZE]; // 一个周期的带限方波，峰值为 1
+    double phase_step;               // 每个采样在波形表中前进的位置
+    double cycles_per_sample;        // 每个采样对应的指令周期数
+    double ramp_step;                // 每个采样包络变化量
+    double window;                   // 同步窗口（指令周期）
+    qword buffer_ns;                 // 回调缓冲区时长
+
+    // 模拟线程 -> 回调
+    CHIP8_AUDIO_SEGMENT segments[CHIP8_AUDIO_SEGMENTS];
+    _Atomic dword head;              // 下一个写入位置（模拟线程）
+    _Atomic dword tail;              // 下一个读取位置（回调）
+
+    // 只由模拟线程访问
+    qword last_deadline;             // 上次看到的 sound_deadline
+    qword last_cycles;               // 上次调用 update_audio 时的 cycles
+
+    // 只由回调访问
+    CHIP8_AUDIO_SEGMENT segment;     // 当前区间
+    double position;                 // 播放位置（指令周期）
+    double phase;                    // 波形表中的位置
+    double envelope;                 // 包络 0-1
+    qword last_callback;             // 上次回调的时刻
+
+    _Atomic qword callbacks;
+    _Atomic qword underruns;
+    _Atomic qword dropped;
+    _Atomic qword resyncs;
+} audio;
+
+// 以奇次谐波叠加出带限方波：只保留低于奈奎斯特频率的谐波，并用 Lanczos σ 因子抑制吉布斯振铃
+static void audio_build_table(int rate)
+{
+    int harmonics = rate / 2 / CHIP8_AUDIO_TONE_HZ;
+    float peak = 0.0f;
+    for (int i = 0; i < CHIP8_AUDIO_TABLE_SIZE; i++)
+    {
+        double x = 2.0 * M_PI * i / CHIP8_AUDIO_TABLE_SIZE;
+        double v = 0.0;
+        for (int k = 1; k <= harmonics; k += 2)
+        {
+            double s = M_PI * k / (harmonics + 1);
+            v += sin(k * x) / k * (sin(s) / s);
+        }
+        audio.table[i] = (float)v;
+        if (fabsf(audio.table[i]) > peak)
+            peak = fabsf(audio.table[i]);
+    }
+    for (int i = 0; i < CHIP8_AUDIO_TABLE_SIZE; i++)
+        audio.table[i] /= peak;
+}
+
+// 查看下一个未取出的区间，没有时返回 NULL
+static const CHIP8_AUDIO_SEGMENT *audio_peek(void)
+{
+    dword tail = atomic_load_explicit(&audio.tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&audio.head, memory_order_acquire))
+        return NULL;
+    return &audio.segments[tail & (CHIP8_AUDIO_SEGMENTS - 1)];
+}
+
+static void audio_callback(void *userdata, Uint8 *stream, int len)
+{
+    (void)userdata;
+    int16_t *out = (int16_t *)stream;
+    int count = len / (int)sizeof(int16_t);
+
+    qword now = chip8_sched_now();
+    if (audio.last_callback != 0 && now - audio.last_callback > audio.buffer_ns * 3 / 2)
+        atomic_fetch_add_explicit(&audio.underruns, 1, memory_order_relaxed);
+    audio.last_callback = now;
+    atomic_fetch_add_explicit(&audio.callbacks, 1, memory_order_relaxed);
+
+    // 下一个区间与播放位置相差过远（暂停、回退、加速之后），对齐到它的起点
+    const CHIP8_AUDIO_SEGMENT *next = audio_peek();
+    if (next != NULL && fabs((double)next->on - audio.position) > audio.window)
+    {
+        audio.position = (double)next->on;
+        atomic_fetch_add_explicit(&audio.resyncs, 1, memory_order_relaxed);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        while ((next = audio_peek()) != NULL && (double)next->on <= audio.position)
+        {
+            audio.segment = *next;
+            atomic_store_explicit(&audio.tail, atomic_load_explicit(&audio.tail, memory_order_relaxed) + 1,
+                                  memory_order_release);
+        }
+        byte gate = audio.position >= (double)audio.segment.on && audio.position < (double)audio.segment.off;
+        audio.envelope += gate ? audio.ramp_step : -audio.ramp_step;
+        if (audio.envelope < 0.0)
+            audio.envelope = 0.0;
+        else if (audio.envelope > 1.0)
+            audio.envelope = 1.0;
+
+        // 波形表线性插值
+        int index = (int)audio.phase;
+        double frac = audio.phase - index;
+        float a = audio.table[index];
+        float b = audio.table[(index + 1) & (CHIP8_AUDIO_TABLE_SIZE - 1)];
+        double sample = (a + (b - a) * frac) * audio.envelope * CHIP8_AUDIO_VOLUME;
+        out[i] = (int16_t)(sample * 32767.0);
+
+        audio.phase += audio.phase_step;
+        if (audio.phase >= CHIP8_AUDIO_TABLE_SIZE)
+            audio.phase -= CHIP8_AUDIO_TABLE_SIZE;
+        audio.position += audio.cycles_per_sample;
+    }
+}
+
+/**
+ * init_audio 打开音频设备并开始播放（静音直到第一个发声区间）。
+ *
+ * @param samples 回调缓冲区大小（采样数）
+ * @return 成功返回 0，失败返回 1
+ */
+byte init_audio(int samples)
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+    {
+        fprintf(stderr, "SDL audio init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_AudioSpec want, have;
+    memset(&want, 0, sizeof(want));
+    want.freq = CHIP8_AUDIO_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = (Uint16)samples;
+    want.callback = audio_callback;
+    audio.device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (audio.device == 0)
+    {
+        fprintf(stderr, "SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return 1;
+    }
+    audio_build_table(have.freq);
+    audio.phase_step = (double)CHIP8_AUDIO_TONE_HZ * CHIP8_AUDIO_TABLE_SIZE / have.freq;
+    audio.cycles_per_sample = (double)CHIP8_CYCLES_FREQ_HZ / have.freq;
+    audio.ramp_step = 1000.0 / (CHIP8_AUDIO_RAMP_MS * have.freq);
+    audio.buffer_ns = (qword)have.samples * 1000000000ULL / (qword)have.freq;
+    // 至少 4 帧，且不小于两个回调缓冲区，否则正常的回调抖动也会触发对齐
+    audio.window = 4.0 * CHIP8_CYCLES_PER_FRAME;
+    if (audio.window < 2.0 * have.samples * audio.cycles_per_sample)
+        audio.window = 2.0 * have.samples * audio.cycles_per_sample;
+    SDL_PauseAudioDevice(audio.device, 0);
+    return 0;
+}
+
+void close_audio()
+{
+    if (audio.device == 0)
+        return;
+    SDL_CloseAudioDevice(audio.device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    audio.device = 0;
+}
+
+/**
+ * update_audio 在每个模拟帧之后调用，发现新的 FX18 时把发声区间交给回调。
+ *
+ * FX18 只修改 sound_deadline，因此比较截止帧号即可发现它；区间从本帧起点开始，
+ * 到截止帧结束。FX18 以 0 停止发声时区间为空，回调会在本帧起点关闭门限。
+ * 不加锁、不等待回调，环形缓冲区满时丢弃。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
+void update_audio(const CHIP8 *chip8)
+{
+    qword begin = audio.last_cycles <= chip8->cycles ? audio.last_cycles : chip8->cycles;
+    audio.last_cycles = chip8->cycles;
+    if (audio.device == 0 || chip8->sound_deadline == audio.last_deadline)
+        return;
+    audio.last_deadline = chip8->sound_deadline;
+
+    CHIP8_AUDIO_SEGMENT segment = { begin, chip8->sound_deadline * CHIP8_CYCLES_PER_FRAME };
+    if (segment.off < segment.on)
+        segment.off = segment.on;
+    dword head = atomic_load_explicit(&audio.head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&audio.tail, memory_order_acquire) >= CHIP8_AUDIO_SEGMENTS)
+    {
+        atomic_fetch_add_explicit(&audio.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    audio.segments[head & (CHIP8_AUDIO_SEGMENTS - 1)] = segment;
+    atomic_store_explicit(&audio.head, head + 1, memory_order_release);
+}
+
+void get_audio_stats(CHIP8_AUDIO_STATS *stats)
+{
+    stats->callbacks = atomic_load_explicit(&audio.callbacks, memory_order_relaxed);
+    stats->underruns = atomic_load_explicit(&audio.underruns, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&audio.dropped, memory_order_relaxed);
+    stats->resyncs = atomic_load_explicit(&audio.resyncs, memory_order_relaxed);
+}
+/// ****************************************************************************** ///
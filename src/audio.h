@@ -0,0 +1,39 @@
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+#include "chip8.h"
+#include <stdatomic.h>
+
+/// ******************************SDL 音频后端************************************ ///
+// 蜂鸣声在 SDL 音频回调中从预先计算的带限方波表合成，回调中不加锁、不分配内存。
+//
+// 发声区间由模拟线程经单生产者单消费者无锁环形缓冲区交给回调：每个区间是
+// [on, off) 两个指令周期时间戳。音频定时器以帧为单位，off 是截止帧的第一条指令，
+// 精确到指令；on 是执行 FX18 的那一帧的第一条指令（定时器本身的分辨率）。
+// 回调按采样推进自己的播放位置（指令周期，每秒 CHIP8_CYCLES_FREQ_HZ 条），
+// 在对应的采样点打开或关闭门限，并用短斜坡消除咔嗒声。模拟暂停、回退或加速后
+// 播放位置与区间相差超过同步窗口时，直接对齐到新区间的起点。
+// 环形缓冲区满时丢弃区间并计数；回调间隔超过缓冲区时长的 1.5 倍记为一次欠载。
+#define CHIP8_AUDIO_RATE 48000       // 请求的采样率
+#define CHIP8_AUDIO_SAMPLES 512      // 默认回调缓冲区（采样数），越小延迟越低、越容易欠载
+#define CHIP8_AUDIO_TONE_HZ 440      // 蜂鸣频率
+#define CHIP8_AUDIO_TABLE_SIZE 2048  // 波形表长度（一个周期）
+#define CHIP8_AUDIO_RAMP_MS 2        // 开关门限的斜坡时长
+#define CHIP8_AUDIO_VOLUME 0.25      // 音量（满幅的比例）
+#define CHIP8_AUDIO_SEGMENTS 64      // 区间环形缓冲区容量（2 的幂）
+
+// 音频统计
+typedef struct chip8_audio_stats
+{
+    qword callbacks;                 // 回调次数
+    qword underruns;                 // 欠载次数
+    qword dropped;                   // 环形缓冲区满时丢弃的区间数
+    qword resyncs;                   // 播放位置重新对齐的次数
+} CHIP8_AUDIO_STATS;
+
+byte init_audio(int samples);             // 打开音频设备，samples 为回调缓冲区大小，失败返回 1
+void close_audio();                       // 关闭音频设备
+void update_audio(const CHIP8 *chip8);    // 每个模拟帧之后调用，把新的发声区间交给回调
+void get_audio_stats(CHIP8_AUDIO_STATS *stats); // 读取统计
+/// ****************************************************************************** ///
+
+#endif
@@ -0,0 +1,718 @@
+#include "chip8.h"
+#include "input.h"
+#include "lanes.h"
+#include "profile.h"
+#include "rom.h"
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/// ******************************无界面批处理运行器******************************* ///
+// 读取任务清单，每行一个任务：
+//   <ROM 路径> <输入脚本路径|-> <指令预算>
+// 路径中含空格时用双引号括起，# 开头为注释，相对路径相对于清单所在目录。
+// 输入可以是 input.h 格式的二进制输入日志（连同录制时的随机数种子一起回放），
+// 也可以是文本脚本，每行一个事件：<指令周期> <按键 0-F> <down|up>，使用默认种子。
+// 清单中每个不同的 ROM 只映射一次，所有引用它的任务共享同一个只读映射；
+// 指定 ROM 库索引（-i）时按 ROM 内容哈希应用其中的兼容性选项；-w 把 -i 读入的条目连同清单中
+// 索引里还没有的 ROM（默认选项，名称取文件名）写入新的索引文件，用于建立或补全 ROM 库索引。
+// -L 把同一 ROM 的任务按清单顺序每 CHIP8_LANE_COUNT 个打包，一包在一个线程中以
+// SIMD 锁步通道（lanes.h）执行，每个任务占一条通道，各自回放输入、各自的预算；
+// 结果与单独执行（关闭空转检测）逐位一致，time_ms 为整包耗时按任务数均分。
+// 以 CHIP8_ENABLE_PROFILE=1 构建时 -P 把每个任务的剖析报告（profile.h）按清单顺序写入文件。
+// 任务分配到工作窃取线程池中执行，全部完成后按清单顺序输出每个任务的
+// 帧缓冲哈希、寄存器状态和耗时。不依赖 SDL。
+
+#define BATCH_PATH_MAX 1024
+
+// 一个已映射的 ROM
+struct batch_rom
+{
+    const char *path;                // ROM 路径（指向第一个引用它的任务）
+    CHIP8_ROM rom;                   // 只读映射
+    enum chip8_error error;          // 映射失败的原因，CHIP8_OK 表示成功
+    byte quirks;                     // ROM 库索引中的兼容性选项，没有时为 0
+};
+
+// 一个批处理任务及其结果
+struct batch_job
+{
+    char rom[BATCH_PATH_MAX];        // ROM 路径
+    struct batch_rom *image;         // 共享的 ROM 映射
+    char input[BATCH_PATH_MAX];      // 输入脚本路径，空串表示无输入
+    qword budget;                    // 指令预算
+
+    // 结果
+    int error;                       // 非 0 表示任务失败
+    char message[128];               // 失败原因
+    qword cycles;                    // 实际执行的指令数
+    qword skipped;                   // 其中空转检测跳过的指令数
+    qword fused;                     // 其中作为超级指令的后续部分执行的指令数
+    enum chip8_error fault;          // ROM 执行中的故障，CHIP8_OK 表示正常
+    char *profile;                   // 剖析报告（一行 JSON），没有时为 NULL
+    qword fb_hash;                   // 最终帧缓冲哈希
+    double wall_ms;                  // 墙钟耗时（毫秒）
+    byte registers[16];
+    word index_register;
+    word pc;
+    byte sp;
+};
+
+// 工作窃取双端队列：任务下标保存在 jobs 中，range 的低 32 位为队头、高 32 位为队尾。
+// 任务在启动前一次性分配，之后只出队不入队，因此队主从队头取、窃取者从队尾取，
+// 两端都用一次 CAS 完成，无需加锁。
+struct batch_deque
+{
+    _Atomic qword range;
+    dword *jobs;
+};
+
+// 锁步模式下一起执行的一组任务，都引用同一个 ROM
+struct batch_pack
+{
+    dword jobs[CHIP8_LANE_COUNT];    // 任务下标，第 i 个任务占第 i 条通道
+    int count;
+};
+
+struct batch_pool
+{
+    struct batch_job *jobs;
+    struct batch_pack *packs;        // 锁步模式下队列中是包下标，否则为 NULL
+    struct batch_deque *deques;
+    int workers;
+    enum chip8_engine engine;
+    byte idle_skip;
+    byte profile;                    // 是否生成剖析报告
+};
+
+// 每个线程复用同一个实例运行它取到的所有任务，任务之间不分配内存
+struct batch_worker
+{
+    struct batch_pool *pool;
+    int id;
+    CHIP8 chip8;
+    CHIP8_INSN icache[CHIP8_ICACHE_SIZE];
+    CHIP8_PROFILE profile;
+    CHIP8_LANES lanes;               // 锁步模式下使用
+};
+
+static double batch_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// 队主从队头取一个任务
+static int batch_deque_pop(struct batch_deque *dq, dword *job)
+{
+    qword range = atomic_load(&dq->range);
+    for (;;)
+    {
+        dword head = (dword)range;
+        dword tail = (dword)(range >> 32);
+        if (head >= tail)
+            return 0;
+        qword next = (qword)(head + 1) | ((qword)tail << 32);
+        if (atomic_compare_exchange_weak(&dq->range, &range, next))
+        {
+            *job = dq->jobs[head];
+            return 1;
+        }
+    }
+}
+
+// 窃取者从队尾取一个任务
+static int batch_deque_steal(struct batch_deque *dq, dword *job)
+{
+    qword range = atomic_load(&dq->range);
+    for (;;)
+    {
+        dword head = (dword)range;
+        dword tail = (dword)(range >> 32);
+        if (head >= tail)
+            return 0;
+        qword next = (qword)head | ((qword)(tail - 1) << 32);
+        if (atomic_compare_exchange_weak(&dq->range, &range, next))
+        {
+            *job = dq->jobs[tail - 1];
+            return 1;
+        }
+    }
+}
+
+// 读取输入：先按二进制输入日志解析，不是日志时按文本脚本解析，失败返回 -1
+static int batch_load_input(const char *path, CHIP8_INPUT_LOG *log)
+{
+    chip8_input_log_init(log, CHIP8_DEFAULT_SEED);
+    if (path[0] == '\0')
+        return 0;
+    if (chip8_input_log_load(log, path) == 0)
+        return 0;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long long cycle;
+        unsigned key;
+        char action[16];
+        if (line[0] == '#' || sscanf(line, "%llu %x %15s", &cycle, &key, action) != 3)
+            continue;
+        if (key >= CHIP8_KEY_SIZE)
+            continue;
+        chip8_input_log_append(log, cycle, (byte)key, strcmp(action, "down") == 0);
+    }
+    fclose(fp);
+    return 0;
+}
+
+// 记下任务结束时实例的状态
+static void batch_store_result(struct batch_job *job, const CHIP8 *chip8)
+{
+    job->cycles = chip8->cycles;
+    job->skipped = chip8->skipped_cycles;
+    job->fused = chip8->fused_cycles;
+    job->fb_hash = chip8_display_hash(chip8);
+    memcpy(job->registers, chip8->registers, sizeof(job->registers));
+    job->index_register = chip8->index_register;
+    job->pc = chip8->pc;
+    job->sp = chip8->sp;
+    job->fault = chip8->error;
+}
+
+// 执行一个任务：定时器随指令数推进，不需要逐帧驱动，每次直接执行到下一个输入事件
+// 或预算用完，输入事件在其指定的指令周期边界生效
+static void batch_run_job(struct batch_job *job, CHIP8 *chip8, CHIP8_INSN *icache, CHIP8_PROFILE *profile,
+                          enum chip8_engine engine, byte idle_skip)
+{
+    double start = batch_now_ms();
+
+    CHIP8_INPUT_LOG log;
+    if (batch_load_input(job->input, &log) < 0)
+    {
+        job->error = 1;
+        snprintf(job->message, sizeof(job->message), "cannot read input script");
+        return;
+    }
+
+    if (job->image->error)
+    {
+        job->error = 1;
+        snprintf(job->message, sizeof(job->message), "%s", chip8_error_string(job->image->error));
+        chip8_input_log_free(&log);
+        return;
+    }
+
+    chip8_setup(chip8, icache);
+    chip8_load_buffer(chip8, job->image->rom.data, job->image->rom.size);
+    chip8->quirks = job->image->quirks;
+    chip8->engine = engine;
+    chip8->idle_skip = idle_skip;
+    chip8_seed(chip8, log.seed);
+    if (profile != NULL)
+        chip8_profile_attach(chip8, profile);
+
+    CHIP8_INPUT_REPLAY replay;
+    chip8_input_replay_init(&replay, &log);
+    // 故障后实例不再前进，任务以故障结束
+    while (chip8->cycles < job->budget && chip8->error == CHIP8_OK)
+    {
+        chip8_input_replay_apply(&replay, chip8);
+        qword stop = job->budget;
+        if (chip8_input_replay_next(&replay) < stop)
+            stop = chip8_input_replay_next(&replay);
+        if (stop - chip8->cycles > UINT32_MAX)
+            stop = chip8->cycles + UINT32_MAX;
+        chip8_emulate_cycles(chip8, (dword)(stop - chip8->cycles));
+    }
+
+    batch_store_result(job, chip8);
+    if (profile != NULL)
+    {
+        size_t size;
+        FILE *fp = open_memstream(&job->profile, &size);
+        if (fp != NULL)
+        {
+            chip8_profile_report(chip8, job->rom, fp);
+            fclose(fp);
+        }
+    }
+    chip8_teardown(chip8);
+    chip8_input_log_free(&log);
+    job->wall_ms = batch_now_ms() - start;
+}
+
+// 应用一条通道已到期的输入事件，让它执行到下一个事件或预算用完
+static void batch_lane_schedule(CHIP8_LANES *lanes, int lane, CHIP8_INPUT_REPLAY *replay, qword budget)
+{
+    chip8_input_replay_seek(replay, lanes->cycles[lane]);
+    memcpy(lanes->keys[lane], replay->keys, CHIP8_KEY_SIZE);
+    lanes->stop[lane] = budget;
+    if (chip8_input_replay_next(replay) < budget)
+        lanes->stop[lane] = chip8_input_replay_next(replay);
+}
+
+// 锁步执行一包任务：chip8_lanes_run 在某条通道到达下一个输入事件或预算时返回，
+// 只处理这条通道，其余通道继续；故障停机或用完预算的通道退出，直到所有通道退出
+static void batch_run_pack(struct batch_pool *pool, const struct batch_pack *pack, struct batch_worker *worker)
+{
+    double start = batch_now_ms();
+    CHIP8_LANES *lanes = &worker->lanes;
+    CHIP8_INPUT_LOG logs[CHIP8_LANE_COUNT];
+    CHIP8_INPUT_REPLAY replays[CHIP8_LANE_COUNT];
+    const struct batch_rom *image = pool->jobs[pack->jobs[0]].image;
+
+    chip8_lanes_setup(lanes, pack->count);
+    lanes->active = 0;
+    lanes->quirks = image->quirks;
+    if (!image->error)
+        chip8_lanes_load_buffer(lanes, image->rom.data, image->rom.size);
+    for (int l = 0; l < pack->count; l++)
+    {
+        struct batch_job *job = &pool->jobs[pack->jobs[l]];
+        if (batch_load_input(job->input, &logs[l]) < 0)
+        {
+            job->error = 1;
+            snprintf(job->message, sizeof(job->message), "cannot read input script");
+            continue;
+        }
+        if (image->error)
+        {
+            job->error = 1;
+            snprintf(job->message, sizeof(job->message), "%s", chip8_error_string(image->error));
+            chip8_input_log_free(&logs[l]);
+            continue;
+        }
+        chip8_lanes_seed(lanes, l, logs[l].seed);
+        chip8_input_replay_init(&replays[l], &logs[l]);
+        batch_lane_schedule(lanes, l, &replays[l], job->budget);
+        lanes->active |= 1u << l;
+    }
+
+    dword started = lanes->active;
+    while (lanes->active)
+    {
+        chip8_lanes_run(lanes, UINT32_MAX);
+        for (int l = 0; l < pack->count; l++)
+        {
+            if (!(lanes->active >> l & 1))
+                continue;
+            qword budget = pool->jobs[pack->jobs[l]].budget;
+            if ((lanes->halted >> l & 1) || lanes->cycles[l] >= budget)
+                lanes->active &= ~(1u << l);
+            else if (lanes->cycles[l] >= lanes->stop[l])
+                batch_lane_schedule(lanes, l, &replays[l], budget);
+        }
+    }
+
+    double wall_ms = (batch_now_ms() - start) / (started ? __builtin_popcount(started) : 1);
+    for (int l = 0; l < pack->count; l++)
+    {
+        if (!(started >> l & 1))
+            continue;
+        struct batch_job *job = &pool->jobs[pack->jobs[l]];
+        chip8_setup(&worker->chip8, worker->icache);
+        chip8_lanes_extract(lanes, l, &worker->chip8);
+        batch_store_result(job, &worker->chip8);
+        chip8_teardown(&worker->chip8);
+        chip8_input_log_free(&logs[l]);
+        job->wall_ms = wall_ms;
+    }
+}
+
+static void *batch_worker_main(void *arg)
+{
+    struct batch_worker *worker = (struct batch_worker *)arg;
+    struct batch_pool *pool = worker->pool;
+    dword job;
+
+    for (;;)
+    {
+        if (!batch_deque_pop(&pool->deques[worker->id], &job))
+        {
+            // 自己的队列已空，依次从其他线程的队尾窃取
+            int stolen = 0;
+            for (int i = 1; i < pool->workers && !stolen; i++)
+                stolen = batch_deque_steal(&pool->deques[(worker->id + i) % pool->workers], &job);
+            if (!stolen)
+                break;
+        }
+        if (pool->packs != NULL)
+            batch_run_pack(pool, &pool->packs[job], worker);
+        else
+            batch_run_job(&pool->jobs[job], &worker->chip8, worker->icache, pool->profile ? &worker->profile : NULL,
+                          pool->engine, pool->idle_skip);
+    }
+    return NULL;
+}
+
+// 读取一个字段，支持双引号，返回指向字段后的指针，没有字段时返回 NULL
+static char *batch_next_field(char *p, char *out, size_t size)
+{
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#')
+        return NULL;
+    char end = ' ';
+    if (*p == '"')
+    {
+        end = '"';
+        p++;
+    }
+    size_t n = 0;
+    while (*p && *p != end && !(end == ' ' && (*p == '\t' || *p == '\n' || *p == '\r')))
+    {
+        if (n + 1 < size)
+            out[n++] = *p;
+        p++;
+    }
+    out[n] = '\0';
+    if (*p == '"')
+        p++;
+    return p;
+}
+
+// 相对路径相对于清单所在目录，拼接后放不进 size 字节时返回 -1
+static int batch_resolve_path(const char *base_dir, const char *path, char *out, size_t size)
+{
+    int len;
+    if (path[0] == '/' || base_dir[0] == '\0')
+        len = snprintf(out, size, "%s", path);
+    else
+        len = snprintf(out, size, "%s/%s", base_dir, path);
+    return len < 0 || (size_t)len >= size ? -1 : 0;
+}
+
+// 解析任务清单，返回任务数，文件无法读取或内存不足返回 -1
+static int batch_parse_manifest(const char *path, struct batch_job **jobs)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+
+    char base_dir[BATCH_PATH_MAX];
+    if (strlen(path) >= sizeof(base_dir))
+    {
+        fclose(fp);
+        return -1;
+    }
+    snprintf(base_dir, sizeof(base_dir), "%s", path);
+    char *slash = strrchr(base_dir, '/');
+    if (slash)
+        *slash = '\0';
+    else
+        base_dir[0] = '\0';
+
+    int count = 0, capacity = 0;
+    char line[3 * BATCH_PATH_MAX];
+    *jobs = NULL;
+    while (fgets(line, sizeof(line), fp))
+    {
+        char rom[BATCH_PATH_MAX], input[BATCH_PATH_MAX], budget[32];
+        char *p = batch_next_field(line, rom, sizeof(rom));
+        if (p == NULL)
+            continue;
+        p = batch_next_field(p, input, sizeof(input));
+        if (p == NULL || batch_next_field(p, budget, sizeof(budget)) == NULL)
+        {
+            fprintf(stderr, "%s: malformed line: %s", path, line);
+            continue;
+        }
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 32;
+            struct batch_job *grown = (struct batch_job *)realloc(*jobs, capacity * sizeof(struct batch_job));
+            if (grown == NULL)
+            {
+                free(*jobs);
+                *jobs = NULL;
+                fclose(fp);
+                return -1;
+            }
+            *jobs = grown;
+        }
+        struct batch_job *job = &(*jobs)[count];
+        memset(job, 0, sizeof(*job));
+        if (batch_resolve_path(base_dir, rom, job->rom, sizeof(job->rom)) != 0 ||
+            (strcmp(input, "-") != 0 && batch_resolve_path(base_dir, input, job->input, sizeof(job->input)) != 0))
+        {
+            fprintf(stderr, "%s: path too long: %s", path, line);
+            continue;
+        }
+        job->budget = strtoull(budget, NULL, 0);
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static int batch_compare_path(const void *a, const void *b)
+{
+    const struct batch_job *ja = *(const struct batch_job *const *)a;
+    const struct batch_job *jb = *(const struct batch_job *const *)b;
+    return strcmp(ja->rom, jb->rom);
+}
+
+// 按路径排序后去重，每个不同的 ROM 映射一次。返回 ROM 数组，数量写入 *rom_count
+static struct batch_rom *batch_map_roms(struct batch_job *jobs, int count, const CHIP8_ROM_INDEX *index, int *rom_count)
+{
+    struct batch_job **order = (struct batch_job **)malloc(count * sizeof(struct batch_job *));
+    struct batch_rom *roms = (struct batch_rom *)calloc(count ? count : 1, sizeof(struct batch_rom));
+    for (int i = 0; i < count; i++)
+        order[i] = &jobs[i];
+    qsort(order, count, sizeof(struct batch_job *), batch_compare_path);
+
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (n == 0 || strcmp(roms[n - 1].path, order[i]->rom) != 0)
+        {
+            struct batch_rom *image = &roms[n++];
+            image->path = order[i]->rom;
+            image->error = chip8_rom_open(&image->rom, image->path);
+            if (!image->error && index != NULL)
+            {
+                const CHIP8_ROM_INFO *info = chip8_rom_index_find(index, chip8_rom_hash(image->rom.data, image->rom.size));
+                if (info != NULL)
+                    image->quirks = info->quirks;
+            }
+        }
+        order[i]->image = &roms[n - 1];
+    }
+    free(order);
+    *rom_count = n;
+    return roms;
+}
+
+// 把清单中映射成功而索引里还没有的 ROM 以默认选项加入 index（名称取文件名），再写入 path。失败返回 -1
+static int batch_write_index(const struct batch_rom *roms, int rom_count, CHIP8_ROM_INDEX *index, const char *path)
+{
+    for (int i = 0; i < rom_count; i++)
+    {
+        if (roms[i].error)
+            continue;
+        qword hash = chip8_rom_hash(roms[i].rom.data, roms[i].rom.size);
+        if (chip8_rom_index_find(index, hash) != NULL)
+            continue;
+        const char *name = strrchr(roms[i].path, '/');
+        CHIP8_ROM_INFO info = { hash, 0, 0, "" };
+        snprintf(info.name, sizeof(info.name), "%s", name ? name + 1 : roms[i].path);
+        if (chip8_rom_index_put(index, &info) != 0)
+            return -1;
+    }
+    return chip8_rom_index_save(index, path);
+}
+
+// 按清单顺序把引用同一 ROM 的任务每 CHIP8_LANE_COUNT 个打成一包，返回包数
+static int batch_pack_jobs(struct batch_job *jobs, int count, const struct batch_rom *roms, int rom_count,
+                           struct batch_pack **packs)
+{
+    int *open = (int *)malloc((rom_count ? rom_count : 1) * sizeof(int)); // 每个 ROM 未满的包，-1 表示没有
+    for (int i = 0; i < rom_count; i++)
+        open[i] = -1;
+    *packs = (struct batch_pack *)malloc((count ? count : 1) * sizeof(struct batch_pack));
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int r = (int)(jobs[i].image - roms);
+        if (open[r] < 0 || (*packs)[open[r]].count == CHIP8_LANE_COUNT)
+        {
+            open[r] = n++;
+            (*packs)[open[r]].count = 0;
+        }
+        struct batch_pack *pack = &(*packs)[open[r]];
+        pack->jobs[pack->count++] = (dword)i;
+    }
+    free(open);
+    return n;
+}
+
+static void batch_report(const struct batch_job *jobs, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const struct batch_job *job = &jobs[i];
+        if (job->error)
+        {
+            printf("job %d rom=\"%s\" error=\"%s\"\n", i, job->rom, job->message);
+            continue;
+        }
+        printf("job %d rom=\"%s\" cycles=%llu skipped=%llu fused=%llu time_ms=%.3f fb=%016llx pc=0x%03X I=0x%03X sp=%u V=",
+               i, job->rom, (unsigned long long)job->cycles, (unsigned long long)job->skipped,
+               (unsigned long long)job->fused, job->wall_ms,
+               (unsigned long long)job->fb_hash, job->pc, job->index_register, job->sp);
+        for (int r = 0; r < 16; r++)
+            printf("%02X", job->registers[r]);
+        if (job->fault != CHIP8_OK)
+            printf(" fault=\"%s\"", chip8_error_string(job->fault));
+        printf("\n");
+    }
+}
+
+static void batch_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-j threads] [-e switch|table|goto|cache|jit|aot] [-n] [-L] [-i index] [-w index] [-P profile] manifest\n"
+                    "  -n  execute idle loops instead of skipping them\n"
+                    "  -L  run jobs of the same ROM together in SIMD lockstep lanes\n"
+                    "  -i  ROM library index to take per-ROM quirks from\n"
+                    "  -w  write the -i entries plus the manifest's unindexed ROMs to an index file\n"
+                    "  -P  write per-job profile reports (JSON lines) to a file\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *engine_names[CHIP8_ENGINE_COUNT] = { "switch", "table", "goto", "cache", "jit", "aot" };
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    enum chip8_engine engine = CHIP8_DEFAULT_ENGINE;
+    byte idle_skip = 1;
+    const char *index_path = NULL;
+    const char *index_out = NULL;
+    const char *profile_path = NULL;
+    byte lockstep = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:e:nLi:w:P:h")) != -1)
+    {
+        switch (opt) {
+            case 'j':
+                workers = atoi(optarg);
+                break;
+            case 'e':
+                engine = CHIP8_ENGINE_COUNT;
+                for (int i = 0; i < CHIP8_ENGINE_COUNT; i++)
+                    if (strcmp(optarg, engine_names[i]) == 0)
+                        engine = (enum chip8_engine)i;
+                if (engine == CHIP8_ENGINE_COUNT)
+                {
+                    batch_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'n':
+                idle_skip = 0;
+                break;
+            case 'L':
+                lockstep = 1;
+                break;
+            case 'i':
+                index_path = optarg;
+                break;
+            case 'w':
+                index_out = optarg;
+                break;
+            case 'P':
+                profile_path = optarg;
+                break;
+            default:
+                batch_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        batch_usage(argv[0]);
+        return 1;
+    }
+    if (lockstep && profile_path != NULL)
+    {
+        fprintf(stderr, "-P is not supported with -L\n");
+        return 1;
+    }
+    if (profile_path != NULL && !CHIP8_ENABLE_PROFILE)
+        fprintf(stderr, "built without CHIP8_ENABLE_PROFILE, profile counters will be zero\n");
+
+    struct batch_job *jobs = NULL;
+    int count = batch_parse_manifest(argv[optind], &jobs);
+    if (count < 0)
+    {
+        fprintf(stderr, "cannot read manifest %s\n", argv[optind]);
+        return 1;
+    }
+
+    CHIP8_ROM_INDEX index;
+    chip8_rom_index_init(&index);
+    if (index_path != NULL && chip8_rom_index_load(&index, index_path) != 0)
+    {
+        fprintf(stderr, "cannot read ROM index %s\n", index_path);
+        free(jobs);
+        return 1;
+    }
+    int rom_count;
+    struct batch_rom *roms = batch_map_roms(jobs, count, index_path ? &index : NULL, &rom_count);
+    int index_error = index_out != NULL && batch_write_index(roms, rom_count, &index, index_out) != 0;
+    chip8_rom_index_free(&index);
+    if (index_error)
+        fprintf(stderr, "cannot write ROM index %s\n", index_out);
+
+    // 锁步模式下队列中的工作单位是包
+    struct batch_pack *packs = NULL;
+    int units = lockstep ? batch_pack_jobs(jobs, count, roms, rom_count, &packs) : count;
+
+    if (workers < 1)
+        workers = 1;
+    if (workers > units && units > 0)
+        workers = units;
+
+    // 按轮询方式把任务分到各线程的队列
+    struct batch_pool pool = { jobs, packs, NULL, workers, engine, idle_skip, profile_path != NULL };
+    pool.deques = (struct batch_deque *)calloc(workers, sizeof(struct batch_deque));
+    for (int w = 0; w < workers; w++)
+    {
+        dword n = 0;
+        pool.deques[w].jobs = (dword *)malloc((units / workers + 1) * sizeof(dword));
+        for (int i = w; i < units; i += workers)
+            pool.deques[w].jobs[n++] = (dword)i;
+        atomic_init(&pool.deques[w].range, (qword)n << 32);
+    }
+
+    double start = batch_now_ms();
+    pthread_t *threads = (pthread_t *)malloc(workers * sizeof(pthread_t));
+    struct batch_worker *args = (struct batch_worker *)malloc(workers * sizeof(struct batch_worker));
+    for (int w = 0; w < workers; w++)
+    {
+        args[w].pool = &pool;
+        args[w].id = w;
+        pthread_create(&threads[w], NULL, batch_worker_main, &args[w]);
+    }
+    for (int w = 0; w < workers; w++)
+        pthread_join(threads[w], NULL);
+    double total = batch_now_ms() - start;
+
+    batch_report(jobs, count);
+    int failed = 0;
+    for (int i = 0; i < count; i++)
+        failed += jobs[i].error != 0;
+    printf("jobs=%d failed=%d threads=%d engine=%s wall_ms=%.3f\n",
+           count, failed, workers, lockstep ? "lanes" : engine_names[engine], total);
+
+    if (profile_path != NULL)
+    {
+        FILE *fp = fopen(profile_path, "w");
+        if (fp == NULL)
+            fprintf(stderr, "cannot write profile %s\n", profile_path);
+        for (int i = 0; i < count; i++)
+        {
+            if (fp != NULL && jobs[i].profile != NULL)
+                fputs(jobs[i].profile, fp);
+            free(jobs[i].profile);
+        }
+        if (fp != NULL)
+            fclose(fp);
+    }
+
+    for (int w = 0; w < workers; w++)
+        free(pool.deques[w].jobs);
+    free(pool.deques);
+    free(packs);
+    free(threads);
+    free(args);
+    for (int i = 0; i < rom_count; i++)
+        chip8_rom_close(&roms[i].rom);
+    free(roms);
+    free(jobs);
+    return failed ? 2 : 0;
+}
+/// ****************************************************************************** ///
@@ -0,0 +1,483 @@
+#include "aot.h"
+#include "chip8.h"
+#include "fork.h"
+#include "lanes.h"
+#include "rom.h"
+#include <getopt.h>
+
+/// ********************************性能基准********************************** ///
+// 两类基准：
+//   opcode/<名称>        ：单个处理函数的耗时（纳秒/次，越低越好），与分派引擎无关
+//   rom/<ROM>/<引擎>     ：ROM 在指定引擎下无界面、不限速运行的模拟速度（MIPS，越高越好）
+//   rom/<ROM>/lanes      ：CHIP8_LANE_COUNT 个不同种子的实例在 SIMD 锁步通道（lanes.h）中的总速度
+//   rom/<ROM>/fork       ：树搜索扩展一个节点（fork.h 装入、执行一帧、保存）的耗时（纳秒/次，越低越好）
+// 结果以 JSON 输出，每条结果独占一行，便于作为基准线保存后用 -b 比较：
+// 任何一项变差超过阈值时以退出码 3 结束，可直接用于 CI。
+
+#define BENCH_MAX_RESULTS 512
+#define BENCH_NAME_MAX 512
+// 每个处理函数至少计时的时长
+#define BENCH_OPCODE_MIN_NS 20000000.0
+
+struct bench_result
+{
+    char name[BENCH_NAME_MAX];
+    const char *unit;                // "ns" 或 "MIPS"
+    byte higher_is_better;
+    double value;
+};
+
+static struct bench_result results[BENCH_MAX_RESULTS];
+static int result_count;
+
+static const char *engine_names[CHIP8_ENGINE_COUNT] = { "switch", "table", "goto", "cache", "jit", "aot" };
+
+static double bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_add(const char *name, const char *unit, byte higher_is_better, double value)
+{
+    if (result_count == BENCH_MAX_RESULTS)
+        return;
+    struct bench_result *r = &results[result_count++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->unit = unit;
+    r->higher_is_better = higher_is_better;
+    r->value = value;
+}
+/// ****************************************************************************** ///
+
+/// ******************************处理函数微基准******************************** ///
+// 用名称生成一个代表性的操作码：X=F、Y=2、N/NN/NNN 取最大值，
+// 使 DXYN 绘制 15 行、FX55/FX65 传送全部 16 个寄存器，测到的是最坏情况
+static word bench_sample_opcode(const char *name)
+{
+    word opcode = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char c = name[i];
+        int digit = c == 'X' ? 0xF : c == 'Y' ? 0x2 : c == 'N' ? 0xF
+                  : (c >= 'A' ? c - 'A' + 10 : c - '0');
+        opcode = (word)(opcode << 4 | digit);
+    }
+    return opcode;
+}
+
+// 空处理函数，用来测量循环和状态复位本身的开销
+static void bench_nop(CHIP8 *chip8)
+{
+    (void)chip8;
+}
+
+// 每次调用前复位会被处理函数改变且影响下一次调用的状态
+static void bench_prepare(CHIP8 *chip8, const byte *registers)
+{
+    memcpy(chip8->registers, registers, 16);
+    chip8->pc = CHIP8_MEMORY_START_ADDR;
+    chip8->sp = 1;
+    chip8->index_register = 0x300;
+}
+
+// 返回每次调用的纳秒数（多轮取最好）
+static double bench_handler(CHIP8 *chip8, opcode_func handler, word opcode, int repeats)
+{
+    // 经由 volatile 读取，防止编译器把处理函数内联进计时循环
+    opcode_func volatile handler_ref = handler;
+    byte registers[16];
+    for (int i = 0; i < 16; i++)
+        registers[i] = (byte)i;
+    memset(chip8->memory + 0x300, 0xA5, 0x20);  // 精灵数据
+    chip8->stack[0] = CHIP8_MEMORY_START_ADDR;
+    chip8->keys[0xF] = 1;                        // FX0A/EX9E 走按下分支
+
+    // 校准迭代次数，使一轮至少持续 BENCH_OPCODE_MIN_NS
+    qword iterations = 1 << 12;
+    double best = 0;
+    for (int round = 0; round < repeats; )
+    {
+        opcode_func fn = handler_ref;
+        double start = bench_now_ns();
+        for (qword i = 0; i < iterations; i++)
+        {
+            bench_prepare(chip8, registers);
+            chip8->opcode = opcode;
+            fn(chip8);
+        }
+        double elapsed = bench_now_ns() - start;
+        if (elapsed < BENCH_OPCODE_MIN_NS)
+        {
+            iterations *= 2;
+            continue;
+        }
+        double per_call = elapsed / iterations;
+        if (round == 0 || per_call < best)
+            best = per_call;
+        round++;
+    }
+    return best;
+}
+
+#define BENCH_OPCODE_NAME(N) #N,
+static const char *opcode_names[CHIP8_OP_COUNT] = { CHIP8_OPCODE_LIST(BENCH_OPCODE_NAME) };
+
+static void bench_opcodes(int repeats)
+{
+    CHIP8 *chip8 = chip8_init();
+    char name[BENCH_NAME_MAX];
+    bench_add("opcode/overhead", "ns", 0, bench_handler(chip8, bench_nop, 0, repeats));
+    for (int op = 0; op < CHIP8_OP_COUNT; op++)
+    {
+        if (op == CHIP8_OP_unknown)
+            continue;
+        word opcode = bench_sample_opcode(opcode_names[op]);
+        snprintf(name, sizeof(name), "opcode/%s", opcode_names[op]);
+        bench_add(name, "ns", 0, bench_handler(chip8, chip8_opcode_handlers[op], opcode, repeats));
+    }
+    chip8_free(chip8);
+}
+/// ****************************************************************************** ///
+
+
+/// *******************************ROM 端到端基准******************************** ///
+// 与 chip8_batch 相同，不限速地一次执行全部指令。
+// 关闭空转检测，测得的是引擎真正执行指令的速度。fuse 为 0 时 CACHE 引擎不融合超级指令；
+// fused 不为 NULL 时返回作为超级指令的后续部分执行的指令所占的百分比（省去的分派）
+static double bench_rom(const byte *rom, size_t size, enum chip8_engine engine, byte fuse, qword cycles, int repeats,
+                        double *fused)
+{
+    double best = 0;
+    for (int round = 0; round < repeats; round++)
+    {
+        CHIP8 *chip8 = chip8_init();
+        chip8->fuse = fuse;
+        chip8_load_buffer(chip8, rom, size);
+        chip8->engine = engine;
+        chip8->idle_skip = 0;
+
+        double start = bench_now_ns();
+        while (chip8->cycles < cycles)
+        {
+            qword left = cycles - chip8->cycles;
+            chip8_emulate_cycles(chip8, left > UINT32_MAX ? UINT32_MAX : (dword)left);
+        }
+        double mips = chip8->cycles / ((bench_now_ns() - start) / 1e3);
+        if (mips > best)
+            best = mips;
+        if (fused != NULL)
+            *fused = 100.0 * chip8->fused_cycles / chip8->cycles;
+        chip8_free(chip8);
+    }
+    return best;
+}
+
+// 每条通道各执行 cycles 条指令，返回所有通道合计的 MIPS
+static double bench_rom_lanes(const byte *rom, size_t size, qword cycles, int repeats)
+{
+    double best = 0;
+    CHIP8_LANES *lanes = (CHIP8_LANES *)malloc(sizeof(CHIP8_LANES));
+    for (int round = 0; round < repeats; round++)
+    {
+        chip8_lanes_setup(lanes, CHIP8_LANE_COUNT);
+        chip8_lanes_load_buffer(lanes, rom, size);
+        for (int l = 0; l < CHIP8_LANE_COUNT; l++)
+        {
+            chip8_lanes_seed(lanes, l, (qword)l);
+            lanes->stop[l] = cycles;
+        }
+
+        double start = bench_now_ns();
+        while (chip8_lanes_run(lanes, UINT32_MAX) != 0)
+            ;
+        double mips = lanes->lane_cycles / ((bench_now_ns() - start) / 1e3);
+        if (mips > best)
+            best = mips;
+    }
+    free(lanes);
+    return best;
+}
+
+// 树的节点数上限，达到后只保留根节点重新扩展
+#define BENCH_FORK_NODES 4096
+#define BENCH_FORK_EXPANSIONS 200000
+
+// 模拟树搜索的节点扩展：随机选一个已有节点装入工作实例，按下一个键执行一帧后保存为子节点。
+// 根节点是 ROM 执行 60 帧之后的状态。返回每次扩展的纳秒数
+static double bench_rom_fork(const byte *rom, size_t size, int repeats)
+{
+    double best = 0;
+    CHIP8_FORK **nodes = (CHIP8_FORK **)malloc(BENCH_FORK_NODES * sizeof(CHIP8_FORK *));
+    for (int round = 0; round < repeats; round++)
+    {
+        CHIP8 *chip8 = chip8_init();
+        CHIP8_FORK_POOL *pool = chip8_fork_pool_create();
+        chip8_load_buffer(chip8, rom, size);
+        chip8->idle_skip = 0;
+        chip8_emulate_cycles(chip8, 60 * CHIP8_CYCLES_PER_FRAME);
+        int count = 0;
+        nodes[count++] = chip8_fork_capture(pool, chip8);
+
+        qword rng = 1;
+        double start = bench_now_ns();
+        for (int i = 0; i < BENCH_FORK_EXPANSIONS && nodes[count - 1] != NULL; i++)
+        {
+            if (count == BENCH_FORK_NODES)
+            {
+                while (count > 1)
+                    chip8_fork_release(pool, nodes[--count]);
+            }
+            rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+            chip8_fork_restore(pool, nodes[(rng >> 33) % count], chip8);
+            chip8->keys[(rng >> 20) & 0xF] = 1;
+            chip8_emulate_cycles(chip8, CHIP8_CYCLES_PER_FRAME);
+            nodes[count++] = chip8_fork_capture(pool, chip8);
+        }
+        double ns = (bench_now_ns() - start) / BENCH_FORK_EXPANSIONS;
+        if (best == 0 || ns < best)
+            best = ns;
+        chip8_fork_pool_free(pool);
+        chip8_free(chip8);
+    }
+    free(nodes);
+    return best;
+}
+
+static void bench_roms(char **roms, int count, const byte *engines, byte lanes, byte fork, qword cycles, int repeats)
+{
+    char name[BENCH_NAME_MAX];
+    for (int i = 0; i < count; i++)
+    {
+        CHIP8_ROM rom;
+        int error = chip8_rom_open(&rom, roms[i]);
+        if (error != CHIP8_OK)
+        {
+            fprintf(stderr, "cannot read ROM %s: %s\n", roms[i], chip8_error_string((enum chip8_error)error));
+            continue;
+        }
+        const char *base = strrchr(roms[i], '/');
+        base = base ? base + 1 : roms[i];
+        for (int e = 0; e < CHIP8_ENGINE_COUNT; e++)
+        {
+            if (!engines[e])
+                continue;
+            // 没有预编译的 ROM 在 AOT 引擎下只是 CACHE，不重复报告
+            if (e == CHIP8_ENGINE_AOT && chip8_aot_find(rom.data, rom.size) == NULL)
+                continue;
+            snprintf(name, sizeof(name), "rom/%s/%s", base, engine_names[e]);
+            double fused = 0;
+            bench_add(name, "MIPS", 1, bench_rom(rom.data, rom.size, (enum chip8_engine)e, 1, cycles, repeats, &fused));
+            if (e != CHIP8_ENGINE_CACHE)
+                continue;
+            // 超级指令的收益：省去的分派所占的比例，以及不融合时的速度
+            snprintf(name, sizeof(name), "rom/%s/cache-fused", base);
+            bench_add(name, "%", 1, fused);
+            snprintf(name, sizeof(name), "rom/%s/cache-nofuse", base);
+            bench_add(name, "MIPS", 1, bench_rom(rom.data, rom.size, CHIP8_ENGINE_CACHE, 0, cycles, repeats, NULL));
+        }
+        if (lanes)
+        {
+            snprintf(name, sizeof(name), "rom/%s/lanes", base);
+            bench_add(name, "MIPS", 1, bench_rom_lanes(rom.data, rom.size, cycles, repeats));
+        }
+        if (fork)
+        {
+            snprintf(name, sizeof(name), "rom/%s/fork", base);
+            bench_add(name, "ns", 0, bench_rom_fork(rom.data, rom.size, repeats));
+        }
+        chip8_rom_close(&rom);
+    }
+}
+/// ****************************************************************************** ///
+
+
+/// ******************************输出与基准线比较******************************* ///
+static void bench_write_json(FILE *fp, qword cycles, int repeats)
+{
+    fprintf(fp, "{\n  \"version\": 1,\n  \"cycles\": %llu,\n  \"repeats\": %d,\n  \"results\": [\n",
+            (unsigned long long)cycles, repeats);
+    for (int i = 0; i < result_count; i++)
+    {
+        fprintf(fp, "    {\"name\": \"");
+        for (const char *p = results[i].name; *p; p++)
+        {
+            if (*p == '"' || *p == '\\')
+                fputc('\\', fp);
+            fputc(*p, fp);
+        }
+        fprintf(fp, "\", \"unit\": \"%s\", \"value\": %.4f}%s\n",
+                results[i].unit, results[i].value, i + 1 < result_count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+// 在基准线文件中查找同名结果。只解析本程序写出的格式：每行一条结果
+static int bench_baseline_lookup(FILE *fp, const char *name, double *value)
+{
+    char line[2 * BENCH_NAME_MAX];
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp))
+    {
+        char *p = strstr(line, "\"name\": \"");
+        if (p == NULL)
+            continue;
+        p += 9;
+        const char *q = name;
+        while (*p && *p != '"' && *q)
+        {
+            if (*p == '\\')
+                p++;
+            if (*p != *q)
+                break;
+            p++;
+            q++;
+        }
+        if (*q != '\0' || *p != '"')
+            continue;
+        char *v = strstr(p, "\"value\": ");
+        if (v && sscanf(v + 9, "%lf", value) == 1)
+            return 0;
+    }
+    return -1;
+}
+
+// 输出比较结果，返回变差超过阈值的项数
+static int bench_compare(const char *path, double threshold)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "cannot read baseline %s\n", path);
+        return -1;
+    }
+    int regressions = 0;
+    fprintf(stderr, "%-60s %12s %12s %8s\n", "benchmark", "baseline", "current", "change");
+    for (int i = 0; i < result_count; i++)
+    {
+        const struct bench_result *r = &results[i];
+        double base;
+        if (bench_baseline_lookup(fp, r->name, &base) != 0 || base <= 0)
+        {
+            fprintf(stderr, "%-60s %12s %12.3f %8s\n", r->name, "-", r->value, "new");
+            continue;
+        }
+        // 变化统一换算为“变好”的百分比
+        double change = (r->higher_is_better ? r->value / base : base / r->value) - 1.0;
+        byte regressed = change < -threshold;
+        regressions += regressed;
+        fprintf(stderr, "%-60s %12.3f %12.3f %+7.1f%%%s\n", r->name, base, r->value,
+                change * 100.0, regressed ? "  REGRESSION" : "");
+    }
+    fclose(fp);
+    return regressions;
+}
+/// ****************************************************************************** ///
+
+
+static void bench_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-e engine[,engine...]] [-n cycles] [-r repeats] [-o out.json]\n"
+                    "          [-b baseline.json] [-t threshold%%] [-m] [rom...]\n"
+                    "  -e  engines to run ROMs on: switch,table,goto,cache,jit,aot,lanes,fork (default all)\n"
+                    "  -n  emulated cycles per ROM run (default 5000000)\n"
+                    "  -r  repetitions, best one is reported (default 3)\n"
+                    "  -o  write JSON to file instead of stdout\n"
+                    "  -b  compare with a baseline JSON, exit 3 on regression\n"
+                    "  -t  allowed regression in percent (default 5)\n"
+                    "  -m  skip per-opcode microbenchmarks\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    byte engines[CHIP8_ENGINE_COUNT];
+    memset(engines, 1, sizeof(engines));
+    byte lanes = 1;
+    byte fork = 1;
+    qword cycles = 5000000;
+    int repeats = 3;
+    const char *out_path = NULL;
+    const char *baseline = NULL;
+    double threshold = 5.0;
+    byte micro = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:n:r:o:b:t:mh")) != -1)
+    {
+        switch (opt) {
+            case 'e':
+            {
+                memset(engines, 0, sizeof(engines));
+                lanes = 0;
+                fork = 0;
+                char list[256];
+                snprintf(list, sizeof(list), "%s", optarg);
+                for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ","))
+                {
+                    int found = 0;
+                    if (strcmp(tok, "lanes") == 0)
+                        lanes = found = 1;
+                    if (strcmp(tok, "fork") == 0)
+                        fork = found = 1;
+                    for (int i = 0; i < CHIP8_ENGINE_COUNT; i++)
+                        if (strcmp(tok, engine_names[i]) == 0)
+                            engines[i] = found = 1;
+                    if (!found)
+                    {
+                        bench_usage(argv[0]);
+                        return 1;
+                    }
+                }
+                break;
+            }
+            case 'n':
+                cycles = strtoull(optarg, NULL, 0);
+                break;
+            case 'r':
+                repeats = atoi(optarg);
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'b':
+                baseline = optarg;
+                break;
+            case 't':
+                threshold = atof(optarg);
+                break;
+            case 'm':
+                micro = 0;
+                break;
+            default:
+                bench_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (repeats < 1)
+        repeats = 1;
+
+    if (micro)
+        bench_opcodes(repeats);
+    bench_roms(argv + optind, argc - optind, engines, lanes, fork, cycles, repeats);
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", out_path);
+        return 1;
+    }
+    bench_write_json(out, cycles, repeats);
+    if (out != stdout)
+        fclose(out);
+
+    if (baseline)
+    {
+        int regressions = bench_compare(baseline, threshold / 100.0);
+        if (regressions < 0)
+            return 1;
+        if (regressions > 0)
+            return 3;
+    }
+    return 0;
+}
@@ -1,4 +1,7 @@
 #include "chip8.h"
+#include "rom.h"
+#include "profile.h"
+#include <stdarg.h>
 
 
 // CHIP-8 字符集
@@ -28,20 +31,17 @@ byte chip8_fontset[CHIP8_FONTSET_SIZE] = {
 };
 
 /**
- * chip8_init 函数用于初始化 CHIP8 结构体。
+ * chip8_setup 在调用者提供的内存中初始化 CHIP8 结构体，不分配任何内存。
  *
- * @return 返回一个指向初始化后的 CHIP8 结构体的指针。
+ * 宿主可以把实例放在栈上、静态区或自己的内存池中；初始化后的状态与 chip8_init 相同。
+ * 只有 JIT 引擎会在首次使用时创建上下文，不允许分配内存的宿主不要选择 JIT 引擎，
+ * 或者在丢弃实例前调用 chip8_teardown。
  *
- * 此函数的主要职责是初始化 CHIP8 结构体，包括生成随机数种子、分配内存资源并清零、
- * 设置初始 PC 值、加载字体以及初始化运行状态。
- * 生产随机数种子是为了实现游戏随机性。
+ * @param chip8 调用者拥有的 CHIP8 结构体
+ * @param icache 调用者提供的译码缓存（CHIP8_ICACHE_SIZE 项），NULL 时 CACHE 引擎退化为 GOTO
  */
-CHIP8 *chip8_init()
+void chip8_setup(CHIP8 *chip8, CHIP8_INSN *icache)
 {
-    // 生成随机数种子
-    srand((unsigned)time(NULL));
-    // 分配内存资源并清零
-    CHIP8 *chip8 = (CHIP8 *)malloc(sizeof(CHIP8));
     memset(chip8, 0, sizeof(CHIP8));
     // 设置初始 PC 值
     chip8->pc = CHIP8_MEMORY_START_ADDR;
@@ -50,89 +50,230 @@ CHIP8 *chip8_init()
     {
         chip8->memory[CHIP8_FONTSET_MEM_START_ADDR + i] = chip8_fontset[i];
     }
+    // 设置默认随机数种子
+    chip8_seed(chip8, CHIP8_DEFAULT_SEED);
     // 初始化运行状态
     chip8->state = CHIP8_SYS_STATE_RUNNING;
+    chip8->engine = CHIP8_DEFAULT_ENGINE;
+    // 空转检测的结果与逐条执行完全一致，默认打开
+    chip8->idle_skip = 1;
+    // 超级指令同样逐位一致，默认打开
+    chip8->fuse = 1;
+    // 内存与任何分支节点都没有对应关系
+    chip8->memory_dirty = 0xFFFFFFFFu;
+    if (icache != NULL)
+        memset(icache, 0, CHIP8_ICACHE_SIZE * sizeof(CHIP8_INSN));
+    chip8->icache = icache;
+}
+
+/**
+ * chip8_teardown 释放实例在运行中创建的资源（JIT 上下文），
+ * 不释放 chip8 本身和调用者提供的译码缓存。之后可以再次调用 chip8_setup 复用这块内存。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
+void chip8_teardown(CHIP8 *chip8)
+{
+#if CHIP8_HAVE_JIT
+    chip8_jit_free(chip8);
+#endif
+    chip8->jit = NULL;
+}
+
+/**
+ * chip8_init 函数用于分配并初始化 CHIP8 结构体。
+ *
+ * @return 返回一个指向初始化后的 CHIP8 结构体的指针，内存不足时返回 NULL。
+ *
+ * 结构体和译码缓存在同一次分配中，之后由 chip8_setup 完成初始化：
+ * 设置初始 PC 值、加载字体、设置默认随机数种子以及初始化运行状态。
+ * 默认种子固定，同一 ROM 和输入的运行结果可重现；需要每次不同时调用 chip8_seed。
+ */
+CHIP8 *chip8_init()
+{
+    CHIP8 *chip8 = (CHIP8 *)malloc(sizeof(CHIP8) + CHIP8_ICACHE_SIZE * sizeof(CHIP8_INSN));
+    if (chip8 == NULL)
+        return NULL;
+    chip8_setup(chip8, (CHIP8_INSN *)(chip8 + 1));
     return chip8;
 }
 
 /**
- * 获取CHIP-8游戏文件的大小
+ * chip8_seed 设置随机数种子。
  *
- * 此函数的目的是确定CHIP-8游戏文件的大小，以确保在加载游戏代码到内存时不会超出文件的边界
- * 它通过将文件指针移动到文件末尾，然后读取当前位置来确定文件大小，最后将文件指针重置到文件开头
+ * 种子先经过 splitmix64 混合，避免相近的种子（如相邻的时间戳）产生相关的序列，
+ * 也保证 xorshift 状态不为 0。
  *
- * @param chip8_file 指向CHIP-8游戏文件的文件指针
- * @return 文件大小，以字节为单位如果文件指针为空，则返回-1
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param seed 任意 64 位种子
  */
-static byte get_chip8_file_size(FILE *chip8_file)
+void chip8_seed(CHIP8 *chip8, qword seed)
 {
-    if(chip8_file == NULL){
-        printf("chip8_file is NULL\n");
-        return -1;
-    }
-    // 获取文件大小   
-    fseek(chip8_file, 0, SEEK_END);
-    long file_size = ftell(chip8_file);
-    // 重置文件指针
-    rewind(chip8_file);
-    return file_size;
+    chip8->rng = chip8_seed_state(seed);
 }
 
 /**
- * 将CHIP-8文件数据以十六进制格式打印出来。
- * 此函数的目的是用于调试或验证CHIP-8文件是否正确加载或处理。
- * 它以每行16个字节的格式打印数据，确保输出具有良好的可读性。
+ * chip8_seed_state 把种子混合为 xorshift 状态，chip8_seed 和 SIMD 通道（lanes.h）共用。
  *
- * @param chip8_file_data 指向CHIP-8文件数据的指针。
- * @param chip8_file_size CHIP-8文件的大小，以字节为单位。
+ * @param seed 任意 64 位种子
+ * @return 非 0 的随机数状态
  */
-static void get_ch8_hex(byte *chip8_file_data, size_t chip8_file_size)
+qword chip8_seed_state(qword seed)
 {
-    for (int  i = 0; i < chip8_file_size; i++)
-    {
-        printf("%02x ", chip8_file_data[i]);
-        if ((i+1) % 16 == 0)
-            printf("\n");
+    qword z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+/**
+ * chip8_free 释放 chip8_init 分配的 CHIP8 结构体及其译码缓存和 JIT 上下文。
+ * chip8_setup 初始化的实例使用 chip8_teardown。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针，可以为 NULL
+ */
+void chip8_free(CHIP8 *chip8)
+{
+    if (chip8 == NULL)
+        return;
+    chip8_teardown(chip8);
+    free(chip8);
+}
+
+/**
+ * chip8_set_log 设置实例的日志回调。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param log 日志回调，NULL 表示不输出日志
+ * @param user 原样传给回调的指针
+ */
+void chip8_set_log(CHIP8 *chip8, chip8_log_func log, void *user)
+{
+    chip8->log = log;
+    chip8->log_user = user;
+}
+
+/**
+ * chip8_log 格式化一条日志并交给实例的日志回调，没有回调时直接返回。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param level 日志级别
+ * @param format printf 格式串
+ */
+void chip8_log(CHIP8 *chip8, enum chip8_log_level level, const char *format, ...)
+{
+    if (chip8->log == NULL)
+        return;
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    chip8->log(chip8->log_user, level, message);
+}
+
+/**
+ * chip8_fault 由处理函数调用，报告执行中的故障。
+ *
+ * pc 退回到故障指令，之后再执行到它会再次报告同一故障而不改变状态。
+ * 各分派引擎执行完故障指令即返回，chip8_emulate_cycles 把所在帧段的剩余部分计入 cycles 后停止。
+ * 只有第一次故障被记录和输出。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param error 故障类型
+ */
+void chip8_fault(CHIP8 *chip8, enum chip8_error error)
+{
+    chip8->pc -= 2;
+    if (chip8->error != CHIP8_OK)
+        return;
+    chip8->error = error;
+    chip8_log(chip8, CHIP8_LOG_ERROR, "%s at pc 0x%03X (opcode 0x%04X)",
+              chip8_error_string(error), chip8->pc, chip8->opcode);
+}
+
+const char *chip8_error_string(enum chip8_error error)
+{
+    switch (error) {
+        case CHIP8_OK:
+            return "no error";
+        case CHIP8_ERROR_STACK_OVERFLOW:
+            return "stack overflow";
+        case CHIP8_ERROR_STACK_UNDERFLOW:
+            return "stack underflow";
+        case CHIP8_ERROR_ROM_TOO_LARGE:
+            return "ROM larger than program memory";
+        case CHIP8_ERROR_ROM_OPEN:
+            return "cannot open ROM file";
+        default:
+            return "unknown error";
     }
 }
 
+/**
+ * chip8_load_buffer 把调用者提供的程序复制到内存 0x200 处。
+ *
+ * 不做任何文件操作，批处理可以把同一个 ROM 映射（rom.h）或缓冲区
+ * 并发加载到任意多个实例中。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param data 程序数据
+ * @param size 程序大小，不能超过 CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR
+ * @return 成功返回 CHIP8_OK，程序过大返回 CHIP8_ERROR_ROM_TOO_LARGE
+ */
+int chip8_load_buffer(CHIP8 *chip8, const byte *data, size_t size)
+{
+    if (size > CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR)
+        return CHIP8_ERROR_ROM_TOO_LARGE;
+    memcpy(chip8->memory + CHIP8_MEMORY_START_ADDR, data, size);
+    chip8_aot_attach(chip8, data, size);
+    // 新程序覆盖了代码区，之前的译码结果全部作废
+    chip8_invalidate_code(chip8, CHIP8_MEMORY_START_ADDR, (word)size);
+    return CHIP8_OK;
+}
+
 /**
  * chip8_load_program 函数用于加载 CHIP-8 程序到 CHIP8 结构体中。
- * 
+ *
  * @param chip8 指向 CHIP8 结构体的指针，该结构体包含 CHIP-8 解释器的状态和内存。
- * @param rom 指向程序 ROM 的指针，该 ROM 是要加载到 CHIP-8 内存中的程序数据。
- * 
- * @return 返回一个 byte 类型的值，表示程序加载的状态。通常用于指示加载是否成功。
- * 
- * 此函数的主要职责是将 CHIP-8 程序（ROM）加载到 CHIP8 结构体的内存中，
- * 以便后续执行。它会根据提供的 rom 数据填充 CHIP8 结构体的相应部分。
+ * @param chip8_file ROM 文件路径
+ *
+ * @return 成功返回 CHIP8_OK，文件无法打开返回 CHIP8_ERROR_ROM_OPEN，
+ *         超过 CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR 字节返回 CHIP8_ERROR_ROM_TOO_LARGE。
+ *
+ * 文件以只读方式映射（见 rom.h）后经 chip8_load_buffer 复制到内存，
+ * 大小由 fstat 得到，不会被截断。
  */
-byte chip8_load_program(CHIP8 *chip8, const char *chip8_file)
+int chip8_load_program(CHIP8 *chip8, const char *chip8_file)
 {
-    FILE *fp = fopen(chip8_file, "rb");
-    long size =  get_chip8_file_size(fp);
-    if (size > CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR) {
-        fprintf(stderr, "ROM file size is too large\n");
-        return -1;
-    }
-    
-    byte *data = chip8->memory + CHIP8_MEMORY_START_ADDR; // 起始地址512
-    size_t read_size = fread((void*)chip8_file, 1, size, fp);
-    if (read_size != size) {
-        fprintf(stderr, "ROM file read error\n");
-        return -1;
+    CHIP8_ROM rom;
+    int error = chip8_rom_open(&rom, chip8_file);
+    if (error != CHIP8_OK)
+    {
+        chip8_log(chip8, CHIP8_LOG_ERROR, "cannot load ROM file %s: %s", chip8_file,
+                  chip8_error_string((enum chip8_error)error));
+        return error;
     }
-    get_ch8_hex(data, size);
-    fclose(fp);
-    return 0;
+    error = chip8_load_buffer(chip8, rom.data, rom.size);
+    chip8_rom_close(&rom);
+    return error;
 }
 
-// TODO:
+/**
+ * chip8_emulate_cycle 以两级 switch 译码执行一条指令。
+ *
+ * 这是各分派引擎的参考实现：dispatch.c 中的 TABLE/GOTO 引擎必须与它的行为完全一致，
+ * 在不支持其他引擎时它也是回退路径。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
 void chip8_emulate_cycle(CHIP8 *chip8)
 {
-    // 取指
-    word opcode = (0xFF00 & (chip8->memory[chip8->pc] << 8)) 
-        | chip8->memory[chip8->pc + 1];
+    // 取指，地址按 4 KB 绕回，pc 越过内存末尾时不会读到内存之外
+    word opcode = (0xFF00 & (chip8->memory[chip8->pc & (CHIP8_MEMORY_SIZE - 1)] << 8))
+        | chip8->memory[(chip8->pc + 1) & (CHIP8_MEMORY_SIZE - 1)];
+    CHIP8_PROFILE_INSN(chip8, chip8->pc, chip8_decode(opcode));
     // 保存
     chip8->opcode = opcode;
     // 跳转 更新程序计数器
@@ -147,7 +288,7 @@ void chip8_emulate_cycle(CHIP8 *chip8)
             else if (opcode == 0x00EE)
                 OPCODE(00EE);
             else 
-                break;
+                OPCODE(unknown);
             break;
         case 0x1:
             OPCODE(1NNN);
@@ -201,6 +342,7 @@ void chip8_emulate_cycle(CHIP8 *chip8)
                 OPCODE(8XYE);
                 break;
             default:
+                OPCODE(unknown);
                 break;
             }
             break;
@@ -225,7 +367,7 @@ void chip8_emulate_cycle(CHIP8 *chip8)
             else if (NN(_OPCODE) == 0xA1)
                 OPCODE(EXA1);
             else
-                break;
+                OPCODE(unknown);
             break;
         case 0xF:
             switch (NN(_OPCODE))
@@ -239,6 +381,9 @@ void chip8_emulate_cycle(CHIP8 *chip8)
             case 0x15:
                 OPCODE(FX15);
                 break;
+            case 0x18:
+                OPCODE(FX18);
+                break;
             case 0x1E:
                 OPCODE(FX1E);
                 break;
@@ -255,30 +400,52 @@ void chip8_emulate_cycle(CHIP8 *chip8)
                 OPCODE(FX65);
                 break;
             default:
-                fprintf(stderr, "Unknown opcode: 0x%04X\n", opcode);
+                OPCODE(unknown);
                 break;
             }
             break;
         default:
-            fprintf(stderr, "Unknown opcode: 0x%04X\n", opcode);
+            OPCODE(unknown);
             break;
     }
+    // 执行后再计数，处理函数看到的 cycles 与各分派引擎一致（定时器按它换算帧号）
+    chip8->cycles++;
 }
 
 /**
- * chip8_timer 减少chip8的计时器值
- * 延迟计时器通常用于控制游戏逻辑的延迟。例如，某些操作（如角色移动、动画更新）
- * 需要在一定时间间隔内执行。
- * 它是一个倒计时器，当计时器的值大于 0 时，会逐帧递减，直到为 0。
- * 声音计时器用于控制声音的播放。当声音计时器的值大于 0 时，模拟器通常会播放蜂鸣声
+ * chip8_display_hash 计算帧缓冲内容的 FNV-1a 64 位哈希。
  *
- * @param chip8 指向chip8结构体的指针，该结构体包含计时器成员
+ * 用于批处理和回归比对：两个实例画面相同则哈希相同，不需要保存整帧。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @return 帧缓冲哈希
  */
-void chip8_timer(CHIP8 *chip8)
+qword chip8_display_hash(const CHIP8 *chip8)
 {
-    if (chip8->delay_timer > 0)
-        chip8->delay_timer--;
+    const byte *p = (const byte *)chip8->display;
+    qword hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < sizeof(chip8->display); i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
 
-    if (chip8->sound_timer > 0)
-        chip8->sound_timer--;
-}
\ No newline at end of file
+/**
+ * chip8_display_to_argb 把 1bpp 帧缓冲展开为 ARGB 像素，只在显示时调用。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param pixels 输出缓冲区，CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT 个像素，按行存放
+ * @param on 点亮像素的颜色
+ * @param off 熄灭像素的颜色
+ */
+void chip8_display_to_argb(const CHIP8 *chip8, dword *pixels, dword on, dword off)
+{
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++)
+    {
+        qword row = chip8->display[y];
+        for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x++)
+            *pixels++ = (row & CHIP8_DISPLAY_ROW_BIT(x)) ? on : off;
+    }
+}
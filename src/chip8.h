@@ -10,10 +10,12 @@
 /// ************************** Chip8-c运行频率和定时器 ****************************** ///
 // chip8 运行频率540Hz
 #define CHIP8_CYCLES_FREQ_HZ 540
-// 每个周期延迟时间
-#define CHIP8_CYCLES_DELAY_MS(X) (1000000 / (X))
-// 定时器的更新频率
-#define CHIP8_TIMER_FREQ_HZ (1000000 / 60)
+// 定时器和显示的更新频率：每帧执行一批指令，然后更新一次定时器（见 sched.h）
+#define CHIP8_FRAME_HZ 60
+// 每帧的时长（纳秒）
+#define CHIP8_FRAME_NS (1000000000ULL / CHIP8_FRAME_HZ)
+// 每个 60 Hz 定时器周期内执行的指令数
+#define CHIP8_CYCLES_PER_FRAME (CHIP8_CYCLES_FREQ_HZ / CHIP8_FRAME_HZ)
 /// ****************************************************************************** ///
 
 
@@ -42,10 +44,13 @@
 // |  interpreter  |
 // +---------------+= 0x000 (0) Start of Chip-8 RAM
 
-// chip-8 内存大小(4 KB)
+// chip-8 内存大小(4 KB)，取指和访存的地址都按 4 KB 绕回，不会越过内存末尾
 #define CHIP8_MEMORY_SIZE 4096
 // chip-8 程序加载的起始地址（0x200）
 #define CHIP8_MEMORY_START_ADDR 0x200
+// 写内存跟踪的页大小：4 KB 共 32 页，CHIP8::memory_dirty 每页一位
+#define CHIP8_MEMORY_PAGE_SIZE 128
+#define CHIP8_MEMORY_PAGES (CHIP8_MEMORY_SIZE / CHIP8_MEMORY_PAGE_SIZE)
 
 
 /// *****************************Chip8-c外设配置********************************** ///
@@ -67,8 +72,11 @@
 // |(0,31)	(63,31)|
 // -----------------
 // chip-8 显示分辨率（64x32）
-#define CHIP8_DISPLAY_HEIGHT 64
-#define CHIP8_DISPLAY_WIDTH 32
+#define CHIP8_DISPLAY_WIDTH 64
+#define CHIP8_DISPLAY_HEIGHT 32
+// 帧缓冲按 1bpp 存储：每行一个 64 位字，最高位为 x = 0，整屏 256 字节。
+// ARGB 只在显示时由 chip8_display_to_argb 展开。
+#define CHIP8_DISPLAY_ROW_BIT(x) (0x8000000000000000ULL >> (x))
 
 // Chip-8 draws graphics on screen through the use of 
 // sprites. A sprite is a group of bytes which are a
@@ -91,6 +99,11 @@
 #define CHIP8_FONTSET_MEM_START_ADDR 0x50
 // Chip-8字符集数据定义
 extern uint8_t chip8_fontset[];
+
+///                                 Quirks
+// 不同解释器在细节上的差异，保存在 CHIP8::quirks 中，默认全部关闭
+// DXYN 精灵超出屏幕边缘时绕回到另一侧（默认裁剪）
+#define CHIP8_QUIRK_WRAP_SPRITES 0x01
 /// ****************************************************************************** ///
 
 
@@ -98,6 +111,7 @@ extern uint8_t chip8_fontset[];
 typedef uint8_t byte;
 typedef uint16_t word;
 typedef uint32_t dword;
+typedef uint64_t qword;
 /// ****************************************************************************** ///
 
 
@@ -111,6 +125,134 @@ enum system_state
 /// ****************************************************************************** ///
 
 
+/// ***************************Chip-8错误与日志************************************ ///
+// 核心不调用 exit，也不直接输出到 stdout/stderr：
+// 加载等 API 以返回值报告错误；执行中的故障（调用栈溢出等）记录在 CHIP8::error 中，
+// 故障指令的 pc 保持不变，chip8_emulate_cycles 在所在的帧段结束后停止并不再执行，
+// 恢复快照或重新初始化后才能继续。一个 ROM 出错不会影响同一进程中的其他实例。
+enum chip8_error
+{
+    CHIP8_OK,                        // 无错误
+    CHIP8_ERROR_STACK_OVERFLOW,      // 2NNN 时调用栈已满
+    CHIP8_ERROR_STACK_UNDERFLOW,     // 00EE 时调用栈为空
+    CHIP8_ERROR_ROM_TOO_LARGE,       // 程序超过 CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR 字节
+    CHIP8_ERROR_ROM_OPEN             // ROM 文件无法打开、不是普通文件或无法映射
+};
+
+// 日志级别
+enum chip8_log_level
+{
+    CHIP8_LOG_DEBUG,
+    CHIP8_LOG_INFO,
+    CHIP8_LOG_WARN,
+    CHIP8_LOG_ERROR
+};
+
+// 日志回调：user 为 chip8_set_log 传入的指针，message 不含换行，回调返回后失效。
+// 没有设置回调时核心不输出任何日志。
+typedef void (*chip8_log_func)(void *user, enum chip8_log_level level, const char *message);
+/// ****************************************************************************** ///
+
+
+/// ***************************Chip-8分派引擎************************************** ///
+// 指令分派引擎：
+//   SWITCH：chip8_emulate_cycle 中的两级 switch 译码（参考实现/回退路径）
+//   TABLE ：以完整 16 位操作码为下标的 64K 操作码编号表，再经处理函数表间接调用
+//   GOTO  ：GCC/Clang 的 computed goto 线程化分派，常见指令展开在各自的标签处，每条指令后各自跳转
+//   CACHE ：按 pc 缓存已译码指令和操作数，命中时跳过取指和译码
+//   JIT   ：把基本块翻译为 x86-64 本地代码（jit.c），其他平台退化为 CACHE
+//   AOT   ：执行 chip8_aotc 为这个 ROM 预编译的代码（aot.h），没有时退化为 CACHE
+enum chip8_engine
+{
+    CHIP8_ENGINE_SWITCH,
+    CHIP8_ENGINE_TABLE,
+    CHIP8_ENGINE_GOTO,
+    CHIP8_ENGINE_CACHE,
+    CHIP8_ENGINE_JIT,
+    CHIP8_ENGINE_AOT,
+    CHIP8_ENGINE_COUNT
+};
+
+// computed goto 是 GNU 扩展，其他编译器上 GOTO 和 CACHE 引擎退化为 SWITCH
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_HAVE_COMPUTED_GOTO 1
+#else
+#define CHIP8_HAVE_COMPUTED_GOTO 0
+#endif
+
+// x86-64 JIT 只在 x86-64 的 Linux/macOS 上可用，可由构建系统通过 -DCHIP8_ENABLE_JIT=0 关闭
+#ifndef CHIP8_ENABLE_JIT
+#define CHIP8_ENABLE_JIT 1
+#endif
+#if CHIP8_ENABLE_JIT && defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CHIP8_HAVE_JIT 1
+#else
+#define CHIP8_HAVE_JIT 0
+#endif
+
+// 默认引擎，可由构建系统通过 -DCHIP8_DEFAULT_ENGINE=CHIP8_ENGINE_xxx 覆盖。
+// TABLE 的间接调用不比 switch 快，没有 computed goto 时默认使用 SWITCH
+#ifndef CHIP8_DEFAULT_ENGINE
+#if CHIP8_HAVE_COMPUTED_GOTO
+#define CHIP8_DEFAULT_ENGINE CHIP8_ENGINE_GOTO
+#else
+#define CHIP8_DEFAULT_ENGINE CHIP8_ENGINE_SWITCH
+#endif
+#endif
+/// ****************************************************************************** ///
+
+
+/// ***************************Chip-8译码缓存************************************** ///
+// 每个偶数地址一项，缓存已译码的指令：分派编号和预先提取的操作数，CACHE 引擎直接使用这些操作数。
+// 分派编号为 0 表示该项无效，执行到时重新译码。
+// 程序写内存（FX33/FX55）或加载 ROM 时通过 chip8_invalidate_code 使对应项失效，
+// 因此自修改代码的 ROM 仍能正确执行。奇数地址上的指令不缓存。
+//
+// 译码时还把常见的指令序列融合为超级指令（CHIP8::fuse 打开时）：缓存项的分派编号指向超级指令，一次
+// 执行这条指令和其后的 fused 条指令，只分派一次。融合只记在序列首条指令的缓存项上，
+// 后面的指令仍有各自的缓存项，跳过或跳转落在序列中间时照常逐条执行；
+// 写入序列中任何一条指令都会使首条指令的缓存项失效。
+#define CHIP8_FUSE_MAX 4             // 一个超级指令最多包含的指令数
+
+/// 超级指令的种类（X-macro）
+//   6XNN_RUN ：连续的 6XNN（最多 CHIP8_FUSE_MAX 条）
+//   ANNN_DXYN：设置 I 后绘制精灵
+//   ANNN_FX65：设置 I 后读取寄存器
+//   ANNN_FX1E：设置 I 后加上 VX（查表）
+//   7XNN_3XNN、7XNN_4XNN：循环计数器加一后比较跳过
+#define CHIP8_FUSION_LIST(F) \
+    F(6XNN_RUN) F(ANNN_DXYN) F(ANNN_FX65) F(ANNN_FX1E) F(7XNN_3XNN) F(7XNN_4XNN)
+
+#define CHIP8_FUSION_ENUM(N) CHIP8_FUSION_##N,
+enum chip8_fusion
+{
+    CHIP8_FUSION_NONE,
+    CHIP8_FUSION_LIST(CHIP8_FUSION_ENUM)
+    CHIP8_FUSION_COUNT
+};
+#undef CHIP8_FUSION_ENUM
+
+struct chip8_system;
+typedef void (*opcode_func)(struct chip8_system *chip8);
+typedef struct chip8_insn
+{
+    word opcode;                     // 完整操作码
+    word nnn;                        // 12 位地址 NNN（8 位常量 NN、4 位常量 N 为其低位）
+    byte x;                          // 寄存器索引 X
+    byte y;                          // 寄存器索引 Y
+    byte op;                         // 分派编号：0 表示未译码，否则为 enum chip8_op 加一，融合时为 CHIP8_OP_COUNT 加超级指令种类
+    byte fused;                      // 融合的后续指令数，0 表示没有融合
+} CHIP8_INSN;
+
+// 译码缓存项数：4 KB 地址空间中每个偶数地址一项
+#define CHIP8_ICACHE_SIZE (CHIP8_MEMORY_SIZE / 2)
+
+// 预编译代码按 16 字节的粒度判断内存是否被改写，CHIP8::aot_stale 每个粒度一位
+#define CHIP8_AOT_GRANULE 16
+struct chip8_aot_program;
+/// ****************************************************************************** ///
+
+
 /// ***************************Chip-8系统结构体************************************* ///
 typedef struct chip8_system
 {
@@ -121,22 +263,127 @@ typedef struct chip8_system
     word opcode;                     // 当前操作码
     word stack[16];                  // 调用栈，用于存储返回地址。
     byte sp;                         // 调用栈指针
-    byte delay_timer;                // 延迟定时器
-    byte sound_timer;                // 音频定时器
-    dword display[CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WIDTH]; // 显示缓冲区，存储像素状态。
+    qword delay_deadline;            // 延迟定时器归零的帧号，当前值由 chip8_delay_timer 计算
+    qword sound_deadline;            // 音频定时器归零的帧号，当前值由 chip8_sound_timer 计算
+    qword display[CHIP8_DISPLAY_HEIGHT]; // 1bpp 显示缓冲区，每行一个 64 位字
     byte keys[CHIP8_KEY_SIZE];       // 键盘状态，记录按键是否按下。
-    byte display_refresh_flags;      // 标志是否需要刷新显示。
+    dword display_dirty_rows;        // 脏行位图：第 y 位表示第 y 行自上次显示后被修改
     enum system_state state;         // 系统状态（退出、运行、暂停）
+    byte quirks;                     // 兼容性选项（CHIP8_QUIRK_*）
+    enum chip8_engine engine;        // chip8_emulate_cycles 使用的分派引擎
+    qword cycles;                    // 已执行的指令数（包括空转检测跳过的）
+    byte idle_skip;                  // 是否检测并跳过空转循环，chip8_init 默认打开
+    qword skipped_cycles;            // 空转检测跳过的指令数
+    byte fuse;                       // 译码缓存是否融合超级指令，chip8_init 默认打开，只影响之后译码的缓存项
+    qword fused_cycles;              // 作为超级指令的后续部分执行（省去分派）的指令数
+    qword rng;                       // CXNN 使用的 xorshift64* 随机数状态，由 chip8_seed 设置
+    enum chip8_error error;          // 执行中的故障，非 CHIP8_OK 时不再执行
+    dword memory_dirty;              // 写过的内存页位图，由 chip8_invalidate_code 设置，chip8_fork_* 清除
+    CHIP8_INSN *icache;              // 译码缓存（CHIP8_ICACHE_SIZE 项），NULL 表示不使用
+    struct chip8_jit *jit;           // JIT 上下文，首次使用 JIT 引擎时创建
+    const struct chip8_aot_program *aot; // 与加载的 ROM 匹配的预编译程序（aot.h），没有时为 NULL
+    qword aot_stale[CHIP8_MEMORY_SIZE / CHIP8_AOT_GRANULE / 64]; // 内容与编译时不同的粒度
+    chip8_log_func log;              // 日志回调，NULL 表示不输出
+    void *log_user;                  // 传给日志回调的指针
+    struct chip8_profile *profile;   // 剖析计数器（profile.h），NULL 表示不统计
 
 }CHIP8;
 /// ****************************************************************************** ///
 
 
 /// *********************************chip8函数声明********************************* ///
-CHIP8 *chip8_init();                                    // 初始化chip8系统
-byte chip8_load_program(CHIP8 *chip8, const char *chip8_file); // 加载程序
-void chip8_emulate_cycle(CHIP8 *chip8);                 // 模拟一个周期
-void chip8_timer(CHIP8 *chip8);                         // 执行一个CPU周期
+CHIP8 *chip8_init();                                    // 分配并初始化chip8系统，内存不足返回 NULL
+void chip8_free(CHIP8 *chip8);                          // 释放chip8_init分配的chip8系统
+void chip8_setup(CHIP8 *chip8, CHIP8_INSN *icache);     // 在调用者的内存中初始化，不分配内存
+void chip8_teardown(CHIP8 *chip8);                      // 释放运行中创建的资源，不释放 chip8 和 icache
+int chip8_load_program(CHIP8 *chip8, const char *chip8_file); // 加载程序，失败返回 chip8_error
+int chip8_load_buffer(CHIP8 *chip8, const byte *data, size_t size); // 从缓冲区加载程序，失败返回 chip8_error
+void chip8_set_log(CHIP8 *chip8, chip8_log_func log, void *user); // 设置日志回调，log 为 NULL 时关闭
+void chip8_log(CHIP8 *chip8, enum chip8_log_level level, const char *format, ...); // 经日志回调输出
+void chip8_fault(CHIP8 *chip8, enum chip8_error error); // 处理函数报告故障，停在当前指令
+const char *chip8_error_string(enum chip8_error error); // 错误码的说明
+void chip8_emulate_cycle(CHIP8 *chip8);                 // 模拟一个周期（switch 参考实现）
+dword chip8_emulate_cycles(CHIP8 *chip8, dword cycles); // 使用 chip8->engine 连续执行多个周期
+void chip8_invalidate_code(CHIP8 *chip8, word addr, word len); // 使 [addr, addr+len) 的译码缓存失效
+
+#if CHIP8_HAVE_JIT
+dword chip8_jit_run(CHIP8 *chip8, dword cycles);             // JIT 引擎执行多个周期
+void chip8_jit_invalidate(CHIP8 *chip8, word addr, word len); // 丢弃覆盖 [addr, addr+len) 的已编译块
+void chip8_jit_free(CHIP8 *chip8);                           // 释放 JIT 上下文
+#endif
+dword chip8_aot_run(CHIP8 *chip8, dword cycles);             // AOT 引擎执行多个周期
+void chip8_aot_invalidate(CHIP8 *chip8, word addr, word len); // 重新判断覆盖 [addr, addr+len) 的粒度是否过期
+void chip8_aot_attach(CHIP8 *chip8, const byte *data, size_t size); // 为加载的 ROM 选择预编译程序
+void chip8_seed(CHIP8 *chip8, qword seed);              // 设置随机数种子，相同种子产生相同序列
+qword chip8_seed_state(qword seed);                      // 种子经 splitmix64 混合后的随机数状态
+qword chip8_display_hash(const CHIP8 *chip8);           // 帧缓冲内容的 64 位哈希
+void chip8_display_to_argb(const CHIP8 *chip8, dword *pixels, dword on, dword off); // 帧缓冲展开为 ARGB
+/// ****************************************************************************** ///
+
+
+/// *********************************定时器**************************************** ///
+// 定时器不逐帧递减，而是记录归零时刻：时间以帧计，由已执行的指令数换算
+// （每 CHIP8_CYCLES_PER_FRAME 条指令一帧），FX15/FX18 设置截止帧号，
+// FX07 和音频层读取时再计算当前值。停着不动的实例没有任何定时器开销，
+// 快进时直接累加 cycles 即可，不需要模拟每一次递减。
+// 第 k 条指令（k 为执行前的 cycles）属于第 k / CHIP8_CYCLES_PER_FRAME 帧，
+// 与原来“每帧执行完一批指令后递减一次”的行为完全相同。
+// 各分派引擎在调用处理函数之前把 cycles 写回为已执行的指令数，处理函数中读到的总是 k。
+
+// 当前帧号
+static inline qword chip8_frame(const CHIP8 *chip8)
+{
+    return chip8->cycles / CHIP8_CYCLES_PER_FRAME;
+}
+
+// 距截止帧号的剩余帧数，已过期为 0
+static inline byte chip8_timer_value(const CHIP8 *chip8, qword deadline)
+{
+    qword frame = chip8_frame(chip8);
+    return deadline > frame ? (byte)(deadline - frame) : 0;
+}
+
+// 延迟定时器的当前值
+static inline byte chip8_delay_timer(const CHIP8 *chip8)
+{
+    return chip8_timer_value(chip8, chip8->delay_deadline);
+}
+
+// 音频定时器的当前值，非 0 时应发出蜂鸣声
+static inline byte chip8_sound_timer(const CHIP8 *chip8)
+{
+    return chip8_timer_value(chip8, chip8->sound_deadline);
+}
+/// ****************************************************************************** ///
+
+
+/// *********************************随机数**************************************** ///
+// 每个实例独立的 xorshift64* 生成器，不共享 libc 的全局状态，
+// 多个实例可以在不同线程中无锁运行，且给定种子后结果可重现。
+// chip8_init 使用固定的默认种子，需要随机性时由调用者以时间等设置种子。
+#define CHIP8_DEFAULT_SEED 0x43484950382D63ULL
+
+/**
+ * chip8_random_next 推进一个随机数状态并生成下一个随机字节。
+ *
+ * @param rng 随机数状态（CHIP8::rng 或 SIMD 通道的状态）
+ * @return 0-255 的随机数（取乘积的最高 8 位，质量最好）
+ */
+static inline byte chip8_random_next(qword *rng)
+{
+    qword x = *rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng = x;
+    return (byte)((x * 0x2545F4914F6CDD1DULL) >> 56);
+}
+
+// 实例的下一个随机字节
+static inline byte chip8_random(CHIP8 *chip8)
+{
+    return chip8_random_next(&chip8->rng);
+}
 /// ****************************************************************************** ///
 
 
@@ -166,9 +413,27 @@ void chip8_timer(CHIP8 *chip8);                         // 执行一个CPU周期
 
 
 /// ********************************操作码函数声明********************************** ///
-typedef void (*opcode_func)(CHIP8 *chip8);
 #define OPCODE(N) opcode_##N(chip8)
 
+/// 全部操作码处理函数的列表（X-macro），用于生成操作码编号、分派表和跳转标签
+#define CHIP8_OPCODE_LIST(OP) \
+    OP(00E0) OP(00EE) OP(1NNN) OP(2NNN) OP(3XNN) OP(4XNN) OP(5XY0) OP(6XNN) \
+    OP(7XNN) OP(8XY0) OP(8XY1) OP(8XY2) OP(8XY3) OP(8XY4) OP(8XY5) OP(8XY6) \
+    OP(8XY7) OP(8XYE) OP(9XY0) OP(ANNN) OP(BNNN) OP(CXNN) OP(DXYN) OP(EX9E) \
+    OP(EXA1) OP(FX07) OP(FX0A) OP(FX15) OP(FX18) OP(FX1E) OP(FX29) OP(FX33) \
+    OP(FX55) OP(FX65) OP(unknown)
+
+/// 操作码编号：CHIP8_OP_00E0 ... CHIP8_OP_unknown
+#define CHIP8_OP_ENUM(N) CHIP8_OP_##N,
+enum chip8_op
+{
+    CHIP8_OPCODE_LIST(CHIP8_OP_ENUM)
+    CHIP8_OP_COUNT
+};
+
+extern const opcode_func chip8_opcode_handlers[CHIP8_OP_COUNT]; // 按操作码编号索引的处理函数
+enum chip8_op chip8_decode(word opcode);                        // 译码：操作码 -> 操作码编号
+
 void opcode_00E0(CHIP8 *chip8); // 00E0 - CLS 清空屏幕                        
 void opcode_00EE(CHIP8 *chip8); // 00EE - RET 从子程序返回                 
 void opcode_1NNN(CHIP8 *chip8); // 1NNN - JP addr 跳转到地址                   
@@ -190,7 +455,7 @@ void opcode_8XYE(CHIP8 *chip8); // 8XYE - SHL Vx 左移
 void opcode_9XY0(CHIP8 *chip8); // 9XY0 - SNE Vx, Vy 跳过下一个指令               VX != VY
 void opcode_ANNN(CHIP8 *chip8); // ANNN - LD I, addr 设置索引寄存器               I = NNN
 void opcode_BNNN(CHIP8 *chip8); // BNNN - JP V0, addr 跳转到地址                 PC = V0 + NNN
-void opcode_CXNN(CHIP8 *chip8); // CXNN - RND Vx, byte 随机数                   VX = rand() & NN
+void opcode_CXNN(CHIP8 *chip8); // CXNN - RND Vx, byte 随机数                   VX = random & NN
 void opcode_DXYN(CHIP8 *chip8); // DXYN - DRW Vx, Vy, nibble 显示              （VX，VY）显示像素
 void opcode_EX9E(CHIP8 *chip8); // EX9E - SKP Vx 跳过下一个指令                 键盘按下
 void opcode_EXA1(CHIP8 *chip8); // EXA1 - SKNP Vx 跳过下一个指令                键盘未按下
@@ -203,6 +468,7 @@ void opcode_FX29(CHIP8 *chip8); // FX29 - LD F, Vx 设置字符集
 void opcode_FX33(CHIP8 *chip8); // FX33 - LD B, Vx 存储BCD                     Vx的BCD表示存储到I、I+1、I+2
 void opcode_FX55(CHIP8 *chip8); // FX55 - LD [I], Vx 存储寄存器                 V0-Vx存储到I开始地址  
 void opcode_FX65(CHIP8 *chip8); // FX65 - LD Vx, [I] 读取寄存器                 I开始地址读取到V0-Vx
+void opcode_unknown(CHIP8 *chip8); // 未知操作码
 /// ****************************************************************************** ///
 
 #endif
\ No newline at end of file
@@ -0,0 +1,566 @@
+#include "chip8.h"
+#include "input.h"
+#include "rom.h"
+#include "snapshot.h"
+#include <getopt.h>
+
+/// ********************************差分验证********************************** ///
+// 在同一个 ROM、同一组输入和同一个随机数种子上同时运行参考实现和被测引擎，
+// 每隔固定的指令数比较两边的完整机器状态（寄存器、I、pc、调用栈、定时器、
+// 随机数状态、内存和显示），不一致时从上一个一致的检查点逐条定位第一个分歧的指令周期，
+// 再缩减 ROM 和输入得到最小的复现用例。
+//
+// 参考实现是关闭空转检测的 SWITCH 引擎，即逐条调用 chip8_emulate_cycle；
+// 被测引擎默认打开空转检测，空转检测本身也在验证范围之内。
+// 用例来源：命令行给出的 ROM，每个 ROM 的若干个随机变异，以及按操作码模板随机生成的 ROM。
+// 每个用例附带随机的按键事件，以输入日志（input.h）的形式在确定的指令周期生效，
+// 复现用例写成 ROM 和输入日志两个文件，可以直接交给 chip8_diff -R 或 chip8_batch。
+
+#define DIFF_NAME_MAX 512
+#define DIFF_ROM_MAX (CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR)
+// 随机按键事件的平均间隔（指令周期）
+#define DIFF_INPUT_GAP 120
+// 缩减复现用例时最多尝试的次数
+#define DIFF_MINIMIZE_TESTS 4096
+
+// 一个用例：ROM、种子和按键事件
+struct diff_case
+{
+    char name[DIFF_NAME_MAX];
+    byte rom[DIFF_ROM_MAX];
+    size_t size;
+    CHIP8_INPUT_LOG log;             // 种子和按键事件
+};
+
+// 一次比较的结果
+struct diff_result
+{
+    qword cycle;                     // 分歧所在的指令周期（执行完这么多条指令后状态不同）
+    char what[128];                  // 第一个不同的字段及两边的值
+};
+
+static const char *engine_names[CHIP8_ENGINE_COUNT] = { "switch", "table", "goto", "cache", "jit", "aot" };
+
+// 两个实例复用同一块内存，每次运行之前重新初始化
+static CHIP8 instances[2];
+static CHIP8_INSN icaches[2][CHIP8_ICACHE_SIZE];
+
+static struct
+{
+    qword budget;                    // 每个用例的指令数
+    qword interval;                  // 比较间隔（指令周期）
+    byte idle_skip;                  // 被测引擎是否打开空转检测
+    qword executed;                  // 两边实际执行的指令总数
+} diff = { 1000000, 1000, 1, 0 };
+
+static double diff_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// splitmix64：用例生成器的随机数，与核心的 CXNN 随机数无关
+static qword diff_random(qword *state)
+{
+    qword z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+/// ****************************************************************************** ///
+
+
+/// ********************************用例生成********************************** ///
+#define DIFF_OPCODE_NAME(N) #N,
+static const char *opcode_names[CHIP8_OP_COUNT] = { CHIP8_OPCODE_LIST(DIFF_OPCODE_NAME) };
+
+// 按操作码模板生成一条随机指令：X/Y/N/NN 随机，跳转和调用的目标落在 ROM 内的偶数地址
+static word diff_random_insn(qword *rng, size_t size)
+{
+    const char *name = opcode_names[diff_random(rng) % CHIP8_OP_unknown];
+    word opcode = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char c = name[i];
+        int digit = c == 'X' || c == 'Y' || c == 'N' ? (int)(diff_random(rng) & 0xF)
+                  : (c >= 'A' ? c - 'A' + 10 : c - '0');
+        opcode = (word)(opcode << 4 | digit);
+    }
+    if (name[0] == '1' || name[0] == '2' || name[0] == 'B')
+        opcode = (word)((opcode & 0xF000) | (CHIP8_MEMORY_START_ADDR + (diff_random(rng) % (size / 2)) * 2));
+    return opcode;
+}
+
+static void diff_put_insn(byte *rom, size_t offset, word opcode)
+{
+    rom[offset] = (byte)(opcode >> 8);
+    rom[offset + 1] = (byte)opcode;
+}
+
+// 在 [0, budget) 内生成随机按键事件
+static void diff_random_input(CHIP8_INPUT_LOG *log, qword *rng, qword budget)
+{
+    chip8_input_log_init(log, diff_random(rng));
+    for (qword cycle = diff_random(rng) % DIFF_INPUT_GAP; cycle < budget; cycle += 1 + diff_random(rng) % (2 * DIFF_INPUT_GAP))
+    {
+        byte key = (byte)(diff_random(rng) % CHIP8_KEY_SIZE);
+        chip8_input_log_append(log, cycle, key, !log->keys[key]);
+    }
+}
+
+// 随机 ROM：32-2048 条按模板生成的指令
+static void diff_random_rom(struct diff_case *c, qword *rng)
+{
+    c->size = 2 * (16 + diff_random(rng) % 1009);
+    for (size_t i = 0; i < c->size; i += 2)
+        diff_put_insn(c->rom, i, diff_random_insn(rng, c->size));
+}
+
+// 变异：替换一条指令、翻转一位或交换两条指令，共 1-4 处
+static void diff_mutate_rom(struct diff_case *c, qword *rng)
+{
+    if (c->size < 2)
+        return;
+    int count = 1 + (int)(diff_random(rng) % 4);
+    for (int i = 0; i < count; i++)
+    {
+        size_t a = (diff_random(rng) % (c->size / 2)) * 2;
+        switch (diff_random(rng) % 3) {
+            case 0:
+                diff_put_insn(c->rom, a, diff_random_insn(rng, c->size));
+                break;
+            case 1:
+                c->rom[a + diff_random(rng) % 2] ^= (byte)(1u << (diff_random(rng) % 8));
+                break;
+            default:
+            {
+                size_t b = (diff_random(rng) % (c->size / 2)) * 2;
+                byte t0 = c->rom[a], t1 = c->rom[a + 1];
+                c->rom[a] = c->rom[b];
+                c->rom[a + 1] = c->rom[b + 1];
+                c->rom[b] = t0;
+                c->rom[b + 1] = t1;
+                break;
+            }
+        }
+    }
+}
+/// ****************************************************************************** ///
+
+
+/// ********************************锁步比较********************************** ///
+static void diff_start(CHIP8 *chip8, CHIP8_INSN *icache, const struct diff_case *c,
+                       enum chip8_engine engine, byte idle_skip)
+{
+    chip8_setup(chip8, icache);
+    chip8_load_buffer(chip8, c->rom, c->size);
+    chip8_seed(chip8, c->log.seed);
+    chip8->engine = engine;
+    chip8->idle_skip = idle_skip;
+}
+
+// 执行到第 target 个指令周期，按键事件在各自的周期生效；发生故障时提前停止
+static void diff_run(CHIP8 *chip8, CHIP8_INPUT_REPLAY *replay, qword target)
+{
+    qword begin = chip8->cycles;
+    while (chip8->cycles < target && chip8->error == CHIP8_OK)
+    {
+        chip8_input_replay_apply(replay, chip8);
+        qword stop = target;
+        if (chip8_input_replay_next(replay) < stop)
+            stop = chip8_input_replay_next(replay);
+        if (stop - chip8->cycles > UINT32_MAX)
+            stop = chip8->cycles + UINT32_MAX;
+        chip8_emulate_cycles(chip8, (dword)(stop - chip8->cycles));
+    }
+    diff.executed += chip8->cycles - begin;
+}
+
+/**
+ * diff_compare 比较两个实例的完整机器状态。
+ *
+ * 不比较只用于簿记的字段（当前操作码、脏行、空转检测跳过的指令数）。
+ *
+ * @param a 参考实例
+ * @param b 被测实例
+ * @param what 输出第一个不同的字段及两边的值
+ * @param size what 的大小
+ * @return 相同返回 0，不同返回 1
+ */
+static int diff_compare(const CHIP8 *a, const CHIP8 *b, char *what, size_t size)
+{
+#define DIFF_FIELD(cond, ...) do { if (cond) { snprintf(what, size, __VA_ARGS__); return 1; } } while (0)
+    DIFF_FIELD(a->cycles != b->cycles, "cycles %llu != %llu", (unsigned long long)a->cycles, (unsigned long long)b->cycles);
+    DIFF_FIELD(a->error != b->error, "error \"%s\" != \"%s\"", chip8_error_string(a->error), chip8_error_string(b->error));
+    DIFF_FIELD(a->pc != b->pc, "pc %03X != %03X", a->pc, b->pc);
+    DIFF_FIELD(a->index_register != b->index_register, "I %03X != %03X", a->index_register, b->index_register);
+    for (int i = 0; i < 16; i++)
+        DIFF_FIELD(a->registers[i] != b->registers[i], "V%X %02X != %02X", i, a->registers[i], b->registers[i]);
+    DIFF_FIELD(a->sp != b->sp, "sp %u != %u", a->sp, b->sp);
+    for (int i = 0; i < 16; i++)
+        DIFF_FIELD(a->stack[i] != b->stack[i], "stack[%d] %03X != %03X", i, a->stack[i], b->stack[i]);
+    DIFF_FIELD(a->delay_deadline != b->delay_deadline, "delay timer %u != %u",
+               chip8_delay_timer(a), chip8_delay_timer(b));
+    DIFF_FIELD(a->sound_deadline != b->sound_deadline, "sound timer %u != %u",
+               chip8_sound_timer(a), chip8_sound_timer(b));
+    DIFF_FIELD(a->rng != b->rng, "rng %016llx != %016llx", (unsigned long long)a->rng, (unsigned long long)b->rng);
+    for (int i = 0; i < CHIP8_MEMORY_SIZE; i++)
+        DIFF_FIELD(a->memory[i] != b->memory[i], "memory[%03X] %02X != %02X", i, a->memory[i], b->memory[i]);
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++)
+        DIFF_FIELD(a->display[y] != b->display[y], "display row %d (hash %016llx != %016llx)", y,
+                   (unsigned long long)chip8_display_hash(a), (unsigned long long)chip8_display_hash(b));
+    return 0;
+#undef DIFF_FIELD
+}
+
+/**
+ * diff_lockstep 在参考实现和被测引擎上运行用例，每 diff.interval 条指令比较一次。
+ *
+ * 两边都以相同的故障停止时视为一致并结束。发现分歧时，exact 为 0 只报告所在的检查点，
+ * 否则从上一个一致的检查点开始逐个周期重新执行，找出第一个分歧的指令周期。
+ *
+ * @param c 用例
+ * @param engine 被测引擎
+ * @param budget 指令数
+ * @param exact 是否定位到具体的指令周期
+ * @param result 输出分歧的周期和字段
+ * @return 一致返回 0，分歧返回 1
+ */
+static int diff_lockstep(const struct diff_case *c, enum chip8_engine engine, qword budget, byte exact,
+                         struct diff_result *result)
+{
+    CHIP8 *a = &instances[0], *b = &instances[1];
+    CHIP8_INPUT_REPLAY replay_a, replay_b;
+    static CHIP8_SNAPSHOT good;
+    diff_start(a, icaches[0], c, CHIP8_ENGINE_SWITCH, 0);
+    diff_start(b, icaches[1], c, engine, diff.idle_skip);
+    chip8_input_replay_init(&replay_a, &c->log);
+    chip8_input_replay_init(&replay_b, &c->log);
+
+    int diverged = 0;
+    qword target = 0;
+    while (target < budget && !diverged)
+    {
+        if (exact)
+            chip8_snapshot(a, &good);
+        target = budget - target > diff.interval ? target + diff.interval : budget;
+        diff_run(a, &replay_a, target);
+        diff_run(b, &replay_b, target);
+        diverged = diff_compare(a, b, result->what, sizeof(result->what));
+        result->cycle = a->cycles < b->cycles ? a->cycles : b->cycles;
+        if (!diverged && a->error != CHIP8_OK)
+            break;
+    }
+
+    // 两边在 good 处一致，逐个周期重新执行到第一个不同的状态
+    for (qword k = good.cycles + 1; diverged && exact && k <= target; k++)
+    {
+        chip8_restore(a, &good);
+        chip8_restore(b, &good);
+        diff_run(a, &replay_a, k);
+        diff_run(b, &replay_b, k);
+        if (diff_compare(a, b, result->what, sizeof(result->what)))
+        {
+            result->cycle = k;
+            break;
+        }
+    }
+    chip8_teardown(a);
+    chip8_teardown(b);
+    return diverged;
+}
+/// ****************************************************************************** ///
+
+
+/// ********************************用例缩减********************************** ///
+// 贪心缩减：依次尝试删除按键事件、截短 ROM、把 ROM 中的整段指令清零，
+// 保留仍然产生分歧的修改。每次成功后预算缩短到新的分歧检查点，后面的尝试更快。
+struct diff_minimizer
+{
+    enum chip8_engine engine;
+    qword budget;
+    int tests;
+};
+
+static int diff_still_diverges(struct diff_minimizer *m, const struct diff_case *c)
+{
+    struct diff_result result;
+    if (m->tests >= DIFF_MINIMIZE_TESTS)
+        return 0;
+    m->tests++;
+    if (!diff_lockstep(c, m->engine, m->budget, 0, &result))
+        return 0;
+    m->budget = result.cycle;
+    return 1;
+}
+
+static void diff_minimize(struct diff_case *c, enum chip8_engine engine, qword budget)
+{
+    struct diff_minimizer m = { engine, budget, 0 };
+
+    // 删除按键事件，从后往前，删除后其余事件的周期不变
+    for (size_t i = c->log.count; i-- > 0; )
+    {
+        CHIP8_INPUT_EVENT removed = c->log.events[i];
+        memmove(&c->log.events[i], &c->log.events[i + 1], (c->log.count - i - 1) * sizeof(CHIP8_INPUT_EVENT));
+        c->log.count--;
+        if (diff_still_diverges(&m, c))
+            continue;
+        memmove(&c->log.events[i + 1], &c->log.events[i], (c->log.count - i) * sizeof(CHIP8_INPUT_EVENT));
+        c->log.events[i] = removed;
+        c->log.count++;
+    }
+    // 截短 ROM，每次去掉偶数个字节，保持指令对齐
+    for (size_t chunk = c->size / 2 & ~(size_t)1; chunk >= 2; chunk = chunk / 2 & ~(size_t)1)
+        while (c->size > chunk)
+        {
+            c->size -= chunk;
+            if (!diff_still_diverges(&m, c))
+            {
+                c->size += chunk;
+                break;
+            }
+        }
+    // 整段清零，段长从 256 字节减半到一条指令
+    byte saved[256];
+    for (size_t chunk = 256; chunk >= 2; chunk /= 2)
+        for (size_t offset = 0; offset < c->size; offset += chunk)
+        {
+            size_t len = c->size - offset < chunk ? c->size - offset : chunk;
+            size_t nonzero = 0;
+            for (size_t i = 0; i < len; i++)
+                nonzero |= c->rom[offset + i];
+            if (!nonzero)
+                continue;
+            memcpy(saved, c->rom + offset, len);
+            memset(c->rom + offset, 0, len);
+            if (!diff_still_diverges(&m, c))
+                memcpy(c->rom + offset, saved, len);
+        }
+    // 加载后 ROM 之外的内存本来就是 0，末尾的 0 不影响执行
+    while (c->size >= 2 && c->rom[c->size - 1] == 0 && c->rom[c->size - 2] == 0)
+        c->size -= 2;
+}
+/// ****************************************************************************** ///
+
+
+/// ********************************运行与报告********************************** ///
+// ROM 中非零的指令数
+static size_t diff_count_insns(const struct diff_case *c)
+{
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < c->size; i += 2)
+        count += (c->rom[i] | c->rom[i + 1]) != 0;
+    return count;
+}
+
+static int diff_write_file(const char *path, const byte *data, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    size_t written = fwrite(data, 1, size, fp);
+    return fclose(fp) == 0 && written == size ? 0 : -1;
+}
+
+/**
+ * diff_check 用参考实现和每个被测引擎运行一个用例，分歧时输出报告并写出缩减后的复现用例。
+ *
+ * @param c 用例，缩减时会被修改
+ * @param engines 被测引擎
+ * @param out_dir 复现用例的输出目录
+ * @param reproducers 已写出的复现用例数，用于编号
+ * @return 分歧的引擎数
+ */
+static int diff_check(struct diff_case *c, const byte *engines, const char *out_dir, int *reproducers)
+{
+    int failures = 0;
+    for (int e = 0; e < CHIP8_ENGINE_COUNT; e++)
+    {
+        struct diff_result result;
+        if (!engines[e] || !diff_lockstep(c, (enum chip8_engine)e, diff.budget, 1, &result))
+            continue;
+        failures++;
+        printf("DIVERGE %s engine=%s seed=%016llx cycle=%llu %s\n", c->name, engine_names[e],
+               (unsigned long long)c->log.seed, (unsigned long long)result.cycle, result.what);
+
+        struct diff_case *m = (struct diff_case *)malloc(sizeof(struct diff_case));
+        if (m == NULL)
+            continue;
+        *m = *c;
+        chip8_input_log_init(&m->log, c->log.seed);
+        for (size_t i = 0; i < c->log.count; i++)
+            chip8_input_log_append(&m->log, c->log.events[i].cycle, c->log.events[i].key, c->log.events[i].down);
+        // 缩减时的预算留一个检查间隔的余量，分歧点可能随修改后移
+        diff_minimize(m, (enum chip8_engine)e, result.cycle + diff.interval);
+        diff_lockstep(m, (enum chip8_engine)e, result.cycle + diff.interval, 1, &result);
+
+        char rom_path[DIFF_NAME_MAX], log_path[DIFF_NAME_MAX];
+        int n = ++*reproducers;
+        snprintf(rom_path, sizeof(rom_path), "%s/diff-%d.ch8", out_dir, n);
+        snprintf(log_path, sizeof(log_path), "%s/diff-%d.c8in", out_dir, n);
+        if (diff_write_file(rom_path, m->rom, m->size) != 0 || chip8_input_log_save(&m->log, log_path) != 0)
+            fprintf(stderr, "cannot write reproducer to %s\n", out_dir);
+        else
+            printf("  reproducer: %zu bytes (%zu non-zero instructions), %zu input events, diverges at cycle %llu: %s\n"
+                   "  chip8_diff -b %s -n %llu -R %s %s\n",
+                   m->size, diff_count_insns(m), m->log.count, (unsigned long long)result.cycle, result.what,
+                   engine_names[e], (unsigned long long)result.cycle, log_path, rom_path);
+        chip8_input_log_free(&m->log);
+        free(m);
+    }
+    return failures;
+}
+
+static void diff_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-b engine[,engine...]] [-n cycles] [-c interval] [-k] [-m mutants]\n"
+                    "          [-r random] [-S seed] [-R log] [-o dir] [rom...]\n"
+                    "  -b  engines to verify against switch: table,goto,cache,jit,aot (default all)\n"
+                    "  -n  cycles per case (default 1000000)\n"
+                    "  -c  compare full state every this many cycles (default 1000)\n"
+                    "  -k  run the engines under test without idle-loop skipping\n"
+                    "  -m  random mutants per ROM (default 0)\n"
+                    "  -r  random ROMs to generate (default 0, 100 when no ROM is given)\n"
+                    "  -S  generator seed (default: current time)\n"
+                    "  -R  replay this input log on the given ROMs instead of random input\n"
+                    "  -o  directory for minimized reproducers (default .)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    byte engines[CHIP8_ENGINE_COUNT];
+    memset(engines, 1, sizeof(engines));
+    engines[CHIP8_ENGINE_SWITCH] = 0;
+    int mutants = 0;
+    int randoms = -1;
+    qword seed = (qword)time(NULL);
+    const char *replay_path = NULL;
+    const char *out_dir = ".";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:c:km:r:S:R:o:h")) != -1)
+    {
+        switch (opt) {
+            case 'b':
+            {
+                memset(engines, 0, sizeof(engines));
+                char list[256];
+                snprintf(list, sizeof(list), "%s", optarg);
+                for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ","))
+                {
+                    int found = 0;
+                    for (int i = 0; i < CHIP8_ENGINE_COUNT; i++)
+                        if (strcmp(tok, engine_names[i]) == 0)
+                            engines[i] = found = 1;
+                    if (!found)
+                    {
+                        diff_usage(argv[0]);
+                        return 1;
+                    }
+                }
+                break;
+            }
+            case 'n':
+                diff.budget = strtoull(optarg, NULL, 0);
+                break;
+            case 'c':
+                diff.interval = strtoull(optarg, NULL, 0);
+                break;
+            case 'k':
+                diff.idle_skip = 0;
+                break;
+            case 'm':
+                mutants = atoi(optarg);
+                break;
+            case 'r':
+                randoms = atoi(optarg);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'R':
+                replay_path = optarg;
+                break;
+            case 'o':
+                out_dir = optarg;
+                break;
+            default:
+                diff_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (diff.interval < 1)
+        diff.interval = 1;
+    if (randoms < 0)
+        randoms = optind < argc ? 0 : 100;
+    printf("seed %016llx\n", (unsigned long long)seed);
+
+    struct diff_case *c = (struct diff_case *)calloc(1, sizeof(struct diff_case));
+    if (c == NULL)
+        return 1;
+    CHIP8_INPUT_LOG replay_log;
+    if (replay_path && chip8_input_log_load(&replay_log, replay_path) != 0)
+    {
+        fprintf(stderr, "cannot read input log %s\n", replay_path);
+        return 1;
+    }
+
+    qword rng = seed;
+    int cases = 0, failures = 0, reproducers = 0;
+    double start = diff_now_s();
+    for (int i = optind; i < argc; i++)
+    {
+        CHIP8_ROM rom;
+        int error = chip8_rom_open(&rom, argv[i]);
+        if (error != CHIP8_OK)
+        {
+            fprintf(stderr, "cannot read ROM %s: %s\n", argv[i], chip8_error_string((enum chip8_error)error));
+            continue;
+        }
+        for (int m = 0; m <= mutants; m++)
+        {
+            memcpy(c->rom, rom.data, rom.size);
+            c->size = rom.size;
+            if (m == 0)
+                snprintf(c->name, sizeof(c->name), "%s", argv[i]);
+            else
+            {
+                snprintf(c->name, sizeof(c->name), "%s#mutant%d", argv[i], m);
+                diff_mutate_rom(c, &rng);
+            }
+            if (replay_path)
+            {
+                chip8_input_log_init(&c->log, replay_log.seed);
+                for (size_t e = 0; e < replay_log.count; e++)
+                    chip8_input_log_append(&c->log, replay_log.events[e].cycle, replay_log.events[e].key,
+                                           replay_log.events[e].down);
+            }
+            else
+                diff_random_input(&c->log, &rng, diff.budget);
+            failures += diff_check(c, engines, out_dir, &reproducers);
+            chip8_input_log_free(&c->log);
+            cases++;
+        }
+        chip8_rom_close(&rom);
+    }
+    for (int i = 0; i < randoms; i++)
+    {
+        snprintf(c->name, sizeof(c->name), "random#%d", i + 1);
+        diff_random_rom(c, &rng);
+        diff_random_input(&c->log, &rng, diff.budget);
+        failures += diff_check(c, engines, out_dir, &reproducers);
+        chip8_input_log_free(&c->log);
+        cases++;
+    }
+
+    double elapsed = diff_now_s() - start;
+    printf("%d cases, %llu cycles in %.2f s (%.1f MIPS), %d divergences\n", cases,
+           (unsigned long long)diff.executed, elapsed, elapsed > 0 ? diff.executed / elapsed / 1e6 : 0.0, failures);
+    if (replay_path)
+        chip8_input_log_free(&replay_log);
+    free(c);
+    return failures ? 3 : 0;
+}
+/// ****************************************************************************** ///
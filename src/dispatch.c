@@ -0,0 +1,721 @@
+#include "chip8.h"
+#include "profile.h"
+#include <pthread.h>
+
+// 按操作码编号索引的处理函数
+#define CHIP8_OP_HANDLER(N) opcode_##N,
+const opcode_func chip8_opcode_handlers[CHIP8_OP_COUNT] = {
+    CHIP8_OPCODE_LIST(CHIP8_OP_HANDLER)
+};
+
+// 以完整 16 位操作码为下标的分派表，给出操作码编号（64 KB，各引擎共用）。
+// 每项一个字节，整张表可以留在 L2 中；再经 chip8_opcode_handlers 取处理函数
+static byte chip8_opcode_index[0x10000];
+static pthread_once_t chip8_dispatch_once = PTHREAD_ONCE_INIT;
+
+/**
+ * chip8_decode 将操作码译码为操作码编号。
+ *
+ * 译码规则与 chip8_emulate_cycle 中的 switch 完全一致，分派表由它生成，
+ * 因此 TABLE/GOTO 引擎与参考实现不会出现译码差异。
+ *
+ * @param opcode 16 位操作码
+ * @return 操作码编号，无法识别时返回 CHIP8_OP_unknown
+ */
+enum chip8_op chip8_decode(word opcode)
+{
+    switch ((0xF000 & opcode) >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0)
+                return CHIP8_OP_00E0;
+            if (opcode == 0x00EE)
+                return CHIP8_OP_00EE;
+            return CHIP8_OP_unknown;
+        case 0x1: return CHIP8_OP_1NNN;
+        case 0x2: return CHIP8_OP_2NNN;
+        case 0x3: return CHIP8_OP_3XNN;
+        case 0x4: return CHIP8_OP_4XNN;
+        case 0x5: return CHIP8_OP_5XY0;
+        case 0x6: return CHIP8_OP_6XNN;
+        case 0x7: return CHIP8_OP_7XNN;
+        case 0x8:
+            switch (N(opcode)) {
+                case 0x0: return CHIP8_OP_8XY0;
+                case 0x1: return CHIP8_OP_8XY1;
+                case 0x2: return CHIP8_OP_8XY2;
+                case 0x3: return CHIP8_OP_8XY3;
+                case 0x4: return CHIP8_OP_8XY4;
+                case 0x5: return CHIP8_OP_8XY5;
+                case 0x6: return CHIP8_OP_8XY6;
+                case 0x7: return CHIP8_OP_8XY7;
+                case 0xE: return CHIP8_OP_8XYE;
+                default:  return CHIP8_OP_unknown;
+            }
+        case 0x9: return CHIP8_OP_9XY0;
+        case 0xA: return CHIP8_OP_ANNN;
+        case 0xB: return CHIP8_OP_BNNN;
+        case 0xC: return CHIP8_OP_CXNN;
+        case 0xD: return CHIP8_OP_DXYN;
+        case 0xE:
+            if (NN(opcode) == 0x9E)
+                return CHIP8_OP_EX9E;
+            if (NN(opcode) == 0xA1)
+                return CHIP8_OP_EXA1;
+            return CHIP8_OP_unknown;
+        case 0xF:
+            switch (NN(opcode)) {
+                case 0x07: return CHIP8_OP_FX07;
+                case 0x0A: return CHIP8_OP_FX0A;
+                case 0x15: return CHIP8_OP_FX15;
+                case 0x18: return CHIP8_OP_FX18;
+                case 0x1E: return CHIP8_OP_FX1E;
+                case 0x29: return CHIP8_OP_FX29;
+                case 0x33: return CHIP8_OP_FX33;
+                case 0x55: return CHIP8_OP_FX55;
+                case 0x65: return CHIP8_OP_FX65;
+                default:   return CHIP8_OP_unknown;
+            }
+    }
+    return CHIP8_OP_unknown;
+}
+
+// 生成 64K 分派表，只执行一次
+static void chip8_dispatch_build(void)
+{
+    for (dword opcode = 0; opcode < 0x10000; opcode++)
+    {
+        chip8_opcode_index[opcode] = (byte)chip8_decode((word)opcode);
+    }
+}
+
+// 取指：读取 pc 处的操作码并前移 pc，地址按 4 KB 绕回
+#define CHIP8_FETCH(chip8) \
+    ((chip8)->opcode = (word)(((chip8)->memory[(chip8)->pc & (CHIP8_MEMORY_SIZE - 1)] << 8) | \
+                              (chip8)->memory[((chip8)->pc + 1) & (CHIP8_MEMORY_SIZE - 1)]), \
+     (chip8)->pc += 2, \
+     (chip8)->opcode)
+
+// TABLE 引擎：两次查表 + 一次间接调用
+static dword chip8_run_table(CHIP8 *chip8, dword cycles)
+{
+    qword base = chip8->cycles;
+    dword n = 0;
+    while (n < cycles)
+    {
+        word opcode = CHIP8_FETCH(chip8);
+        byte op = chip8_opcode_index[opcode];
+        CHIP8_PROFILE_INSN(chip8, chip8->pc - 2, op);
+        chip8->cycles = base + n++;
+        chip8_opcode_handlers[op](chip8);
+        if (chip8->error != CHIP8_OK)
+            break;
+    }
+    chip8->cycles = base + n;
+    return n;
+}
+
+/**
+ * chip8_invalidate_code 使覆盖 [addr, addr+len) 的译码缓存项失效。
+ *
+ * 所有写内存的路径（FX33、FX55、加载 ROM）都必须调用它，否则自修改代码的 ROM
+ * 会继续执行旧的译码结果。偶数地址项 k 覆盖字节 2k 和 2k+1，融合为超级指令时
+ * 还覆盖其后的指令，所以向前多失效 CHIP8_FUSE_MAX - 1 项。
+ * JIT 已编译的块和预编译代码的块也在这里一并失效，被写的页记入 memory_dirty（fork.h）。
+ * 地址与写内存时一样按 4 KB 绕回。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param addr 被写入的起始地址
+ * @param len 被写入的字节数
+ */
+void chip8_invalidate_code(CHIP8 *chip8, word addr, word len)
+{
+    if (len == 0)
+        return;
+    addr &= CHIP8_MEMORY_SIZE - 1;
+    if ((dword)addr + len > CHIP8_MEMORY_SIZE)
+    {
+        // 越过内存末尾的部分写到了开头
+        chip8_invalidate_code(chip8, 0, (word)(addr + len - CHIP8_MEMORY_SIZE));
+        len = (word)(CHIP8_MEMORY_SIZE - addr);
+    }
+    dword end = (dword)addr + len - 1;
+    chip8->memory_dirty |= (dword)((2ULL << (end / CHIP8_MEMORY_PAGE_SIZE))
+                                   - (1ULL << (addr / CHIP8_MEMORY_PAGE_SIZE)));
+#if CHIP8_HAVE_JIT
+    if (chip8->jit != NULL)
+        chip8_jit_invalidate(chip8, addr, len);
+#endif
+    if (chip8->aot != NULL)
+        chip8_aot_invalidate(chip8, addr, len);
+    if (chip8->icache == NULL)
+        return;
+    dword first = addr >> 1;
+    first = first > CHIP8_FUSE_MAX - 1 ? first - (CHIP8_FUSE_MAX - 1) : 0;
+    for (dword i = first; i <= (end >> 1); i++)
+        chip8->icache[i].op = 0;
+}
+
+#if CHIP8_HAVE_COMPUTED_GOTO
+/// ******************************线程化分派引擎******************************** ///
+// GOTO 和 CACHE 引擎都是 computed goto 线程化分派：每条指令后都有独立的间接跳转，
+// 分支预测器可按前驱指令区分目标。pc、当前操作码和已执行的指令数 n 保存在局部变量中，
+// 常见指令直接展开在各自的标签处（CHIP8_INLINE_xxx），不调用处理函数；
+// 其余指令用 CHIP8_CALL 先把 pc、opcode 和 cycles 写回结构体再调用 opcode.c 中的处理函数，之后重新读取 pc。
+// 展开的指令与处理函数逐位一致（包括 X 或 Y 为 F 时先写 VF 再读的顺序）；
+// 栈溢出和栈下溢仍交给处理函数报告故障并结束本次执行，其余指令都不会发生故障。
+// 比较跳过用分支而不是条件传送，下一条指令的取指不必等待比较结果。
+
+// GCC 的交叉跳转优化会把各标签末尾相同的分派代码合并成一两处间接跳转，
+// 线程化分派就退化成了 switch，因此对这两个引擎关掉它
+#if defined(__GNUC__) && !defined(__clang__)
+#define CHIP8_THREADED __attribute__((optimize("no-crossjumping")))
+#else
+#define CHIP8_THREADED
+#endif
+
+// 调用处理函数执行当前指令（n 已计入这条指令）
+#define CHIP8_CALL(N)                                                               \
+    do {                                                                            \
+        chip8->pc = pc;                                                             \
+        chip8->opcode = opcode;                                                     \
+        chip8->cycles = base + n - 1;                                               \
+        opcode_##N(chip8);                                                          \
+        pc = chip8->pc;                                                             \
+    } while (0)
+
+// 展开执行的指令，x/y/nn/nnn 为操作数
+#define CHIP8_INLINE_00EE(x, y, nn, nnn)                                            \
+    if (chip8->sp == 0)                                                             \
+    {                                                                               \
+        CHIP8_CALL(00EE);                                                           \
+        goto done;                                                                  \
+    }                                                                               \
+    pc = chip8->stack[--chip8->sp]
+#define CHIP8_INLINE_1NNN(x, y, nn, nnn) pc = (nnn)
+#define CHIP8_INLINE_2NNN(x, y, nn, nnn)                                            \
+    if (chip8->sp >= sizeof(chip8->stack) / sizeof(chip8->stack[0]))                \
+    {                                                                               \
+        CHIP8_CALL(2NNN);                                                           \
+        goto done;                                                                  \
+    }                                                                               \
+    chip8->stack[chip8->sp++] = pc;                                                 \
+    pc = (nnn)
+#define CHIP8_INLINE_3XNN(x, y, nn, nnn) if (V[x] == (nn)) pc += 2
+#define CHIP8_INLINE_4XNN(x, y, nn, nnn) if (V[x] != (nn)) pc += 2
+#define CHIP8_INLINE_5XY0(x, y, nn, nnn) if (V[x] == V[y]) pc += 2
+#define CHIP8_INLINE_6XNN(x, y, nn, nnn) V[x] = (nn)
+#define CHIP8_INLINE_7XNN(x, y, nn, nnn) V[x] += (nn)
+#define CHIP8_INLINE_8XY0(x, y, nn, nnn) V[x] = V[y]
+#define CHIP8_INLINE_8XY1(x, y, nn, nnn) V[x] |= V[y]
+#define CHIP8_INLINE_8XY2(x, y, nn, nnn) V[x] &= V[y]
+#define CHIP8_INLINE_8XY3(x, y, nn, nnn) V[x] ^= V[y]
+#define CHIP8_INLINE_8XY4(x, y, nn, nnn)                                            \
+    word add = (word)V[x] + V[y];                                                   \
+    V[x] = (byte)add;                                                               \
+    V[0xF] = (byte)(add >> 8)
+#define CHIP8_INLINE_8XY5(x, y, nn, nnn) V[0xF] = V[x] > V[y]; V[x] -= V[y]
+#define CHIP8_INLINE_8XY6(x, y, nn, nnn) V[0xF] = V[x] & 0x01; V[x] >>= 1
+#define CHIP8_INLINE_8XY7(x, y, nn, nnn) V[0xF] = V[x] < V[y]; V[x] = (byte)(V[y] - V[x])
+#define CHIP8_INLINE_8XYE(x, y, nn, nnn) V[0xF] = V[x] >> 7; V[x] <<= 1
+#define CHIP8_INLINE_9XY0(x, y, nn, nnn) if (V[x] != V[y]) pc += 2
+#define CHIP8_INLINE_ANNN(x, y, nn, nnn) chip8->index_register = (nnn)
+#define CHIP8_INLINE_BNNN(x, y, nn, nnn) pc = (nnn) + V[0]
+#define CHIP8_INLINE_EX9E(x, y, nn, nnn) if (V[x] < 16 && chip8->keys[V[x]]) pc += 2
+#define CHIP8_INLINE_EXA1(x, y, nn, nnn) if (V[x] < 16 && !chip8->keys[V[x]]) pc += 2
+#define CHIP8_INLINE_FX1E(x, y, nn, nnn) chip8->index_register += V[x]
+#define CHIP8_INLINE_FX29(x, y, nn, nnn) \
+    chip8->index_register = chip8->memory[CHIP8_FONTSET_MEM_START_ADDR + 5 * V[x]]
+#define CHIP8_INLINE_FX65(x, y, nn, nnn)                                            \
+    for (int i = 0; i <= (x); i++)                                                  \
+        V[i] = chip8->memory[(chip8->index_register + i) & (CHIP8_MEMORY_SIZE - 1)]
+
+// 展开执行的指令
+#define CHIP8_INLINE_LIST(OP) \
+    OP(00EE) OP(1NNN) OP(2NNN) OP(3XNN) OP(4XNN) OP(5XY0) OP(6XNN) OP(7XNN) \
+    OP(8XY0) OP(8XY1) OP(8XY2) OP(8XY3) OP(8XY4) OP(8XY5) OP(8XY6) OP(8XY7) \
+    OP(8XYE) OP(9XY0) OP(ANNN) OP(BNNN) OP(EX9E) OP(EXA1) OP(FX1E) OP(FX29) OP(FX65)
+// 访问显示、定时器、随机数或写内存，调用处理函数的指令
+#define CHIP8_CALL_LIST(OP) \
+    OP(00E0) OP(CXNN) OP(DXYN) OP(FX07) OP(FX0A) OP(FX15) OP(FX18) OP(FX33) OP(FX55) OP(unknown)
+
+// GOTO 引擎：从内存取指，经 64K 操作码编号表分派，操作数从操作码中提取
+CHIP8_THREADED static dword chip8_run_goto(CHIP8 *chip8, dword cycles)
+{
+#define CHIP8_OP_LABEL_ADDR(N) &&op_##N,
+    static void *const labels[CHIP8_OP_COUNT] = {
+        CHIP8_OPCODE_LIST(CHIP8_OP_LABEL_ADDR)
+    };
+#undef CHIP8_OP_LABEL_ADDR
+
+    byte *V = chip8->registers;
+    qword base = chip8->cycles;
+    word pc = chip8->pc;
+    word opcode = chip8->opcode;
+    dword n = 0;
+#define CHIP8_DISPATCH_NEXT()                                                       \
+    do {                                                                            \
+        if (n == cycles)                                                            \
+            goto done;                                                              \
+        opcode = (word)((chip8->memory[pc & (CHIP8_MEMORY_SIZE - 1)] << 8) |        \
+                        chip8->memory[(pc + 1) & (CHIP8_MEMORY_SIZE - 1)]);         \
+        byte op = chip8_opcode_index[opcode];                                       \
+        CHIP8_PROFILE_INSN(chip8, pc, op);                                          \
+        pc += 2;                                                                    \
+        n++;                                                                        \
+        goto *labels[op];                                                           \
+    } while (0)
+
+    CHIP8_DISPATCH_NEXT();
+
+#define CHIP8_INLINE_LABEL(N) \
+    op_##N: { CHIP8_INLINE_##N(X(opcode), Y(opcode), NN(opcode), NNN(opcode)); } CHIP8_DISPATCH_NEXT();
+#define CHIP8_CALL_LABEL(N) op_##N: CHIP8_CALL(N); CHIP8_DISPATCH_NEXT();
+    CHIP8_INLINE_LIST(CHIP8_INLINE_LABEL)
+    CHIP8_CALL_LIST(CHIP8_CALL_LABEL)
+#undef CHIP8_CALL_LABEL
+#undef CHIP8_INLINE_LABEL
+#undef CHIP8_DISPATCH_NEXT
+
+done:
+    chip8->pc = pc;
+    chip8->opcode = opcode;
+    chip8->cycles = base + n;
+    return n;
+}
+/// ****************************************************************************** ///
+
+
+/// ********************************译码缓存************************************ ///
+// 分派编号
+#define CHIP8_ICACHE_OP(op) ((byte)((op) + 1))
+#define CHIP8_ICACHE_FUSION(fusion) ((byte)(CHIP8_OP_COUNT + (fusion)))
+
+// 读取 pc 处指令的操作码编号
+static inline enum chip8_op chip8_op_at(const CHIP8 *chip8, dword pc)
+{
+    return (enum chip8_op)chip8_opcode_index[(chip8->memory[pc] << 8) | chip8->memory[pc + 1]];
+}
+
+// 判断 pc 处已译码的指令能否与其后的指令融合，能则把缓存项改为超级指令
+static void chip8_icache_fuse(CHIP8 *chip8, CHIP8_INSN *insn, word pc)
+{
+    // 后续指令必须完整地位于内存之内
+    if ((dword)pc + 4 > CHIP8_MEMORY_SIZE)
+        return;
+    enum chip8_op first = (enum chip8_op)chip8_opcode_index[insn->opcode];
+    enum chip8_op second = chip8_op_at(chip8, pc + 2);
+    enum chip8_fusion fusion = CHIP8_FUSION_NONE;
+    byte fused = 1;
+    if (first == CHIP8_OP_6XNN && second == CHIP8_OP_6XNN)
+    {
+        fusion = CHIP8_FUSION_6XNN_RUN;
+        while (fused < CHIP8_FUSE_MAX - 1 && (dword)pc + 2 * (fused + 2) <= CHIP8_MEMORY_SIZE &&
+               chip8_op_at(chip8, pc + 2 * (fused + 1)) == CHIP8_OP_6XNN)
+            fused++;
+    }
+    else if (first == CHIP8_OP_ANNN)
+    {
+        if (second == CHIP8_OP_DXYN)
+            fusion = CHIP8_FUSION_ANNN_DXYN;
+        else if (second == CHIP8_OP_FX65)
+            fusion = CHIP8_FUSION_ANNN_FX65;
+        else if (second == CHIP8_OP_FX1E)
+            fusion = CHIP8_FUSION_ANNN_FX1E;
+    }
+    else if (first == CHIP8_OP_7XNN)
+    {
+        if (second == CHIP8_OP_3XNN)
+            fusion = CHIP8_FUSION_7XNN_3XNN;
+        else if (second == CHIP8_OP_4XNN)
+            fusion = CHIP8_FUSION_7XNN_4XNN;
+    }
+    if (fusion == CHIP8_FUSION_NONE)
+        return;
+    insn->fused = fused;
+    insn->op = CHIP8_ICACHE_FUSION(fusion);
+}
+
+// 译码操作码并填入缓存项（不融合）
+static void chip8_icache_decode(CHIP8_INSN *insn, word opcode)
+{
+    insn->opcode = opcode;
+    insn->nnn = NNN(opcode);
+    insn->x = X(opcode);
+    insn->y = Y(opcode);
+    insn->op = CHIP8_ICACHE_OP(chip8_opcode_index[opcode]);
+    insn->fused = 0;
+}
+
+// 译码 pc 处的指令并填入缓存项
+static void chip8_icache_fill(CHIP8 *chip8, CHIP8_INSN *insn, word pc)
+{
+    chip8_icache_decode(insn, (word)((chip8->memory[pc] << 8) | chip8->memory[pc + 1]));
+    if (chip8->fuse)
+        chip8_icache_fuse(chip8, insn, pc);
+}
+
+// CACHE 引擎：命中时直接按缓存的分派编号跳转，使用缓存的操作数，不再访问内存和分派表。
+// 奇数地址或越过内存末尾的指令不缓存，临时译码后同样执行。
+// 超级指令先执行首条指令，再依次从内存取出后续指令执行；首条指令的缓存项有效说明后续指令
+// 没有被改写过。参与融合的指令都不写内存、不改变 pc（比较跳过只在最后一条），
+// 所以与逐条执行完全相同。剩余预算不够时只执行首条
+CHIP8_THREADED static dword chip8_run_cache(CHIP8 *chip8, dword cycles)
+{
+#define CHIP8_OP_LABEL_ADDR(N) &&op_##N,
+#define CHIP8_FUSION_LABEL_ADDR(N) &&fused_##N,
+    static void *const labels[1 + CHIP8_OP_COUNT + CHIP8_FUSION_COUNT - 1] = {
+        NULL,
+        CHIP8_OPCODE_LIST(CHIP8_OP_LABEL_ADDR)
+        CHIP8_FUSION_LIST(CHIP8_FUSION_LABEL_ADDR)
+    };
+#undef CHIP8_FUSION_LABEL_ADDR
+#undef CHIP8_OP_LABEL_ADDR
+
+    CHIP8_INSN *icache = chip8->icache;
+    CHIP8_INSN uncached;
+    const CHIP8_INSN *insn;
+    byte *V = chip8->registers;
+    qword base = chip8->cycles;
+    word pc = chip8->pc;
+    word opcode = chip8->opcode;
+    dword fused = 0;
+    dword n = 0;
+#define CHIP8_DISPATCH_NEXT()                                                       \
+    do {                                                                            \
+        if (n == cycles)                                                            \
+            goto done;                                                              \
+        if (pc & (word)~(CHIP8_MEMORY_SIZE - 2))                                    \
+            goto decode;                                                            \
+        CHIP8_INSN *entry = &icache[pc >> 1];                                       \
+        if (entry->op == 0)                                                         \
+            chip8_icache_fill(chip8, entry, pc);                                    \
+        insn = entry;                                                               \
+        opcode = insn->opcode;                                                      \
+        CHIP8_PROFILE_INSN(chip8, pc, chip8_opcode_index[opcode]);                  \
+        if (insn->op <= CHIP8_OP_COUNT)                                             \
+            CHIP8_PROFILE_FUSION(chip8, CHIP8_FUSION_NONE);                         \
+        pc += 2;                                                                    \
+        n++;                                                                        \
+        goto *labels[insn->op];                                                     \
+    } while (0)
+
+    CHIP8_DISPATCH_NEXT();
+
+decode:
+    opcode = (word)((chip8->memory[pc & (CHIP8_MEMORY_SIZE - 1)] << 8) |
+                    chip8->memory[(pc + 1) & (CHIP8_MEMORY_SIZE - 1)]);
+    chip8_icache_decode(&uncached, opcode);
+    insn = &uncached;
+    CHIP8_PROFILE_INSN(chip8, pc, chip8_opcode_index[opcode]);
+    CHIP8_PROFILE_FUSION(chip8, CHIP8_FUSION_NONE);
+    pc += 2;
+    n++;
+    goto *labels[insn->op];
+
+#define CHIP8_INLINE_LABEL(N) \
+    op_##N: { CHIP8_INLINE_##N(insn->x, insn->y, (byte)insn->nnn, insn->nnn); } CHIP8_DISPATCH_NEXT();
+#define CHIP8_CALL_LABEL(N) op_##N: CHIP8_CALL(N); CHIP8_DISPATCH_NEXT();
+    CHIP8_INLINE_LIST(CHIP8_INLINE_LABEL)
+    CHIP8_CALL_LIST(CHIP8_CALL_LABEL)
+#undef CHIP8_CALL_LABEL
+#undef CHIP8_INLINE_LABEL
+
+    // 超级指令中的下一条指令：取指并计入 n
+#define CHIP8_FUSED_FETCH(N)                                                        \
+    do {                                                                            \
+        opcode = (word)((chip8->memory[pc] << 8) | chip8->memory[pc + 1]);          \
+        CHIP8_PROFILE_INSN(chip8, pc, CHIP8_OP_##N);                                \
+        pc += 2;                                                                    \
+        n++;                                                                        \
+        fused++;                                                                    \
+    } while (0)
+    // 超级指令的开头：预算不够时只执行首条 FIRST
+#define CHIP8_FUSED_BEGIN(FIRST, KIND)                                              \
+    if (n + insn->fused > cycles)                                                   \
+    {                                                                               \
+        CHIP8_PROFILE_FUSION(chip8, CHIP8_FUSION_NONE);                             \
+        goto op_##FIRST;                                                            \
+    }                                                                               \
+    CHIP8_PROFILE_FUSION(chip8, CHIP8_FUSION_##KIND)
+#define CHIP8_FUSED_PAIR(A, B)                                                      \
+    fused_##A##_##B:                                                                \
+    {                                                                               \
+        CHIP8_FUSED_BEGIN(A, A##_##B);                                              \
+        CHIP8_INLINE_##A(insn->x, insn->y, (byte)insn->nnn, insn->nnn);             \
+        CHIP8_FUSED_FETCH(B);                                                       \
+        CHIP8_INLINE_##B(X(opcode), Y(opcode), NN(opcode), NNN(opcode));            \
+    }                                                                               \
+    CHIP8_DISPATCH_NEXT();
+
+fused_6XNN_RUN:
+{
+    CHIP8_FUSED_BEGIN(6XNN, 6XNN_RUN);
+    V[insn->x] = (byte)insn->nnn;
+    for (byte i = 0; i < insn->fused; i++)
+    {
+        CHIP8_FUSED_FETCH(6XNN);
+        V[X(opcode)] = NN(opcode);
+    }
+    CHIP8_DISPATCH_NEXT();
+}
+fused_ANNN_DXYN:
+    CHIP8_FUSED_BEGIN(ANNN, ANNN_DXYN);
+    chip8->index_register = insn->nnn;
+    CHIP8_FUSED_FETCH(DXYN);
+    CHIP8_CALL(DXYN);
+    CHIP8_DISPATCH_NEXT();
+CHIP8_FUSED_PAIR(ANNN, FX65)
+CHIP8_FUSED_PAIR(ANNN, FX1E)
+CHIP8_FUSED_PAIR(7XNN, 3XNN)
+CHIP8_FUSED_PAIR(7XNN, 4XNN)
+#undef CHIP8_FUSED_PAIR
+#undef CHIP8_FUSED_BEGIN
+#undef CHIP8_FUSED_FETCH
+#undef CHIP8_DISPATCH_NEXT
+
+done:
+    chip8->pc = pc;
+    chip8->opcode = opcode;
+    chip8->cycles = base + n;
+    chip8->fused_cycles += fused;
+    return n;
+}
+/// ****************************************************************************** ///
+#endif
+
+/// ********************************空转检测************************************ ///
+// 很多 ROM 在紧凑的循环里忙等：1NNN 跳到自身、FX07 轮询延迟定时器、EX9E/EXA1 轮询按键、
+// FX0A 等待按键时反复回退 pc。一次 chip8_emulate_cycles 内按键不会变化，延迟定时器只在
+// 帧边界变化，因此这类循环一旦进入不动点，之后每一轮的结果都完全相同，可以直接跳过。
+//
+// 检测方法：从 pc 开始在 pc、V0-VF 和 I 的副本上推演一轮（直到 pc 回到起点），再推演一轮；
+// 两轮之后状态相同即为不动点。检测本身不执行任何指令，只有确认是不动点时才把第一轮之后的
+// 状态写回实例，并把推演和跳过的整轮一起累加到 cycles；不足一轮的部分交给引擎正常执行，
+// 结果与逐条执行逐位一致。检测不到不动点时实例状态不变，整段预算都由所选引擎执行。
+// 循环中只允许出现除 pc、V0-VF、I 外不改变任何状态的指令，其余指令立即结束检测。
+// 循环读取延迟定时器（FX07）且定时器未归零时，只跳到下一个帧边界；
+// 否则定时器不影响循环，一次跳过整个预算。
+#define CHIP8_IDLE_MAX_PERIOD 4
+
+static const byte chip8_idle_safe[CHIP8_OP_COUNT] = {
+    [CHIP8_OP_1NNN] = 1, [CHIP8_OP_3XNN] = 1, [CHIP8_OP_4XNN] = 1, [CHIP8_OP_5XY0] = 1,
+    [CHIP8_OP_6XNN] = 1, [CHIP8_OP_7XNN] = 1, [CHIP8_OP_8XY0] = 1, [CHIP8_OP_8XY1] = 1,
+    [CHIP8_OP_8XY2] = 1, [CHIP8_OP_8XY3] = 1, [CHIP8_OP_8XY4] = 1, [CHIP8_OP_8XY5] = 1,
+    [CHIP8_OP_8XY6] = 1, [CHIP8_OP_8XY7] = 1, [CHIP8_OP_8XYE] = 1, [CHIP8_OP_9XY0] = 1,
+    [CHIP8_OP_ANNN] = 1, [CHIP8_OP_BNNN] = 1, [CHIP8_OP_EX9E] = 1, [CHIP8_OP_EXA1] = 1,
+    [CHIP8_OP_FX07] = 1, [CHIP8_OP_FX0A] = 1,
+};
+
+// 检测时推演用的状态副本
+struct chip8_idle_state
+{
+    word pc;
+    word index;
+    byte v[16];
+};
+
+// 在副本上推演循环的一轮，语义与 opcode.c 中对应的处理函数逐条相同（包括 X 或 Y 为 F 时
+// 写 VF 之后重新读取寄存器的顺序），delay 为这一轮看到的延迟定时器值。
+// 返回本轮的指令数；遇到不允许的指令或超过最大长度时返回 0。本轮读取了定时器时置 *reads_timer
+static dword chip8_idle_iteration(const CHIP8 *chip8, struct chip8_idle_state *state, byte delay, byte *reads_timer)
+{
+    word start = state->pc;
+    byte *v = state->v;
+    dword len = 0;
+    do {
+        word pc = state->pc;
+        if (len == CHIP8_IDLE_MAX_PERIOD || pc >= CHIP8_MEMORY_SIZE - 1)
+            return 0;
+        word opcode = (word)((chip8->memory[pc] << 8) | chip8->memory[pc + 1]);
+        byte op = chip8_opcode_index[opcode];
+        if (!chip8_idle_safe[op])
+            return 0;
+        byte x = X(opcode), y = Y(opcode);
+        state->pc = pc + 2;
+        switch (op) {
+            case CHIP8_OP_1NNN: state->pc = NNN(opcode); break;
+            case CHIP8_OP_3XNN: if (v[x] == NN(opcode)) state->pc += 2; break;
+            case CHIP8_OP_4XNN: if (v[x] != NN(opcode)) state->pc += 2; break;
+            case CHIP8_OP_5XY0: if (v[x] == v[y]) state->pc += 2; break;
+            case CHIP8_OP_6XNN: v[x] = NN(opcode); break;
+            case CHIP8_OP_7XNN: v[x] += NN(opcode); break;
+            case CHIP8_OP_8XY0: v[x] = v[y]; break;
+            case CHIP8_OP_8XY1: v[x] |= v[y]; break;
+            case CHIP8_OP_8XY2: v[x] &= v[y]; break;
+            case CHIP8_OP_8XY3: v[x] ^= v[y]; break;
+            case CHIP8_OP_8XY4: {
+                word add = (word)v[x] + (word)v[y];
+                v[x] = add & 0xFF;
+                v[0xF] = (add & 0x0100) >> 8;
+                break;
+            }
+            case CHIP8_OP_8XY5: v[0xF] = v[x] > v[y]; v[x] -= v[y]; break;
+            case CHIP8_OP_8XY6: v[0xF] = v[x] & 0x01; v[x] = v[x] >> 1; break;
+            case CHIP8_OP_8XY7: v[0xF] = v[x] < v[y]; v[x] = v[y] - v[x]; break;
+            case CHIP8_OP_8XYE: v[0xF] = (v[x] & 0x80) >> 7; v[x] = v[x] << 1; break;
+            case CHIP8_OP_9XY0: if (v[x] != v[y]) state->pc += 2; break;
+            case CHIP8_OP_ANNN: state->index = NNN(opcode); break;
+            case CHIP8_OP_BNNN: state->pc = NNN(opcode) + v[0]; break;
+            case CHIP8_OP_EX9E: if (v[x] < 16 && chip8->keys[v[x]]) state->pc += 2; break;
+            case CHIP8_OP_EXA1: if (v[x] < 16 && !chip8->keys[v[x]]) state->pc += 2; break;
+            case CHIP8_OP_FX07: v[x] = delay; *reads_timer = 1; break;
+            case CHIP8_OP_FX0A: {
+                byte key_pressed = 0;
+                for (byte i = 0; i < CHIP8_KEY_SIZE - 1; i++)
+                {
+                    if (chip8->keys[i])
+                    {
+                        v[x] = i;
+                        key_pressed = 1;
+                    }
+                }
+                if (!key_pressed)
+                    state->pc -= 2;
+                break;
+            }
+            default:
+                return 0;
+        }
+        len++;
+    } while (state->pc != start);
+    return len;
+}
+
+/**
+ * chip8_idle_skip 检测 pc 处的空转循环，是不动点时跳过其中整轮的部分。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param cycles 本次的指令预算
+ * @return 跳过的指令数，没有检测到不动点时返回 0 且不改变实例状态
+ */
+static dword chip8_idle_skip(CHIP8 *chip8, dword cycles)
+{
+    struct chip8_idle_state state = { chip8->pc, chip8->index_register, { 0 } };
+    memcpy(state.v, chip8->registers, sizeof(state.v));
+    // 推演的指令和跳过的整轮都在当前帧内时才能用同一个定时器值
+    byte delay = chip8_delay_timer(chip8);
+    byte reads_timer = 0;
+    dword first = chip8_idle_iteration(chip8, &state, delay, &reads_timer);
+    if (first == 0)
+        return 0;
+    struct chip8_idle_state fixed = state;
+    dword len = chip8_idle_iteration(chip8, &state, delay, &reads_timer);
+    if (len == 0 || state.index != fixed.index || memcmp(state.v, fixed.v, sizeof(state.v)) != 0)
+        return 0;
+
+    dword limit = cycles;
+    // 定时器还在走，下一帧 FX07 会读到新值
+    if (reads_timer && delay != 0)
+    {
+        dword to_frame = (dword)(CHIP8_CYCLES_PER_FRAME - chip8->cycles % CHIP8_CYCLES_PER_FRAME);
+        if (limit > to_frame)
+            limit = to_frame;
+    }
+    // 第一轮之后每一轮都回到 fixed，至少跳过第一轮和一整轮不动点才值得写回
+    if (limit < first + len)
+        return 0;
+    dword skip = first + (limit - first) / len * len;
+    chip8->pc = fixed.pc;
+    chip8->index_register = fixed.index;
+    memcpy(chip8->registers, fixed.v, sizeof(fixed.v));
+    chip8->cycles += skip;
+    chip8->skipped_cycles += skip;
+    // 单条 FX0A 构成的循环即等待按键
+    CHIP8_PROFILE_KEY_WAIT(chip8, chip8_opcode_index[(chip8->memory[fixed.pc] << 8) | chip8->memory[fixed.pc + 1]] == CHIP8_OP_FX0A ? skip : 0);
+    return skip;
+}
+/// ****************************************************************************** ///
+
+// SWITCH 引擎：逐条调用参考实现
+static dword chip8_run_switch(CHIP8 *chip8, dword cycles)
+{
+    dword n = 0;
+    while (n < cycles && chip8->error == CHIP8_OK)
+    {
+        chip8_emulate_cycle(chip8);
+        n++;
+    }
+    return n;
+}
+
+// 用 chip8->engine 选择的引擎执行
+static dword chip8_run_engine(CHIP8 *chip8, dword cycles)
+{
+    switch (chip8->engine) {
+        // 剖析构建中 JIT 和预编译代码无法逐条计数，按 CACHE 执行
+#if !CHIP8_ENABLE_PROFILE
+        case CHIP8_ENGINE_AOT:
+            if (chip8->aot != NULL)
+                return chip8_aot_run(chip8, cycles);
+            // 没有与 ROM 匹配的预编译程序，按 CACHE 执行
+            break;
+#endif
+#if CHIP8_HAVE_JIT && !CHIP8_ENABLE_PROFILE
+        case CHIP8_ENGINE_JIT:
+            return chip8_jit_run(chip8, cycles);
+#endif
+        case CHIP8_ENGINE_TABLE:
+            return chip8_run_table(chip8, cycles);
+#if CHIP8_HAVE_COMPUTED_GOTO
+        case CHIP8_ENGINE_GOTO:
+            return chip8_run_goto(chip8, cycles);
+#endif
+        case CHIP8_ENGINE_SWITCH:
+            return chip8_run_switch(chip8, cycles);
+        default:
+            break;
+    }
+    // CACHE：没有译码缓存时按 GOTO 执行，没有 computed goto 时按 SWITCH 执行
+#if CHIP8_HAVE_COMPUTED_GOTO
+    if (chip8->icache != NULL)
+        return chip8_run_cache(chip8, cycles);
+    return chip8_run_goto(chip8, cycles);
+#else
+    return chip8_run_switch(chip8, cycles);
+#endif
+}
+
+/**
+ * chip8_emulate_cycles 使用 chip8->engine 选择的分派引擎连续执行多条指令。
+ *
+ * 批量执行可以把引擎选择和循环开销摊到整个指令序列上，这是主循环和批处理
+ * 应该使用的入口；chip8_emulate_cycle 仍然是单步的参考实现。
+ *
+ * 整段预算一次交给引擎。定时器按 cycles 换算帧号，各引擎在调用 opcode.c 中的处理函数之前
+ * 把 cycles 写回为已执行的指令数，所以 FX07/FX15/FX18 在段内任何位置看到的帧号都与逐条执行相同。
+ * chip8->idle_skip 打开时只在进入时检测空转循环，跳过的指令同样计入 cycles；
+ * 读取定时器的循环只能跳到帧边界，这时继续检测，直到检测不到空转再把剩余部分交给引擎。
+ * 检测只推演状态副本，不执行指令，所以没有跳过的指令全部由所选引擎执行。
+ * 发生故障（chip8->error）时引擎执行完故障指令即返回，之后只会反复执行故障指令而不改变任何状态，
+ * 所以直接把所在帧段的剩余部分计入 cycles；之后的调用不再执行任何指令。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param cycles 要执行的指令数
+ * @return 实际执行的指令数，发生故障时小于 cycles
+ */
+dword chip8_emulate_cycles(CHIP8 *chip8, dword cycles)
+{
+    pthread_once(&chip8_dispatch_once, chip8_dispatch_build);
+
+    if (chip8->error != CHIP8_OK)
+        return 0;
+    dword done = 0;
+    if (chip8->idle_skip)
+    {
+        dword skipped;
+        while (done < cycles && (skipped = chip8_idle_skip(chip8, cycles - done)) != 0)
+            done += skipped;
+    }
+    if (done < cycles)
+        done += chip8_run_engine(chip8, cycles - done);
+    if (chip8->error != CHIP8_OK)
+    {
+        // 故障指令之后到帧边界为止的部分
+        dword rest = (dword)((CHIP8_CYCLES_PER_FRAME - chip8->cycles % CHIP8_CYCLES_PER_FRAME) % CHIP8_CYCLES_PER_FRAME);
+        if (rest > cycles - done)
+            rest = cycles - done;
+        chip8->cycles += rest;
+        done += rest;
+    }
+    return done;
+}
@@ -0,0 +1,346 @@
+#include "fork.h"
+
+/// *******************************固定大小分块分配******************************* ///
+// 每次向系统申请一大块，切成等大的对象依次分配；释放的对象进入空闲链表，
+// 对象开头的位置存放下一个空闲对象。块只在销毁时归还。
+#define CHIP8_SLAB_CHUNK_SIZE (64 * 1024)
+// 块开头存放上一个块的指针，对象从这里开始
+#define CHIP8_SLAB_HEADER 16
+
+struct chip8_slab
+{
+    size_t size;                     // 对象大小，按指针大小对齐
+    void *free;                      // 空闲链表
+    byte *next;                      // 当前块中尚未切分的位置
+    byte *end;                       // 当前块的末尾
+    void *chunks;                    // 已申请的块组成的链表
+    size_t live;                     // 使用中的对象数
+};
+
+static void chip8_slab_init(struct chip8_slab *slab, size_t size)
+{
+    memset(slab, 0, sizeof(*slab));
+    slab->size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+// 分配一个对象，新申请的块的大小累加到 *bytes，内存不足返回 NULL
+static void *chip8_slab_alloc(struct chip8_slab *slab, size_t *bytes)
+{
+    void *object = slab->free;
+    if (object != NULL)
+        memcpy(&slab->free, object, sizeof(void *));
+    else
+    {
+        if (slab->next == NULL || slab->next + slab->size > slab->end)
+        {
+            byte *chunk = (byte *)malloc(CHIP8_SLAB_CHUNK_SIZE);
+            if (chunk == NULL)
+                return NULL;
+            memcpy(chunk, &slab->chunks, sizeof(void *));
+            slab->chunks = chunk;
+            slab->next = chunk + CHIP8_SLAB_HEADER;
+            slab->end = chunk + CHIP8_SLAB_CHUNK_SIZE;
+            *bytes += CHIP8_SLAB_CHUNK_SIZE;
+        }
+        object = slab->next;
+        slab->next += slab->size;
+    }
+    slab->live++;
+    return object;
+}
+
+static void chip8_slab_free(struct chip8_slab *slab, void *object)
+{
+    memcpy(object, &slab->free, sizeof(void *));
+    slab->free = object;
+    slab->live--;
+}
+
+static void chip8_slab_destroy(struct chip8_slab *slab)
+{
+    void *chunk = slab->chunks;
+    while (chunk != NULL)
+    {
+        void *prev;
+        memcpy(&prev, chunk, sizeof(void *));
+        free(chunk);
+        chunk = prev;
+    }
+    memset(slab, 0, sizeof(*slab));
+}
+/// ****************************************************************************** ///
+
+
+/// *******************************写时复制分支*********************************** ///
+struct chip8_fork_pool
+{
+    struct chip8_slab nodes;
+    struct chip8_slab tables;
+    struct chip8_slab pages;
+    struct chip8_slab displays;
+    size_t bytes;                    // 所有块的字节数
+
+    // 工作实例最近一次装入或保存的节点状态，池各持有一个引用
+    const CHIP8 *instance;
+    CHIP8_FORK_MEMORY *memory;
+    CHIP8_FORK_DISPLAY *display;
+};
+
+/**
+ * chip8_fork_pool_create 创建一个空的分支池。
+ *
+ * @return 池，内存不足时返回 NULL
+ */
+CHIP8_FORK_POOL *chip8_fork_pool_create(void)
+{
+    CHIP8_FORK_POOL *pool = (CHIP8_FORK_POOL *)calloc(1, sizeof(CHIP8_FORK_POOL));
+    if (pool == NULL)
+        return NULL;
+    chip8_slab_init(&pool->nodes, sizeof(CHIP8_FORK));
+    chip8_slab_init(&pool->tables, sizeof(CHIP8_FORK_MEMORY));
+    chip8_slab_init(&pool->pages, sizeof(CHIP8_FORK_PAGE));
+    chip8_slab_init(&pool->displays, sizeof(CHIP8_FORK_DISPLAY));
+    return pool;
+}
+
+/**
+ * chip8_fork_pool_free 销毁池，池中分配的所有节点一起失效。
+ *
+ * @param pool 池，可以为 NULL
+ */
+void chip8_fork_pool_free(CHIP8_FORK_POOL *pool)
+{
+    if (pool == NULL)
+        return;
+    chip8_slab_destroy(&pool->nodes);
+    chip8_slab_destroy(&pool->tables);
+    chip8_slab_destroy(&pool->pages);
+    chip8_slab_destroy(&pool->displays);
+    free(pool);
+}
+
+size_t chip8_fork_pool_bytes(const CHIP8_FORK_POOL *pool)
+{
+    return pool->bytes;
+}
+
+size_t chip8_fork_pool_pages(const CHIP8_FORK_POOL *pool)
+{
+    return pool->pages.live;
+}
+
+static void chip8_fork_unref_page(CHIP8_FORK_POOL *pool, CHIP8_FORK_PAGE *page)
+{
+    if (--page->refs == 0)
+        chip8_slab_free(&pool->pages, page);
+}
+
+// 页表的最后一个引用释放时一并释放它引用的页，pages 中的 NULL 项跳过
+static void chip8_fork_unref_memory(CHIP8_FORK_POOL *pool, CHIP8_FORK_MEMORY *memory)
+{
+    if (memory == NULL || --memory->refs != 0)
+        return;
+    for (int k = 0; k < CHIP8_MEMORY_PAGES; k++)
+        if (memory->pages[k] != NULL)
+            chip8_fork_unref_page(pool, memory->pages[k]);
+    chip8_slab_free(&pool->tables, memory);
+}
+
+static void chip8_fork_unref_display(CHIP8_FORK_POOL *pool, CHIP8_FORK_DISPLAY *display)
+{
+    if (display != NULL && --display->refs == 0)
+        chip8_slab_free(&pool->displays, display);
+}
+
+// 记下工作实例现在与哪个页表和显示缓冲区的内容相同，之后写过的页重新开始记录
+static void chip8_fork_track(CHIP8_FORK_POOL *pool, CHIP8 *chip8, CHIP8_FORK_MEMORY *memory,
+                             CHIP8_FORK_DISPLAY *display)
+{
+    // 先增加新的引用，新旧可能是同一个块
+    memory->refs++;
+    display->refs++;
+    chip8_fork_unref_memory(pool, pool->memory);
+    chip8_fork_unref_display(pool, pool->display);
+    pool->instance = chip8;
+    pool->memory = memory;
+    pool->display = display;
+    chip8->memory_dirty = 0;
+}
+
+// 以 base 为基础生成工作实例当前内存的页表：dirty 中的页复制，其余页共享
+static CHIP8_FORK_MEMORY *chip8_fork_share_memory(CHIP8_FORK_POOL *pool, const CHIP8 *chip8,
+                                                  const CHIP8_FORK_MEMORY *base, dword dirty)
+{
+    CHIP8_FORK_MEMORY *memory = (CHIP8_FORK_MEMORY *)chip8_slab_alloc(&pool->tables, &pool->bytes);
+    if (memory == NULL)
+        return NULL;
+    memory->refs = 1;
+    memset(memory->pages, 0, sizeof(memory->pages));
+    for (int k = 0; k < CHIP8_MEMORY_PAGES; k++)
+    {
+        if (!(dirty >> k & 1))
+        {
+            memory->pages[k] = base->pages[k];
+            memory->pages[k]->refs++;
+            continue;
+        }
+        CHIP8_FORK_PAGE *page = (CHIP8_FORK_PAGE *)chip8_slab_alloc(&pool->pages, &pool->bytes);
+        if (page == NULL)
+        {
+            chip8_fork_unref_memory(pool, memory);
+            return NULL;
+        }
+        page->refs = 1;
+        memcpy(page->data, chip8->memory + k * CHIP8_MEMORY_PAGE_SIZE, CHIP8_MEMORY_PAGE_SIZE);
+        memory->pages[k] = page;
+    }
+    return memory;
+}
+
+/**
+ * chip8_fork_capture 把工作实例的当前状态保存为一个新节点。
+ *
+ * 工作实例上一次由这个池装入或保存之后只写过部分内存页时，只复制这些页，
+ * 其余页和页表与之前的节点共享；显示缓冲区没有变化时也共享。
+ * 保存之后工作实例与新节点的内容相同，可以继续执行再保存下一个节点。
+ *
+ * @param pool 池
+ * @param chip8 工作实例
+ * @return 新节点，内存不足返回 NULL（工作实例不受影响）
+ */
+CHIP8_FORK *chip8_fork_capture(CHIP8_FORK_POOL *pool, CHIP8 *chip8)
+{
+    CHIP8_FORK *node = (CHIP8_FORK *)chip8_slab_alloc(&pool->nodes, &pool->bytes);
+    if (node == NULL)
+        return NULL;
+    byte tracked = pool->instance == chip8;
+
+    CHIP8_FORK_MEMORY *memory = tracked ? pool->memory : NULL;
+    if (memory != NULL && chip8->memory_dirty == 0)
+        memory->refs++;
+    else
+    {
+        memory = chip8_fork_share_memory(pool, chip8, memory, memory != NULL ? chip8->memory_dirty : 0xFFFFFFFFu);
+        if (memory == NULL)
+        {
+            chip8_slab_free(&pool->nodes, node);
+            return NULL;
+        }
+    }
+
+    CHIP8_FORK_DISPLAY *display = tracked ? pool->display : NULL;
+    if (display != NULL && memcmp(display->rows, chip8->display, sizeof(display->rows)) == 0)
+        display->refs++;
+    else
+    {
+        display = (CHIP8_FORK_DISPLAY *)chip8_slab_alloc(&pool->displays, &pool->bytes);
+        if (display == NULL)
+        {
+            chip8_fork_unref_memory(pool, memory);
+            chip8_slab_free(&pool->nodes, node);
+            return NULL;
+        }
+        display->refs = 1;
+        memcpy(display->rows, chip8->display, sizeof(display->rows));
+    }
+
+    node->memory = memory;
+    node->display = display;
+    memcpy(node->registers, chip8->registers, sizeof(node->registers));
+    node->index_register = chip8->index_register;
+    node->pc = chip8->pc;
+    node->opcode = chip8->opcode;
+    memcpy(node->stack, chip8->stack, sizeof(node->stack));
+    node->sp = chip8->sp;
+    node->delay_deadline = chip8->delay_deadline;
+    node->sound_deadline = chip8->sound_deadline;
+    memcpy(node->keys, chip8->keys, sizeof(node->keys));
+    node->quirks = chip8->quirks;
+    node->cycles = chip8->cycles;
+    node->rng = chip8->rng;
+    node->error = chip8->error;
+    chip8_fork_track(pool, chip8, memory, display);
+    return node;
+}
+
+/**
+ * chip8_fork 复制一个节点，只增加页表和显示缓冲区的引用计数。
+ *
+ * @param pool 节点所在的池
+ * @param node 要复制的节点
+ * @return 新节点，内存不足返回 NULL
+ */
+CHIP8_FORK *chip8_fork(CHIP8_FORK_POOL *pool, const CHIP8_FORK *node)
+{
+    CHIP8_FORK *copy = (CHIP8_FORK *)chip8_slab_alloc(&pool->nodes, &pool->bytes);
+    if (copy == NULL)
+        return NULL;
+    *copy = *node;
+    copy->memory->refs++;
+    copy->display->refs++;
+    return copy;
+}
+
+/**
+ * chip8_fork_restore 把节点装入工作实例。
+ *
+ * 工作实例上一次由这个池装入或保存过时，只复制与它当前内容不同的页
+ * （页表项不同或之后写过），这些页的译码缓存和 JIT 代码失效；
+ * 显示缓冲区逐行比较，只有变化的行被复制并标记为脏。
+ * 实例的引擎、空转检测等设置不变，执行故障恢复为节点中的状态。
+ *
+ * @param pool 节点所在的池
+ * @param node 要装入的节点
+ * @param chip8 工作实例
+ */
+void chip8_fork_restore(CHIP8_FORK_POOL *pool, const CHIP8_FORK *node, CHIP8 *chip8)
+{
+    const CHIP8_FORK_MEMORY *loaded = pool->instance == chip8 ? pool->memory : NULL;
+    dword stale = chip8->memory_dirty;
+    for (int k = 0; k < CHIP8_MEMORY_PAGES; k++)
+    {
+        if (loaded != NULL && !(stale >> k & 1) && loaded->pages[k] == node->memory->pages[k])
+            continue;
+        memcpy(chip8->memory + k * CHIP8_MEMORY_PAGE_SIZE, node->memory->pages[k]->data, CHIP8_MEMORY_PAGE_SIZE);
+        chip8_invalidate_code(chip8, (word)(k * CHIP8_MEMORY_PAGE_SIZE), CHIP8_MEMORY_PAGE_SIZE);
+    }
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++)
+    {
+        if (chip8->display[y] != node->display->rows[y])
+        {
+            chip8->display[y] = node->display->rows[y];
+            chip8->display_dirty_rows |= 1u << y;
+        }
+    }
+
+    memcpy(chip8->registers, node->registers, sizeof(chip8->registers));
+    chip8->index_register = node->index_register;
+    chip8->pc = node->pc;
+    chip8->opcode = node->opcode;
+    memcpy(chip8->stack, node->stack, sizeof(chip8->stack));
+    chip8->sp = node->sp;
+    chip8->delay_deadline = node->delay_deadline;
+    chip8->sound_deadline = node->sound_deadline;
+    memcpy(chip8->keys, node->keys, sizeof(chip8->keys));
+    chip8->quirks = node->quirks;
+    chip8->cycles = node->cycles;
+    chip8->rng = node->rng;
+    chip8->error = node->error;
+    chip8_fork_track(pool, chip8, node->memory, node->display);
+}
+
+/**
+ * chip8_fork_release 释放节点，最后一个引用释放时页表、页和显示缓冲区回到池的空闲链表。
+ *
+ * @param pool 节点所在的池
+ * @param node 节点，可以为 NULL
+ */
+void chip8_fork_release(CHIP8_FORK_POOL *pool, CHIP8_FORK *node)
+{
+    if (node == NULL)
+        return;
+    chip8_fork_unref_memory(pool, node->memory);
+    chip8_fork_unref_display(pool, node->display);
+    chip8_slab_free(&pool->nodes, node);
+}
+/// ****************************************************************************** ///
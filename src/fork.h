@@ -0,0 +1,74 @@
+#ifndef __FORK_H__
+#define __FORK_H__
+#include "chip8.h"
+
+/// *******************************写时复制分支*********************************** ///
+// 树搜索等需要大量同源状态副本的场景：分支节点保存一个实例的机器状态，
+// 内存按 CHIP8_MEMORY_PAGE_SIZE 分页，页、页表和显示缓冲区都带引用计数，
+// 在节点之间共享，只有真正不同的部分才各自保存一份。
+//
+// 节点不能直接执行：用 chip8_fork_restore 把节点装入一个普通的工作实例
+// （任意引擎都可以），执行后用 chip8_fork_capture 保存为新的节点。
+// 工作实例的写内存都经过 chip8_invalidate_code，被写的页记在 memory_dirty 中；
+// 池记着工作实例最近一次装入或保存的节点，capture 只复制这之后写过的页，
+// 显示缓冲区没有变化（例如没有绘制）时与之前的节点共享；restore 只复制
+// 与工作实例当前内容不同的页。chip8_fork 复制一个节点只增加引用计数。
+// 因此分支的开销与状态真正分叉的部分成正比，而不是整个 CHIP8 的大小。
+//
+// 节点和各个块都从池的固定大小分块（slab）中分配，释放后进入空闲链表复用，
+// 销毁池时一次释放全部内存。池和它的节点不是线程安全的，每个线程使用各自的池；
+// 一个工作实例只与一个池配合使用。
+typedef struct chip8_fork_pool CHIP8_FORK_POOL;
+
+// 一页内存
+typedef struct chip8_fork_page
+{
+    dword refs;
+    byte data[CHIP8_MEMORY_PAGE_SIZE];
+} CHIP8_FORK_PAGE;
+
+// 页表：整个 4 KB 内存
+typedef struct chip8_fork_memory
+{
+    dword refs;
+    CHIP8_FORK_PAGE *pages[CHIP8_MEMORY_PAGES];
+} CHIP8_FORK_MEMORY;
+
+// 显示缓冲区
+typedef struct chip8_fork_display
+{
+    dword refs;
+    qword rows[CHIP8_DISPLAY_HEIGHT];
+} CHIP8_FORK_DISPLAY;
+
+// 分支节点，字段只读
+typedef struct chip8_fork
+{
+    CHIP8_FORK_MEMORY *memory;
+    CHIP8_FORK_DISPLAY *display;
+    byte registers[16];
+    word index_register;
+    word pc;
+    word opcode;
+    word stack[16];
+    byte sp;
+    qword delay_deadline;
+    qword sound_deadline;
+    byte keys[CHIP8_KEY_SIZE];
+    byte quirks;
+    qword cycles;
+    qword rng;
+    enum chip8_error error;
+} CHIP8_FORK;
+
+CHIP8_FORK_POOL *chip8_fork_pool_create(void);                   // 创建池，内存不足返回 NULL
+void chip8_fork_pool_free(CHIP8_FORK_POOL *pool);                // 销毁池及其所有节点
+size_t chip8_fork_pool_bytes(const CHIP8_FORK_POOL *pool);       // 池占用的字节数（含空闲链表）
+size_t chip8_fork_pool_pages(const CHIP8_FORK_POOL *pool);       // 当前存活的内存页数
+CHIP8_FORK *chip8_fork_capture(CHIP8_FORK_POOL *pool, CHIP8 *chip8); // 保存工作实例为节点，内存不足返回 NULL
+CHIP8_FORK *chip8_fork(CHIP8_FORK_POOL *pool, const CHIP8_FORK *node); // 复制节点，内存不足返回 NULL
+void chip8_fork_restore(CHIP8_FORK_POOL *pool, const CHIP8_FORK *node, CHIP8 *chip8); // 把节点装入工作实例
+void chip8_fork_release(CHIP8_FORK_POOL *pool, CHIP8_FORK *node); // 释放节点，可以为 NULL
+/// ****************************************************************************** ///
+
+#endif
@@ -0,0 +1,102 @@
+#include "frames.h"
+
+/// ********************************三缓冲帧交换********************************** ///
+/**
+ * chip8_frames_init 初始化三缓冲：所有槽位为空白画面，写者占 0，最新为 1，读者占 2。
+ *
+ * @param frames 三缓冲
+ */
+void chip8_frames_init(CHIP8_FRAMES *frames)
+{
+    memset(frames, 0, sizeof(*frames));
+    frames->write = 0;
+    atomic_store(&frames->latest, 1);
+    frames->read = 2;
+}
+
+// 读者已经取走带有按键时刻的帧，或者等待超时，结束这次测量
+static void chip8_frames_settle_input(CHIP8_FRAMES *frames, qword now)
+{
+    if (frames->input == 0)
+        return;
+    if (frames->input_sequence != 0
+        && atomic_load_explicit(&frames->acquired_sequence, memory_order_acquire) >= frames->input_sequence)
+        frames->input = 0;
+    else if (now - frames->input > CHIP8_FRAMES_INPUT_TIMEOUT && frames->input_sequence == 0)
+    {
+        frames->input = 0;
+        frames->input_timeouts++;
+    }
+}
+
+/**
+ * chip8_frames_input 记下一个已应用的按键事件，之后发布的帧带上它的时刻。
+ *
+ * 只有写者调用。已有按键在等待响应时保留较早的那个。
+ *
+ * @param frames 三缓冲
+ * @param ts 事件发生时刻（单调时钟，纳秒）
+ */
+void chip8_frames_input(CHIP8_FRAMES *frames, qword ts)
+{
+    chip8_frames_settle_input(frames, ts);
+    if (frames->input == 0)
+    {
+        frames->input = ts;
+        frames->input_sequence = 0;
+    }
+}
+
+/**
+ * chip8_frames_publish 把当前画面写入写者的槽位并发布为最新帧。
+ *
+ * 只有写者调用。交换之后写者拿到的是旧的“最新”槽位，读者此时不持有它。
+ *
+ * @param frames 三缓冲
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param now 发布时刻（单调时钟，纳秒）
+ */
+void chip8_frames_publish(CHIP8_FRAMES *frames, const CHIP8 *chip8, qword now)
+{
+    CHIP8_FRAME *frame = &frames->slots[frames->write];
+    memcpy(frame->display, chip8->display, sizeof(frame->display));
+    frame->cycles = chip8->cycles;
+    frame->published = now;
+    frame->sequence = ++frames->sequence;
+    chip8_frames_settle_input(frames, now);
+    frame->input = frames->input;
+    if (frames->input != 0 && frames->input_sequence == 0)
+        frames->input_sequence = frame->sequence;
+    byte old = atomic_exchange_explicit(&frames->latest, frames->write | CHIP8_FRAMES_FRESH, memory_order_acq_rel);
+    frames->write = old & (CHIP8_FRAMES_FRESH - 1);
+}
+
+/**
+ * chip8_frames_acquire 取出最新发布的帧。
+ *
+ * 只有读者调用。返回的帧在下一次调用之前有效；dirty_rows 是与上一次取出的帧相比
+ * 变化的行。
+ *
+ * @param frames 三缓冲
+ * @return 最新帧，自上次调用以来没有发布新帧时返回 NULL
+ */
+const CHIP8_FRAME *chip8_frames_acquire(CHIP8_FRAMES *frames)
+{
+    if (!(atomic_load_explicit(&frames->latest, memory_order_relaxed) & CHIP8_FRAMES_FRESH))
+        return NULL;
+    byte old = atomic_exchange_explicit(&frames->latest, frames->read, memory_order_acq_rel);
+    frames->read = old & (CHIP8_FRAMES_FRESH - 1);
+
+    CHIP8_FRAME *frame = &frames->slots[frames->read];
+    frame->dirty_rows = 0;
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++)
+        if (frame->display[y] != frames->shown[y])
+            frame->dirty_rows |= 1u << y;
+    memcpy(frames->shown, frame->display, sizeof(frames->shown));
+    frames->skipped += frame->sequence - frames->last_sequence - 1;
+    frames->last_sequence = frame->sequence;
+    atomic_store_explicit(&frames->acquired_sequence, frame->sequence, memory_order_release);
+    frames->acquired++;
+    return frame;
+}
+/// ****************************************************************************** ///
@@ -0,0 +1,66 @@
+#ifndef __FRAMES_H__
+#define __FRAMES_H__
+#include "chip8.h"
+#include <stdatomic.h>
+
+/// ********************************三缓冲帧交换********************************** ///
+// 模拟线程与显示线程之间无锁交换完成的帧：三个槽位中写者和读者各占一个，
+// 第三个是最新完成的帧。写者把帧写入自己的槽位后与“最新”槽位原子交换并置新帧标志；
+// 读者只在有新帧时与“最新”槽位交换，取得的槽位在下一次取帧之前一直归读者所有。
+// 双方都不等待对方：写者总能发布（读者跟不上时旧帧被覆盖并计数），
+// 读者总能拿到最新的完整帧，不会看到写了一半的画面。
+//
+// 读者取帧时与上一次取出的帧逐行比较，得到真正变化的行，跳过的中间帧不会漏掉脏行。
+// 只允许一个写者线程和一个读者线程。
+//
+// 输入延迟：写者应用按键事件后用 chip8_frames_input 记下事件时刻，之后发布的帧
+// （只有画面变化时才发布，即对按键的第一个可见响应）都带上这个时刻，直到读者取走
+// 其中一帧；读者显示它之后，显示完成的时刻减去事件时刻就是从按键到画面的延迟。
+// 等待响应期间的后续按键并入同一次测量；超过 CHIP8_FRAMES_INPUT_TIMEOUT
+// 仍没有画面变化的按键（例如游戏不响应松开）放弃测量并计数。
+
+// 一个完成的帧
+typedef struct chip8_frame
+{
+    qword display[CHIP8_DISPLAY_HEIGHT]; // 显示缓冲区副本
+    qword cycles;                    // 发布时的指令周期
+    qword published;                 // 发布时刻（单调时钟，纳秒）
+    qword sequence;                  // 发布序号，从 1 开始
+    qword input;                     // 这一帧响应的最早按键时刻，0 表示没有
+    dword dirty_rows;                // 与读者上一次取出的帧相比变化的行（取帧时填写）
+} CHIP8_FRAME;
+
+// latest 中表示读者尚未取走的标志位，低两位是槽位号
+#define CHIP8_FRAMES_FRESH 0x4
+// 按键之后等待画面响应的最长时间（纳秒）
+#define CHIP8_FRAMES_INPUT_TIMEOUT 500000000ULL
+
+typedef struct chip8_frames
+{
+    CHIP8_FRAME slots[3];
+    _Atomic byte latest;             // 最新完成的槽位 | CHIP8_FRAMES_FRESH
+
+    _Atomic qword acquired_sequence; // 读者最近取出的帧的序号
+
+    // 只由写者访问
+    byte write;                      // 写者的槽位
+    qword sequence;                  // 已发布的帧数
+    qword input;                     // 等待画面响应的最早按键时刻，0 表示没有
+    qword input_sequence;            // 第一个带上 input 的帧的序号，0 表示还没有发布
+    qword input_timeouts;            // 没有等到画面响应的按键数
+
+    // 只由读者访问
+    byte read;                       // 读者的槽位
+    qword shown[CHIP8_DISPLAY_HEIGHT]; // 上一次取出的画面，用于计算脏行
+    qword last_sequence;             // 上一次取出的帧的序号
+    qword acquired;                  // 取出的帧数
+    qword skipped;                   // 读者来不及取、被新帧覆盖的帧数
+} CHIP8_FRAMES;
+
+void chip8_frames_init(CHIP8_FRAMES *frames);
+void chip8_frames_input(CHIP8_FRAMES *frames, qword ts);           // 写者：记下已应用的按键事件时刻
+void chip8_frames_publish(CHIP8_FRAMES *frames, const CHIP8 *chip8, qword now); // 写者：发布当前画面
+const CHIP8_FRAME *chip8_frames_acquire(CHIP8_FRAMES *frames); // 读者：取最新帧，没有新帧时返回 NULL
+/// ****************************************************************************** ///
+
+#endif
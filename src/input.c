@@ -0,0 +1,290 @@
+#include "input.h"
+
+/// ******************************输入记录与回放********************************** ///
+void chip8_input_log_init(CHIP8_INPUT_LOG *log, qword seed)
+{
+    memset(log, 0, sizeof(*log));
+    log->seed = seed;
+}
+
+void chip8_input_log_free(CHIP8_INPUT_LOG *log)
+{
+    free(log->events);
+    log->events = NULL;
+    log->count = 0;
+    log->capacity = 0;
+}
+
+/**
+ * chip8_input_log_append 在日志末尾追加一个事件。
+ *
+ * @param log 输入日志
+ * @param cycle 事件生效的指令周期，不能早于最后一个事件
+ * @param key 按键 0-F
+ * @param down 1 按下，0 松开
+ * @return 成功返回 0，参数无效或内存不足返回 -1
+ */
+int chip8_input_log_append(CHIP8_INPUT_LOG *log, qword cycle, byte key, byte down)
+{
+    if (key >= CHIP8_KEY_SIZE || (log->count && cycle < log->events[log->count - 1].cycle))
+        return -1;
+    if (log->count == log->capacity)
+    {
+        size_t capacity = log->capacity ? log->capacity * 2 : 64;
+        CHIP8_INPUT_EVENT *events = (CHIP8_INPUT_EVENT *)realloc(log->events, capacity * sizeof(CHIP8_INPUT_EVENT));
+        if (events == NULL)
+            return -1;
+        log->events = events;
+        log->capacity = capacity;
+    }
+    log->events[log->count++] = (CHIP8_INPUT_EVENT){ cycle, key, (byte)(down != 0) };
+    log->keys[key] = down != 0;
+    return 0;
+}
+
+/**
+ * chip8_input_record 比较 chip8->keys 与日志末尾的按键状态，把每个变化的按键
+ * 记录为一个发生在 chip8->cycles 的事件。每帧执行指令之前调用一次。
+ *
+ * @param log 输入日志
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
+void chip8_input_record(CHIP8_INPUT_LOG *log, const CHIP8 *chip8)
+{
+    for (byte key = 0; key < CHIP8_KEY_SIZE; key++)
+        if ((chip8->keys[key] != 0) != log->keys[key])
+            chip8_input_log_append(log, chip8->cycles, key, chip8->keys[key] != 0);
+}
+
+/**
+ * chip8_input_log_truncate 删除周期不早于 cycle 的事件，并重新计算末尾的按键状态。
+ * 回退到 cycle 之后调用，使日志与回退后的机器状态保持一致。
+ *
+ * @param log 输入日志
+ * @param cycle 回退后的指令周期
+ */
+void chip8_input_log_truncate(CHIP8_INPUT_LOG *log, qword cycle)
+{
+    while (log->count && log->events[log->count - 1].cycle >= cycle)
+        log->count--;
+    memset(log->keys, 0, sizeof(log->keys));
+    for (size_t i = 0; i < log->count; i++)
+        log->keys[log->events[i].key] = log->events[i].down;
+}
+
+static void put_le64(byte *out, qword value)
+{
+    for (int i = 0; i < 8; i++)
+        out[i] = (byte)(value >> (8 * i));
+}
+
+static qword get_le64(const byte *in)
+{
+    qword value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= (qword)in[i] << (8 * i);
+    return value;
+}
+
+/**
+ * chip8_input_log_save 把日志编码后写入文件。
+ *
+ * @param log 输入日志
+ * @param path 文件路径
+ * @return 成功返回 0，失败返回 -1
+ */
+int chip8_input_log_save(const CHIP8_INPUT_LOG *log, const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    byte header[13];
+    memcpy(header, CHIP8_INPUT_LOG_MAGIC, 4);
+    header[4] = CHIP8_INPUT_LOG_VERSION;
+    put_le64(header + 5, log->seed);
+    int error = fwrite(header, 1, sizeof(header), fp) != sizeof(header);
+
+    qword last = 0;
+    for (size_t i = 0; i < log->count && !error; i++)
+    {
+        byte record[11];
+        size_t n = 0;
+        qword delta = log->events[i].cycle - last;
+        while (delta >= 0x80)
+        {
+            record[n++] = (byte)(delta | 0x80);
+            delta >>= 7;
+        }
+        record[n++] = (byte)delta;
+        record[n++] = (byte)(log->events[i].key | (log->events[i].down << 4));
+        error = fwrite(record, 1, n, fp) != n;
+        last = log->events[i].cycle;
+    }
+    if (fclose(fp) != 0)
+        error = 1;
+    return error ? -1 : 0;
+}
+
+/**
+ * chip8_input_log_load 从文件读取日志，替换 log 原有的内容。
+ *
+ * @param log 已初始化的输入日志
+ * @param path 文件路径
+ * @return 成功返回 0，文件不存在、格式错误或版本不符返回 -1
+ */
+int chip8_input_log_load(CHIP8_INPUT_LOG *log, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+    byte header[13];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header)
+        || memcmp(header, CHIP8_INPUT_LOG_MAGIC, 4) != 0 || header[4] != CHIP8_INPUT_LOG_VERSION)
+    {
+        fclose(fp);
+        return -1;
+    }
+    chip8_input_log_free(log);
+    chip8_input_log_init(log, get_le64(header + 5));
+
+    qword cycle = 0;
+    int c, error = 0;
+    while (!error && (c = fgetc(fp)) != EOF)
+    {
+        qword delta = 0;
+        int shift = 0;
+        while (c & 0x80)
+        {
+            delta |= (qword)(c & 0x7F) << shift;
+            shift += 7;
+            if (shift > 63 || (c = fgetc(fp)) == EOF)
+                break;
+        }
+        int event = c == EOF || shift > 63 ? EOF : fgetc(fp);
+        if (event == EOF || (event & ~0x1F) != 0)
+        {
+            error = 1;
+            break;
+        }
+        delta |= (qword)c << shift;
+        cycle += delta;
+        error = chip8_input_log_append(log, cycle, (byte)(event & 0x0F), (byte)(event >> 4)) != 0;
+    }
+    fclose(fp);
+    if (error)
+    {
+        chip8_input_log_free(log);
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_input_replay_init(CHIP8_INPUT_REPLAY *replay, const CHIP8_INPUT_LOG *log)
+{
+    replay->log = log;
+    replay->next = 0;
+    memset(replay->keys, 0, sizeof(replay->keys));
+}
+
+/**
+ * chip8_input_replay_seek 应用所有周期不晚于 cycle 的事件，更新 replay->keys。
+ * cycle 倒退（例如回退或恢复快照）时从头重新定位。
+ *
+ * @param replay 回放游标
+ * @param cycle 当前指令周期
+ */
+void chip8_input_replay_seek(CHIP8_INPUT_REPLAY *replay, qword cycle)
+{
+    const CHIP8_INPUT_LOG *log = replay->log;
+    if (replay->next && log->events[replay->next - 1].cycle > cycle)
+        chip8_input_replay_init(replay, log);
+    while (replay->next < log->count && log->events[replay->next].cycle <= cycle)
+    {
+        replay->keys[log->events[replay->next].key] = log->events[replay->next].down;
+        replay->next++;
+    }
+}
+
+/**
+ * chip8_input_replay_apply 应用所有周期不晚于 chip8->cycles 的事件，
+ * 并用回放的按键状态覆盖 chip8->keys（忽略期间的真实键盘输入）。
+ *
+ * @param replay 回放游标
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
+void chip8_input_replay_apply(CHIP8_INPUT_REPLAY *replay, CHIP8 *chip8)
+{
+    chip8_input_replay_seek(replay, chip8->cycles);
+    memcpy(chip8->keys, replay->keys, sizeof(chip8->keys));
+}
+
+qword chip8_input_replay_next(const CHIP8_INPUT_REPLAY *replay)
+{
+    if (replay->next < replay->log->count)
+        return replay->log->events[replay->next].cycle;
+    return UINT64_MAX;
+}
+/// ****************************************************************************** ///
+
+
+/// ******************************实时输入队列************************************ ///
+void chip8_input_queue_init(CHIP8_INPUT_QUEUE *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+/**
+ * chip8_input_queue_push 写入一个按键事件，只由事件线程调用。
+ *
+ * @param queue 输入队列
+ * @param key 按键 0-F
+ * @param down 1 按下，0 松开
+ * @param ts 事件发生时刻（单调时钟，纳秒）
+ * @return 成功返回 0，按键无效或队列满返回 -1
+ */
+int chip8_input_queue_push(CHIP8_INPUT_QUEUE *queue, byte key, byte down, qword ts)
+{
+    if (key >= CHIP8_KEY_SIZE)
+        return -1;
+    dword head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&queue->tail, memory_order_acquire) >= CHIP8_INPUT_QUEUE_SIZE)
+    {
+        atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+        return -1;
+    }
+    queue->events[head & (CHIP8_INPUT_QUEUE_SIZE - 1)] = (CHIP8_INPUT_QUEUE_EVENT){ ts, key, (byte)(down != 0) };
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * chip8_input_queue_apply 在当前指令周期边界取出事件并写入 chip8->keys，只由模拟线程调用。
+ *
+ * 某个按键在本次已经变化过时停止，它和之后的事件留到下一个边界，
+ * 保证每次按下至少持续到下一个边界。
+ *
+ * @param queue 输入队列
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param first_ts 输出本次第一个事件的发生时刻，没有事件时不修改，可以为 NULL
+ * @return 应用的事件数
+ */
+dword chip8_input_queue_apply(CHIP8_INPUT_QUEUE *queue, CHIP8 *chip8, qword *first_ts)
+{
+    dword tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    dword head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    word changed = 0;
+    dword applied = 0;
+    for (; tail != head; tail++, applied++)
+    {
+        const CHIP8_INPUT_QUEUE_EVENT *e = &queue->events[tail & (CHIP8_INPUT_QUEUE_SIZE - 1)];
+        if (changed & (1u << e->key))
+            break;
+        changed |= (word)(1u << e->key);
+        chip8->keys[e->key] = e->down;
+        if (applied == 0 && first_ts != NULL)
+            *first_ts = e->ts;
+    }
+    atomic_store_explicit(&queue->tail, tail, memory_order_release);
+    return applied;
+}
+/// ****************************************************************************** ///
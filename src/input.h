@@ -0,0 +1,88 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+#include "chip8.h"
+#include <stdatomic.h>
+
+/// ******************************输入记录与回放********************************** ///
+// 输入日志按指令周期记录 keys[] 的每次变化，连同随机数种子一起保存，
+// 回放时在相同的指令周期边界重现相同的按键状态，结果与原始运行逐位一致。
+//
+// 文件格式（小端）：
+//   "C8IN" 魔数，1 字节版本号，8 字节种子，
+//   之后每个事件：LEB128 变长编码的周期增量（相对上一事件）+ 1 字节（低 4 位按键，第 4 位按下）
+// 通常一个事件占 2-3 字节。
+#define CHIP8_INPUT_LOG_MAGIC "C8IN"
+#define CHIP8_INPUT_LOG_VERSION 1
+
+// 输入事件
+typedef struct chip8_input_event
+{
+    qword cycle;                     // 事件生效的指令周期（在执行第 cycle 条指令之前）
+    byte key;                        // 按键 0-F
+    byte down;                       // 1 按下，0 松开
+} CHIP8_INPUT_EVENT;
+
+// 输入日志：内存中按周期升序保存事件，保存到文件时才压缩编码
+typedef struct chip8_input_log
+{
+    qword seed;                      // 录制时使用的随机数种子
+    CHIP8_INPUT_EVENT *events;
+    size_t count;
+    size_t capacity;
+    byte keys[CHIP8_KEY_SIZE];       // 日志末尾的按键状态，用于录制时比较
+} CHIP8_INPUT_LOG;
+
+// 回放游标
+typedef struct chip8_input_replay
+{
+    const CHIP8_INPUT_LOG *log;
+    size_t next;                     // 下一个未生效的事件
+    byte keys[CHIP8_KEY_SIZE];       // 当前回放的按键状态
+} CHIP8_INPUT_REPLAY;
+
+void chip8_input_log_init(CHIP8_INPUT_LOG *log, qword seed);
+void chip8_input_log_free(CHIP8_INPUT_LOG *log);
+int chip8_input_log_append(CHIP8_INPUT_LOG *log, qword cycle, byte key, byte down); // 追加一个事件，周期倒退返回 -1
+void chip8_input_record(CHIP8_INPUT_LOG *log, const CHIP8 *chip8);  // 记录 keys[] 相对日志末尾状态的变化
+void chip8_input_log_truncate(CHIP8_INPUT_LOG *log, qword cycle);   // 删除周期不早于 cycle 的事件（配合回退）
+int chip8_input_log_save(const CHIP8_INPUT_LOG *log, const char *path);
+int chip8_input_log_load(CHIP8_INPUT_LOG *log, const char *path);   // 格式错误或读取失败返回 -1
+
+void chip8_input_replay_init(CHIP8_INPUT_REPLAY *replay, const CHIP8_INPUT_LOG *log);
+void chip8_input_replay_seek(CHIP8_INPUT_REPLAY *replay, qword cycle);  // 应用周期不晚于 cycle 的事件，只更新 replay->keys
+void chip8_input_replay_apply(CHIP8_INPUT_REPLAY *replay, CHIP8 *chip8); // 应用所有已到期的事件并写入 keys[]
+qword chip8_input_replay_next(const CHIP8_INPUT_REPLAY *replay);         // 下一个事件的周期，没有时返回 UINT64_MAX
+/// ****************************************************************************** ///
+
+
+/// ******************************实时输入队列************************************ ///
+// 事件线程（SDL）把按键事件写入单生产者单消费者无锁环形缓冲区，模拟线程在指令周期边界
+// （每个模拟帧开始之前）取出并写入 keys[]，事件因此在确定的 chip8->cycles 生效，
+// 可以被输入日志原样记录。写者从不阻塞，队列满时丢弃并计数。
+//
+// 同一次取出中某个按键已经变化过时，它的下一个事件留到下一个边界：
+// 短于一帧的点按也至少被看到一帧，不会在同一个周期内按下又松开。
+#define CHIP8_INPUT_QUEUE_SIZE 256   // 队列容量（2 的幂）
+
+// 队列中的事件
+typedef struct chip8_input_queue_event
+{
+    qword ts;                        // 事件发生时刻（单调时钟，纳秒）
+    byte key;                        // 按键 0-F
+    byte down;                       // 1 按下，0 松开
+} CHIP8_INPUT_QUEUE_EVENT;
+
+typedef struct chip8_input_queue
+{
+    CHIP8_INPUT_QUEUE_EVENT events[CHIP8_INPUT_QUEUE_SIZE];
+    _Atomic dword head;              // 下一个写入位置（事件线程）
+    _Atomic dword tail;              // 下一个读取位置（模拟线程）
+    _Atomic qword dropped;           // 队列满时丢弃的事件数
+} CHIP8_INPUT_QUEUE;
+
+void chip8_input_queue_init(CHIP8_INPUT_QUEUE *queue);
+int chip8_input_queue_push(CHIP8_INPUT_QUEUE *queue, byte key, byte down, qword ts); // 写入一个事件，队列满返回 -1
+dword chip8_input_queue_apply(CHIP8_INPUT_QUEUE *queue, CHIP8 *chip8, qword *first_ts); // 在当前周期边界应用事件
+/// ****************************************************************************** ///
+
+#endif
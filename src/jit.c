@@ -0,0 +1,435 @@
+#include "chip8.h"
+
+#if CHIP8_HAVE_JIT
+#include <stddef.h>
+#include <sys/mman.h>
+
+/// ******************************x86-64 基本块 JIT******************************* ///
+// 把从某个 pc 开始的一段直线代码翻译成本地代码。块不是独立的函数，而是经过代码缓存开头的
+// 跳板进入：
+//   void enter(CHIP8 *chip8, dword budget, qword base, const byte *entry);
+// 跳板保存寄存器后跳到 entry，块内 rbx 保存 chip8 指针，r12d 为剩余预算，
+// r13 使第 i 条指令之前的 cycles 等于 r13 + i。V0-VF、I、pc 都以 [rbx+disp32] 的形式直接访问结构体。
+// 简单指令（6XNN、7XNN、8XY0-8XY3、ANNN、FX1E、1NNN）直接生成本地代码，
+// 其余指令调用 opcode.c 中的处理函数；会改变 pc 或写内存的指令结束当前块。
+//
+// 每条指令之前检查预算，用完时经块末尾的出口写回 pc 和 cycles 后返回，所以预算不足一个块时
+// 也不需要逐条解释。每条指令都是块的一个入口：pc 落在已编译块的中间时从这里进入，
+// 不为块的后缀重复编译。块末尾按新的 pc 查入口表，已编译时直接跳过去，不回到 C 代码。
+// 调用处理函数之前和离开块时写回 cycles，处理函数看到的 cycles 与逐条执行相同。
+
+// 可执行代码缓存大小
+#define CHIP8_JIT_CODE_SIZE (1024 * 1024)
+// 每个基本块最多包含的指令数
+#define CHIP8_JIT_MAX_BLOCK_INSNS 64
+// 编译一个块所需的最大代码字节数（每条指令连同出口最多约 90 字节，加上块末尾的跳转）
+#define CHIP8_JIT_MAX_BLOCK_BYTES (CHIP8_JIT_MAX_BLOCK_INSNS * 96 + 128)
+
+typedef void (*chip8_jit_enter_fn)(CHIP8 *chip8, dword budget, qword base, const byte *entry);
+
+// 以 pc 为下标的入口表项
+struct chip8_jit_entry
+{
+    const byte *code;                // 这条指令的本地代码，NULL 表示尚未编译
+    word index;                      // 这条指令在所在块中的序号
+};
+// emit_chain 用 shl 4 把 pc 换算成表项偏移，用 8 位位移读 index，用 8 位立即数加块长
+_Static_assert(sizeof(struct chip8_jit_entry) == 16, "emit_chain indexes entries with shl 4");
+_Static_assert(offsetof(struct chip8_jit_entry, index) < 128, "emit_chain reads index with a disp8");
+_Static_assert(CHIP8_JIT_MAX_BLOCK_INSNS < 128, "emit_chain adds the block length as an imm8");
+
+struct chip8_jit
+{
+    byte *code;                      // 可执行代码缓存，开头是跳板
+    size_t used;                     // 已使用字节数
+    struct chip8_jit_entry entries[CHIP8_MEMORY_SIZE];
+    byte covered[CHIP8_MEMORY_SIZE]; // 标记被已编译块覆盖的内存字节
+};
+
+// 结构体字段偏移
+#define JIT_V(x)     ((dword)(offsetof(CHIP8, registers) + (x)))
+#define JIT_I        ((dword)offsetof(CHIP8, index_register))
+#define JIT_PC       ((dword)offsetof(CHIP8, pc))
+#define JIT_OPCODE   ((dword)offsetof(CHIP8, opcode))
+#define JIT_CYCLES   ((dword)offsetof(CHIP8, cycles))
+
+/// *********************************指令编码************************************** ///
+static void emit8(struct chip8_jit *jit, byte b)
+{
+    jit->code[jit->used++] = b;
+}
+
+static void emit16(struct chip8_jit *jit, word w)
+{
+    emit8(jit, (byte)w);
+    emit8(jit, (byte)(w >> 8));
+}
+
+static void emit32(struct chip8_jit *jit, dword d)
+{
+    emit16(jit, (word)d);
+    emit16(jit, (word)(d >> 16));
+}
+
+static void emit64(struct chip8_jit *jit, qword q)
+{
+    emit32(jit, (dword)q);
+    emit32(jit, (dword)(q >> 32));
+}
+
+// ModRM：[rbx + disp32]，reg 字段为 r（al/eax 为 0）
+static void emit_rbx_disp(struct chip8_jit *jit, byte r, dword disp)
+{
+    emit8(jit, (byte)(0x80 | (r << 3) | 0x3));
+    emit32(jit, disp);
+}
+
+// mov byte [rbx+disp], imm8
+static void emit_store8(struct chip8_jit *jit, dword disp, byte imm)
+{
+    emit8(jit, 0xC6);
+    emit_rbx_disp(jit, 0, disp);
+    emit8(jit, imm);
+}
+
+// mov word [rbx+disp], imm16
+static void emit_store16(struct chip8_jit *jit, dword disp, word imm)
+{
+    emit8(jit, 0x66);
+    emit8(jit, 0xC7);
+    emit_rbx_disp(jit, 0, disp);
+    emit16(jit, imm);
+}
+
+// <op> byte [rbx+disp], al   （op：0x88 mov，0x08 or，0x20 and，0x30 xor）
+static void emit_alu8_al(struct chip8_jit *jit, byte op, dword disp)
+{
+    emit8(jit, op);
+    emit_rbx_disp(jit, 0, disp);
+}
+
+// mov al, byte [rbx+disp]
+static void emit_load_al(struct chip8_jit *jit, dword disp)
+{
+    emit8(jit, 0x8A);
+    emit_rbx_disp(jit, 0, disp);
+}
+
+// cycles = r13 + index：写回第 index 条指令之前的 cycles
+static void emit_set_cycles(struct chip8_jit *jit, word index)
+{
+    // lea rax, [r13+disp32]
+    emit8(jit, 0x49); emit8(jit, 0x8D); emit8(jit, 0x85);
+    emit32(jit, index);
+    // mov qword [rbx+cycles], rax
+    emit8(jit, 0x48); emit8(jit, 0x89);
+    emit_rbx_disp(jit, 0, JIT_CYCLES);
+}
+
+// 块末尾：预算未用完、没有故障且新的 pc 已有入口时直接跳过去，否则离开块。
+// 目标块第一条指令的预算检查必定通过，因此不会从它的出口写回错误的 opcode。
+static void emit_chain(struct chip8_jit *jit, word count)
+{
+    size_t leave[4];
+    // movzx eax, word [rbx+pc]; cmp eax, CHIP8_MEMORY_SIZE - 1; jae leave
+    emit8(jit, 0x0F); emit8(jit, 0xB7);
+    emit_rbx_disp(jit, 0, JIT_PC);
+    emit8(jit, 0x3D); emit32(jit, CHIP8_MEMORY_SIZE - 1);
+    emit8(jit, 0x0F); emit8(jit, 0x83); leave[0] = jit->used; emit32(jit, 0);
+    // test r12d, r12d; jz leave
+    emit8(jit, 0x45); emit8(jit, 0x85); emit8(jit, 0xE4);
+    emit8(jit, 0x0F); emit8(jit, 0x84); leave[1] = jit->used; emit32(jit, 0);
+    // cmp dword [rbx+error], 0; jne leave
+    emit8(jit, 0x83);
+    emit_rbx_disp(jit, 7, (dword)offsetof(CHIP8, error));
+    emit8(jit, 0x00);
+    emit8(jit, 0x0F); emit8(jit, 0x85); leave[2] = jit->used; emit32(jit, 0);
+    // shl eax, 4; mov rdx, imm64; add rax, rdx
+    emit8(jit, 0xC1); emit8(jit, 0xE0); emit8(jit, 0x04);
+    emit8(jit, 0x48); emit8(jit, 0xBA); emit64(jit, (qword)(uintptr_t)jit->entries);
+    emit8(jit, 0x48); emit8(jit, 0x01); emit8(jit, 0xD0);
+    // mov rcx, [rax]; test rcx, rcx; jz leave
+    emit8(jit, 0x48); emit8(jit, 0x8B); emit8(jit, 0x08);
+    emit8(jit, 0x48); emit8(jit, 0x85); emit8(jit, 0xC9);
+    emit8(jit, 0x0F); emit8(jit, 0x84); leave[3] = jit->used; emit32(jit, 0);
+    // movzx edx, word [rax+index]; add r13, count; sub r13, rdx; jmp rcx
+    emit8(jit, 0x0F); emit8(jit, 0xB7); emit8(jit, 0x50);
+    emit8(jit, (byte)offsetof(struct chip8_jit_entry, index));
+    emit8(jit, 0x49); emit8(jit, 0x83); emit8(jit, 0xC5); emit8(jit, (byte)count);
+    emit8(jit, 0x49); emit8(jit, 0x29); emit8(jit, 0xD5);
+    emit8(jit, 0xFF); emit8(jit, 0xE1);
+    for (int i = 0; i < 4; i++)
+    {
+        dword rel = (dword)(jit->used - (leave[i] + 4));
+        memcpy(jit->code + leave[i], &rel, sizeof(rel));
+    }
+}
+
+// 离开块：恢复跳板保存的寄存器并返回
+static void emit_leave(struct chip8_jit *jit)
+{
+    // pop r13; pop r12; pop rbx; ret
+    emit8(jit, 0x41); emit8(jit, 0x5D);
+    emit8(jit, 0x41); emit8(jit, 0x5C);
+    emit8(jit, 0x5B);
+    emit8(jit, 0xC3);
+}
+
+// 调用解释器处理函数：pc 与 opcode 按参考实现的顺序先写回结构体
+static void emit_call_handler(struct chip8_jit *jit, word next_pc, word opcode, opcode_func handler)
+{
+    emit_store16(jit, JIT_PC, next_pc);
+    emit_store16(jit, JIT_OPCODE, opcode);
+    // mov rdi, rbx
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xDF);
+    // mov rax, imm64
+    emit8(jit, 0x48); emit8(jit, 0xB8); emit64(jit, (qword)(uintptr_t)handler);
+    // call rax
+    emit8(jit, 0xFF); emit8(jit, 0xD0);
+}
+/// ****************************************************************************** ///
+
+// 生成跳板：保存 rbx/r12/r13（之后栈按 16 字节对齐，可以直接调用处理函数），
+// 装入 chip8、预算和 cycles 基准后跳到入口
+static void chip8_jit_emit_enter(struct chip8_jit *jit)
+{
+    // push rbx; push r12; push r13
+    emit8(jit, 0x53);
+    emit8(jit, 0x41); emit8(jit, 0x54);
+    emit8(jit, 0x41); emit8(jit, 0x55);
+    // mov rbx, rdi; mov r12d, esi; mov r13, rdx
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xFB);
+    emit8(jit, 0x41); emit8(jit, 0x89); emit8(jit, 0xF4);
+    emit8(jit, 0x49); emit8(jit, 0x89); emit8(jit, 0xD5);
+    // jmp rcx
+    emit8(jit, 0xFF); emit8(jit, 0xE1);
+}
+
+// 丢弃全部已编译的块，只保留跳板
+static void chip8_jit_flush(struct chip8_jit *jit)
+{
+    jit->used = 0;
+    chip8_jit_emit_enter(jit);
+    memset(jit->entries, 0, sizeof(jit->entries));
+    memset(jit->covered, 0, sizeof(jit->covered));
+}
+
+// 编译以 start 开始的基本块，返回 start 的入口表项
+static struct chip8_jit_entry *chip8_jit_compile(CHIP8 *chip8, struct chip8_jit *jit, word start)
+{
+    if (jit->used + CHIP8_JIT_MAX_BLOCK_BYTES > CHIP8_JIT_CODE_SIZE)
+        chip8_jit_flush(jit);
+
+    word pc = start;
+    word count = 0;
+    word last_opcode = 0;
+    byte open = 1;     // 块末尾是否还需要写回 pc/opcode
+    // 每条指令的预算检查跳到块末尾各自的出口，rel32 在生成出口后回填
+    size_t exit_patch[CHIP8_JIT_MAX_BLOCK_INSNS];
+    word exit_opcode[CHIP8_JIT_MAX_BLOCK_INSNS];
+
+    while (count < CHIP8_JIT_MAX_BLOCK_INSNS && pc < CHIP8_MEMORY_SIZE - 1)
+    {
+        word opcode = (word)((chip8->memory[pc] << 8) | chip8->memory[pc + 1]);
+        enum chip8_op op = chip8_decode(opcode);
+        jit->covered[pc] = jit->covered[pc + 1] = 1;
+        if (jit->entries[pc].code == NULL)
+        {
+            jit->entries[pc].code = jit->code + jit->used;
+            jit->entries[pc].index = count;
+        }
+        // sub r12d, 1; jb exit
+        emit8(jit, 0x41); emit8(jit, 0x83); emit8(jit, 0xEC); emit8(jit, 0x01);
+        emit8(jit, 0x0F); emit8(jit, 0x82);
+        exit_patch[count] = jit->used;
+        exit_opcode[count] = last_opcode;
+        emit32(jit, 0);
+        last_opcode = opcode;
+        pc += 2;
+        count++;
+
+        switch (op) {
+            case CHIP8_OP_6XNN:
+                emit_store8(jit, JIT_V(X(opcode)), NN(opcode));
+                continue;
+            case CHIP8_OP_7XNN:
+                // add byte [rbx+disp], imm8
+                emit8(jit, 0x80);
+                emit_rbx_disp(jit, 0, JIT_V(X(opcode)));
+                emit8(jit, NN(opcode));
+                continue;
+            case CHIP8_OP_8XY0:
+            case CHIP8_OP_8XY1:
+            case CHIP8_OP_8XY2:
+            case CHIP8_OP_8XY3:
+            {
+                static const byte alu[] = { 0x88, 0x08, 0x20, 0x30 };
+                emit_load_al(jit, JIT_V(Y(opcode)));
+                emit_alu8_al(jit, alu[op - CHIP8_OP_8XY0], JIT_V(X(opcode)));
+                continue;
+            }
+            case CHIP8_OP_ANNN:
+                emit_store16(jit, JIT_I, NNN(opcode));
+                continue;
+            case CHIP8_OP_FX1E:
+                // movzx eax, byte [rbx+Vx]; add word [rbx+I], ax
+                emit8(jit, 0x0F); emit8(jit, 0xB6);
+                emit_rbx_disp(jit, 0, JIT_V(X(opcode)));
+                emit8(jit, 0x66); emit8(jit, 0x01);
+                emit_rbx_disp(jit, 0, JIT_I);
+                continue;
+            case CHIP8_OP_1NNN:
+                emit_store16(jit, JIT_PC, NNN(opcode));
+                emit_store16(jit, JIT_OPCODE, opcode);
+                open = 0;
+                break;
+            // 改变控制流、等待输入、绘图或写内存的指令：调用解释器后结束本块
+            case CHIP8_OP_00EE:
+            case CHIP8_OP_2NNN:
+            case CHIP8_OP_3XNN:
+            case CHIP8_OP_4XNN:
+            case CHIP8_OP_5XY0:
+            case CHIP8_OP_9XY0:
+            case CHIP8_OP_BNNN:
+            case CHIP8_OP_DXYN:
+            case CHIP8_OP_EX9E:
+            case CHIP8_OP_EXA1:
+            case CHIP8_OP_FX0A:
+            case CHIP8_OP_FX33:
+            case CHIP8_OP_FX55:
+                emit_set_cycles(jit, count - 1);
+                emit_call_handler(jit, pc, opcode, chip8_opcode_handlers[op]);
+                open = 0;
+                break;
+            // 其余指令不改变 pc，调用解释器后继续本块
+            default:
+                emit_set_cycles(jit, count - 1);
+                emit_call_handler(jit, pc, opcode, chip8_opcode_handlers[op]);
+                continue;
+        }
+        break;
+    }
+
+    if (open)
+    {
+        emit_store16(jit, JIT_PC, pc);
+        emit_store16(jit, JIT_OPCODE, last_opcode);
+    }
+    emit_chain(jit, count);
+    emit_set_cycles(jit, count);
+    emit_leave(jit);
+
+    // 预算用完的出口：停在第 i 条指令之前
+    for (word i = 0; i < count; i++)
+    {
+        dword rel = (dword)(jit->used - (exit_patch[i] + 4));
+        memcpy(jit->code + exit_patch[i], &rel, sizeof(rel));
+        emit_set_cycles(jit, i);
+        emit_store16(jit, JIT_PC, (word)(start + 2 * i));
+        if (i > 0)
+            emit_store16(jit, JIT_OPCODE, exit_opcode[i]);
+        emit_leave(jit);
+    }
+    return &jit->entries[start];
+}
+
+// 创建 JIT 上下文，失败时返回 NULL
+static struct chip8_jit *chip8_jit_create(void)
+{
+    struct chip8_jit *jit = (struct chip8_jit *)calloc(1, sizeof(struct chip8_jit));
+    if (jit == NULL)
+        return NULL;
+    void *code = mmap(NULL, CHIP8_JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        free(jit);
+        return NULL;
+    }
+    jit->code = (byte *)code;
+    chip8_jit_flush(jit);
+    return jit;
+}
+
+/**
+ * chip8_jit_free 释放 JIT 上下文和可执行代码缓存。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
+void chip8_jit_free(CHIP8 *chip8)
+{
+    if (chip8->jit == NULL)
+        return;
+    munmap(chip8->jit->code, CHIP8_JIT_CODE_SIZE);
+    free(chip8->jit);
+    chip8->jit = NULL;
+}
+
+/**
+ * chip8_jit_invalidate 在内存写入已编译代码时丢弃编译结果。
+ *
+ * 写内存的指令都会结束当前块，因此这里可以安全地清空整个代码缓存：
+ * 正在执行的块只剩下写回 cycles 和返回的序列，旧代码在下次编译前不会被覆盖。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param addr 被写入的起始地址
+ * @param len 被写入的字节数
+ */
+void chip8_jit_invalidate(CHIP8 *chip8, word addr, word len)
+{
+    struct chip8_jit *jit = chip8->jit;
+    for (dword a = addr; a < (dword)addr + len && a < CHIP8_MEMORY_SIZE; a++)
+    {
+        if (jit->covered[a])
+        {
+            chip8_jit_flush(jit);
+            return;
+        }
+    }
+}
+
+/**
+ * chip8_jit_run 以基本块为单位执行 cycles 条指令。
+ *
+ * 块内逐条检查预算，预算在块中间用完时从那里返回，之后从同一个块的中间继续。
+ * 只有无法编译的位置（越过内存末尾）交给参考解释器执行，因此执行的指令数与其他引擎完全一致。
+ * 块自己写回 cycles；故障只发生在结束块的指令中，执行完故障所在的块即返回。
+ * 无法分配可执行内存时退回 CACHE 引擎。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param cycles 要执行的指令数
+ * @return 实际执行的指令数
+ */
+dword chip8_jit_run(CHIP8 *chip8, dword cycles)
+{
+    if (chip8->jit == NULL)
+    {
+        chip8->jit = chip8_jit_create();
+        if (chip8->jit == NULL)
+        {
+            chip8->engine = CHIP8_ENGINE_CACHE;
+            return chip8_emulate_cycles(chip8, cycles);
+        }
+    }
+
+    struct chip8_jit *jit = chip8->jit;
+    chip8_jit_enter_fn enter = (chip8_jit_enter_fn)(void *)jit->code;
+    qword begin = chip8->cycles;
+    qword end = begin + cycles;
+    while (chip8->cycles < end && chip8->error == CHIP8_OK)
+    {
+        word pc = chip8->pc;
+        if (pc >= CHIP8_MEMORY_SIZE - 1)
+        {
+            chip8_emulate_cycle(chip8);
+            continue;
+        }
+        struct chip8_jit_entry *entry = &jit->entries[pc];
+        if (entry->code == NULL)
+            entry = chip8_jit_compile(chip8, jit, pc);
+        enter(chip8, (dword)(end - chip8->cycles), chip8->cycles - entry->index, entry->code);
+    }
+    return (dword)(chip8->cycles - begin);
+}
+/// ****************************************************************************** ///
+#endif
@@ -0,0 +1,772 @@
+#include "lanes.h"
+#include <pthread.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CHIP8_LANES_X86 1
+#else
+#define CHIP8_LANES_X86 0
+#endif
+
+#if CHIP8_LANE_COUNT != 8 && CHIP8_LANE_COUNT != 16
+#error "CHIP8_LANE_COUNT must be 8 or 16"
+#endif
+
+/// ******************************SIMD 锁步通道*********************************** ///
+// 通道向量：字节寄存器一条 CHIP8_LANE_COUNT 字节，pc、I、操作码一条 2 * CHIP8_LANE_COUNT 字节
+// （16 通道时正好一个 AVX2 寄存器）。比较的结果是同宽的有符号向量，真为 -1，
+// 直接用作掩码：按组掩码合并写回 old ^ ((old ^ new) & mask)，组外的通道不变。
+typedef byte lane_bytes __attribute__((vector_size(CHIP8_LANE_COUNT)));
+typedef signed char lane_bmask __attribute__((vector_size(CHIP8_LANE_COUNT)));
+typedef word lane_words __attribute__((vector_size(CHIP8_LANE_COUNT * 2)));
+typedef short lane_wmask __attribute__((vector_size(CHIP8_LANE_COUNT * 2)));
+
+// 字向量只在函数内部使用，经 memcpy 读写：32 字节向量作为参数或返回值时，
+// 非 AVX 代码与 AVX 代码的调用约定不同
+#define LANES_LOAD(v, p) memcpy(&(v), (p), sizeof(v))
+#define LANES_STORE(p, v) memcpy((p), &(v), sizeof(v))
+
+// 第 l 条通道对应组掩码的第 l 位
+static const word lanes_bits[16] = {
+    0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+    0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, 0x8000
+};
+
+// 以完整操作码为下标的操作码编号，与 dispatch.c 的 chip8_opcode_index 相同，由 chip8_decode 生成
+static byte lanes_decode[0x10000];
+
+static dword (*lanes_kernel)(CHIP8_LANES *lanes, dword cycles);
+static const char *lanes_kernel_name;
+static pthread_once_t lanes_once = PTHREAD_ONCE_INIT;
+
+// 遍历掩码中的通道
+#define LANES_FOR_EACH(l, mask) \
+    for (dword m_ = (mask), l; m_ && ((l = (dword)__builtin_ctz(m_)), 1); m_ &= m_ - 1)
+
+static inline lane_bytes lanes_load_bytes(const byte *p)
+{
+    lane_bytes v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 按组掩码把 value 写入寄存器向量
+static inline void lanes_store_bytes(byte *p, lane_bytes value, lane_bytes mask)
+{
+    lane_bytes old = lanes_load_bytes(p);
+    old ^= (old ^ value) & mask;
+    memcpy(p, &old, sizeof(old));
+}
+
+// 第 l 条通道写内存，并标记这个字在各通道间可能不同
+static inline void lanes_write(CHIP8_LANES *lanes, dword lane, word addr, byte value)
+{
+    addr &= CHIP8_MEMORY_SIZE - 1;
+    lanes->memory[lane][addr] = value;
+    lanes->diverged[addr >> 1] = 1;
+}
+
+// 与 opcode_DXYN 相同的绘制，作用于一条通道
+static void lanes_draw(CHIP8_LANES *lanes, dword lane, byte vx, byte vy, byte n)
+{
+    byte start_x = vx & (CHIP8_DISPLAY_WIDTH - 1);
+    byte start_y = vy & (CHIP8_DISPLAY_HEIGHT - 1);
+    byte wrap = lanes->quirks & CHIP8_QUIRK_WRAP_SPRITES;
+    word index = lanes->index_register[lane];
+    qword *display = lanes->display[lane];
+    qword collision = 0;
+
+    for (byte height = 0; height < n; height++)
+    {
+        byte y = start_y + height;
+        if (y >= CHIP8_DISPLAY_HEIGHT)
+        {
+            if (!wrap)
+                break;
+            y -= CHIP8_DISPLAY_HEIGHT;
+        }
+        qword sprite = (qword)lanes->memory[lane][(index + height) & (CHIP8_MEMORY_SIZE - 1)] << 56;
+        qword line = sprite >> start_x;
+        if (wrap && start_x)
+            line |= sprite << (64 - start_x);
+        if (line)
+        {
+            collision |= display[y] & line;
+            display[y] ^= line;
+            lanes->display_dirty_rows[lane] |= 1u << y;
+        }
+    }
+    lanes->registers[0xF][lane] = collision != 0;
+}
+
+/**
+ * lanes_execute_lane 在一条通道上执行一条指令，语义与 opcode.c 中的处理函数逐条对应。
+ *
+ * 访问各自内存、显示、调用栈、按键或定时器的指令总是走这里；
+ * 只有一条通道的组也走这里，比整条向量运算再合并更快。调用前 pc 已经加 2。
+ *
+ * @param lanes 通道
+ * @param l 通道号
+ * @param op 操作码编号
+ * @param opcode 操作码
+ * @param elapsed 本次 chip8_lanes_run 已执行、尚未计入 cycles 的步数
+ * @return 发生故障返回 1（与 chip8_fault 相同，pc 退回到故障指令，只记录第一次故障）
+ */
+static byte lanes_execute_lane(CHIP8_LANES *lanes, dword l, enum chip8_op op, word opcode, dword elapsed)
+{
+    byte (*v)[CHIP8_LANE_COUNT] = lanes->registers;
+    byte x = X(opcode);
+    byte y = Y(opcode);
+    byte nn = NN(opcode);
+    word nnn = NNN(opcode);
+    word index = lanes->index_register[l];
+    enum chip8_error error = CHIP8_OK;
+    qword frame;
+    word sum;
+
+    switch (op) {
+        case CHIP8_OP_00E0:
+            for (byte row = 0; row < CHIP8_DISPLAY_HEIGHT; row++)
+            {
+                if (lanes->display[l][row])
+                    lanes->display_dirty_rows[l] |= 1u << row;
+                lanes->display[l][row] = 0;
+            }
+            break;
+        case CHIP8_OP_00EE:
+            if (lanes->sp[l] > 0)
+                lanes->pc[l] = lanes->stack[--lanes->sp[l]][l];
+            else
+                error = CHIP8_ERROR_STACK_UNDERFLOW;
+            break;
+        case CHIP8_OP_1NNN:
+            lanes->pc[l] = nnn;
+            break;
+        case CHIP8_OP_2NNN:
+            if (lanes->sp[l] >= 16)
+            {
+                error = CHIP8_ERROR_STACK_OVERFLOW;
+                break;
+            }
+            lanes->stack[lanes->sp[l]++][l] = lanes->pc[l];
+            lanes->pc[l] = nnn;
+            break;
+        case CHIP8_OP_3XNN:
+            lanes->pc[l] += v[x][l] == nn ? 2 : 0;
+            break;
+        case CHIP8_OP_4XNN:
+            lanes->pc[l] += v[x][l] != nn ? 2 : 0;
+            break;
+        case CHIP8_OP_5XY0:
+            lanes->pc[l] += v[x][l] == v[y][l] ? 2 : 0;
+            break;
+        case CHIP8_OP_6XNN:
+            v[x][l] = nn;
+            break;
+        case CHIP8_OP_7XNN:
+            v[x][l] += nn;
+            break;
+        case CHIP8_OP_8XY0:
+            v[x][l] = v[y][l];
+            break;
+        case CHIP8_OP_8XY1:
+            v[x][l] |= v[y][l];
+            break;
+        case CHIP8_OP_8XY2:
+            v[x][l] &= v[y][l];
+            break;
+        case CHIP8_OP_8XY3:
+            v[x][l] ^= v[y][l];
+            break;
+        case CHIP8_OP_8XY4:
+            sum = (word)v[x][l] + (word)v[y][l];
+            v[x][l] = sum & 0xFF;
+            v[0xF][l] = (sum & 0x0100) >> 8;
+            break;
+        case CHIP8_OP_8XY5:
+            v[0xF][l] = v[x][l] > v[y][l];
+            v[x][l] -= v[y][l];
+            break;
+        case CHIP8_OP_8XY6:
+            v[0xF][l] = v[x][l] & 0x01;
+            v[x][l] = v[x][l] >> 1;
+            break;
+        case CHIP8_OP_8XY7:
+            v[0xF][l] = v[x][l] < v[y][l];
+            v[x][l] = v[y][l] - v[x][l];
+            break;
+        case CHIP8_OP_8XYE:
+            v[0xF][l] = (v[x][l] & 0x80) >> 7;
+            v[x][l] = v[x][l] << 1;
+            break;
+        case CHIP8_OP_9XY0:
+            lanes->pc[l] += v[x][l] != v[y][l] ? 2 : 0;
+            break;
+        case CHIP8_OP_ANNN:
+            lanes->index_register[l] = nnn;
+            break;
+        case CHIP8_OP_BNNN:
+            lanes->pc[l] = nnn + v[0][l];
+            break;
+        case CHIP8_OP_CXNN:
+            v[x][l] = nn & chip8_random_next(&lanes->rng[l]);
+            break;
+        case CHIP8_OP_DXYN:
+            lanes_draw(lanes, l, v[x][l], v[y][l], N(opcode));
+            break;
+        case CHIP8_OP_EX9E:
+            if (v[x][l] < 16 && lanes->keys[l][v[x][l]])
+                lanes->pc[l] += 2;
+            break;
+        case CHIP8_OP_EXA1:
+            if (v[x][l] < 16 && !lanes->keys[l][v[x][l]])
+                lanes->pc[l] += 2;
+            break;
+        case CHIP8_OP_FX07:
+            frame = (lanes->cycles[l] + elapsed) / CHIP8_CYCLES_PER_FRAME;
+            v[x][l] = lanes->delay_deadline[l] > frame ? (byte)(lanes->delay_deadline[l] - frame) : 0;
+            break;
+        case CHIP8_OP_FX0A:
+        {
+            byte key_pressed = 0;
+            for (byte i = 0; i < CHIP8_KEY_SIZE - 1; i++)
+            {
+                if (lanes->keys[l][i])
+                {
+                    v[x][l] = i;
+                    key_pressed = 1;
+                }
+            }
+            if (!key_pressed)
+                lanes->pc[l] -= 2;
+            break;
+        }
+        case CHIP8_OP_FX15:
+            frame = (lanes->cycles[l] + elapsed) / CHIP8_CYCLES_PER_FRAME;
+            lanes->delay_deadline[l] = frame + v[x][l];
+            break;
+        case CHIP8_OP_FX18:
+            frame = (lanes->cycles[l] + elapsed) / CHIP8_CYCLES_PER_FRAME;
+            lanes->sound_deadline[l] = frame + v[x][l];
+            break;
+        case CHIP8_OP_FX1E:
+            lanes->index_register[l] += v[x][l];
+            break;
+        case CHIP8_OP_FX29:
+            lanes->index_register[l] = lanes->memory[l][CHIP8_FONTSET_MEM_START_ADDR + 5 * v[x][l]];
+            break;
+        case CHIP8_OP_FX33:
+        {
+            int value = v[x][l];
+            lanes_write(lanes, l, index, value % 10);
+            lanes_write(lanes, l, index + 1, value / 10u % 10u);
+            lanes_write(lanes, l, index + 2, value / 100u % 10u);
+            break;
+        }
+        case CHIP8_OP_FX55:
+            for (int i = 0; i <= x; i++)
+                lanes_write(lanes, l, index + i, v[i][l]);
+            break;
+        case CHIP8_OP_FX65:
+            for (int i = 0; i <= x; i++)
+                v[i][l] = lanes->memory[l][(index + i) & (CHIP8_MEMORY_SIZE - 1)];
+            break;
+        default:
+            // 未知操作码不改变状态
+            break;
+    }
+    if (error == CHIP8_OK)
+        return 0;
+    lanes->pc[l] -= 2;
+    if (lanes->error[l] == CHIP8_OK)
+        lanes->error[l] = error;
+    return 1;
+}
+
+/**
+ * lanes_execute 在一组通道上执行同一条指令。
+ *
+ * 寄存器算术、比较跳过、跳转和 I 的运算对整条向量计算后按组掩码写回，
+ * 与处理函数一样按顺序读写（例如 8XY5 先写 VF 再重新读取 VX、VY），X 或 Y 为 F 时结果相同。
+ * 其余指令以及只有一条通道的组逐通道执行。
+ *
+ * @param lanes 通道
+ * @param opcode 操作码
+ * @param group 执行这条指令的通道
+ * @param elapsed 本次 chip8_lanes_run 已执行、尚未计入 cycles 的步数
+ * @return 执行中发生故障的通道
+ */
+static inline __attribute__((always_inline)) dword lanes_execute(CHIP8_LANES *lanes, word opcode, dword group,
+                                                                 dword elapsed)
+{
+    enum chip8_op op = (enum chip8_op)lanes_decode[opcode];
+    if ((group & (group - 1)) == 0)
+    {
+        dword l = (dword)__builtin_ctz(group);
+        lanes->pc[l] += 2;
+        return (dword)lanes_execute_lane(lanes, l, op, opcode, elapsed) << l;
+    }
+
+    byte x = X(opcode);
+    byte y = Y(opcode);
+    byte nn = NN(opcode);
+    word nnn = NNN(opcode);
+    byte (*v)[CHIP8_LANE_COUNT] = lanes->registers;
+
+    lane_words bits, wm, pc, index;
+    LANES_LOAD(bits, lanes_bits);
+    wm = (lane_words)((bits & (word)group) != 0);
+    lane_bytes bm = (lane_bytes)__builtin_convertvector((lane_wmask)wm, lane_bmask);
+    lane_bytes vx = lanes_load_bytes(v[x]);
+    lane_bytes vy = lanes_load_bytes(v[y]);
+    lane_bytes flag;
+
+    LANES_LOAD(pc, lanes->pc);
+    pc += wm & 2;
+    switch (op) {
+        case CHIP8_OP_1NNN:
+            pc ^= (pc ^ nnn) & wm;
+            break;
+        case CHIP8_OP_3XNN:
+            pc += (lane_words)__builtin_convertvector(vx == nn, lane_wmask) & wm & 2;
+            break;
+        case CHIP8_OP_4XNN:
+            pc += (lane_words)__builtin_convertvector(vx != nn, lane_wmask) & wm & 2;
+            break;
+        case CHIP8_OP_5XY0:
+            pc += (lane_words)__builtin_convertvector(vx == vy, lane_wmask) & wm & 2;
+            break;
+        case CHIP8_OP_9XY0:
+            pc += (lane_words)__builtin_convertvector(vx != vy, lane_wmask) & wm & 2;
+            break;
+        case CHIP8_OP_6XNN:
+            lanes_store_bytes(v[x], (lane_bytes){ 0 } + nn, bm);
+            break;
+        case CHIP8_OP_7XNN:
+            lanes_store_bytes(v[x], vx + nn, bm);
+            break;
+        case CHIP8_OP_8XY0:
+            lanes_store_bytes(v[x], vy, bm);
+            break;
+        case CHIP8_OP_8XY1:
+            lanes_store_bytes(v[x], vx | vy, bm);
+            break;
+        case CHIP8_OP_8XY2:
+            lanes_store_bytes(v[x], vx & vy, bm);
+            break;
+        case CHIP8_OP_8XY3:
+            lanes_store_bytes(v[x], vx ^ vy, bm);
+            break;
+        case CHIP8_OP_8XY4:
+            // 和小于加数即进位
+            lanes_store_bytes(v[x], vx + vy, bm);
+            lanes_store_bytes(v[0xF], (lane_bytes)((lane_bytes)(vx + vy) < vx) & 1, bm);
+            break;
+        case CHIP8_OP_8XY5:
+            lanes_store_bytes(v[0xF], (lane_bytes)(vx > vy) & 1, bm);
+            vx = lanes_load_bytes(v[x]);
+            vy = lanes_load_bytes(v[y]);
+            lanes_store_bytes(v[x], vx - vy, bm);
+            break;
+        case CHIP8_OP_8XY6:
+            lanes_store_bytes(v[0xF], vx & 1, bm);
+            vx = lanes_load_bytes(v[x]);
+            lanes_store_bytes(v[x], vx >> 1, bm);
+            break;
+        case CHIP8_OP_8XY7:
+            flag = (lane_bytes)(vx < vy) & 1;
+            lanes_store_bytes(v[0xF], flag, bm);
+            vx = lanes_load_bytes(v[x]);
+            vy = lanes_load_bytes(v[y]);
+            lanes_store_bytes(v[x], vy - vx, bm);
+            break;
+        case CHIP8_OP_8XYE:
+            lanes_store_bytes(v[0xF], vx >> 7, bm);
+            vx = lanes_load_bytes(v[x]);
+            lanes_store_bytes(v[x], vx << 1, bm);
+            break;
+        case CHIP8_OP_ANNN:
+            LANES_LOAD(index, lanes->index_register);
+            index ^= (index ^ nnn) & wm;
+            LANES_STORE(lanes->index_register, index);
+            break;
+        case CHIP8_OP_FX1E:
+            LANES_LOAD(index, lanes->index_register);
+            index ^= ((index + __builtin_convertvector(vx, lane_words)) ^ index) & wm;
+            LANES_STORE(lanes->index_register, index);
+            break;
+        case CHIP8_OP_BNNN:
+            pc ^= ((__builtin_convertvector(lanes_load_bytes(v[0]), lane_words) + nnn) ^ pc) & wm;
+            break;
+        default:
+        {
+            LANES_STORE(lanes->pc, pc);
+            dword faults = 0;
+            LANES_FOR_EACH(l, group)
+                faults |= (dword)lanes_execute_lane(lanes, l, op, opcode, elapsed) << l;
+            return faults;
+        }
+    }
+    LANES_STORE(lanes->pc, pc);
+    return 0;
+}
+
+// 把每条通道至多一位（各不相同）的字向量合并为掩码
+#define LANES_REDUCE(out, vec)                                  \
+    do {                                                        \
+        qword q_[CHIP8_LANE_COUNT / 4];                         \
+        memcpy(q_, &(vec), sizeof(q_));                         \
+        qword r_ = 0;                                           \
+        for (int i_ = 0; i_ < CHIP8_LANE_COUNT / 4; i_++)       \
+            r_ |= q_[i_];                                       \
+        r_ |= r_ >> 32;                                         \
+        r_ |= r_ >> 16;                                         \
+        (out) = (dword)(word)r_;                                \
+    } while (0)
+
+/**
+ * lanes_run_each 在分叉严重时逐通道执行 count 步，各通道执行的指令与锁步时相同。
+ *
+ * 平均每组不到两条通道时，分组的开销超过了向量执行的收益；此时每条通道
+ * 各自连续执行到下一个帧边界（或 limit），之后回到锁步，操作码重新一致的
+ * 通道又会合并。故障的通道同样在帧边界停机。
+ *
+ * @param lanes 通道
+ * @param running 运行中的通道，停机的通道从中清除
+ * @param faulted 发生过故障的通道
+ * @param elapsed 本次运行已经执行的步数
+ * @param count 执行的步数
+ */
+static void lanes_run_each(CHIP8_LANES *lanes, dword *running, dword *faulted, dword elapsed, dword count)
+{
+    LANES_FOR_EACH(l, *running)
+    {
+        dword i = 0;
+        while (i < count)
+        {
+            word pc = lanes->pc[l];
+            word opcode = (word)(lanes->memory[l][pc & (CHIP8_MEMORY_SIZE - 1)] << 8
+                                 | lanes->memory[l][(pc + 1) & (CHIP8_MEMORY_SIZE - 1)]);
+            lanes->opcode[l] = opcode;
+            lanes->pc[l] = pc + 2;
+            *faulted |= (dword)lanes_execute_lane(lanes, l, lanes_decode[opcode], opcode, elapsed + i) << l;
+            i++;
+            if ((*faulted >> l & 1) && (lanes->cycles[l] + elapsed + i) % CHIP8_CYCLES_PER_FRAME == 0)
+            {
+                lanes->cycles[l] += elapsed + i;
+                lanes->halted |= 1u << l;
+                *running &= ~(1u << l);
+                break;
+            }
+        }
+        lanes->lane_cycles += i;
+        lanes->groups += i;
+    }
+}
+
+/**
+ * lanes_run_body 是锁步执行的主循环，由 AVX2 和默认两个版本分别内联展开。
+ *
+ * 每一步为运行中的通道取指，按操作码分组执行。所有运行中的通道 pc 相同、
+ * 且没有通道写过这条指令时（同一 ROM 的常见情况），只取一次指令，整步就是一组。
+ * 一次执行的步数不超过运行中的通道到达 stop 的最少步数，因此循环内不检查 stop；
+ * 各通道的 cycles 在离开循环时才累加，故障的通道在帧边界停机。
+ * 一步分出的组数超过运行通道数的一半时，下一段改为 lanes_run_each 逐通道执行。
+ *
+ * @param lanes 通道
+ * @param cycles 最多执行的步数
+ * @return 执行的步数
+ */
+static inline __attribute__((always_inline)) dword lanes_run_body(CHIP8_LANES *lanes, dword cycles)
+{
+    dword running = 0;
+    dword faulted = 0;
+    dword limit = cycles;
+    LANES_FOR_EACH(l, lanes->active & ~lanes->halted)
+    {
+        if (lanes->cycles[l] >= lanes->stop[l])
+            continue;
+        running |= 1u << l;
+        if (lanes->stop[l] - lanes->cycles[l] < limit)
+            limit = (dword)(lanes->stop[l] - lanes->cycles[l]);
+        // 上一次返回时还在执行故障所在的帧段
+        if (lanes->error[l] != CHIP8_OK)
+            faulted |= 1u << l;
+    }
+
+    lane_words bits;
+    LANES_LOAD(bits, lanes_bits);
+    dword steps = 0;
+    byte scattered = 0;              // 非 0 时下一段逐通道执行 1 << (scattered - 1) 帧
+    byte spread = 0;                 // 上一段逐通道执行时的 scattered
+    for (; steps < limit && running; steps++)
+    {
+        if (scattered)
+        {
+            // 逐通道执行到帧边界（以第一条运行中的通道为准），再尝试锁步；
+            // 连续分叉时每次多执行一倍的帧，最多 8 帧
+            dword first = (dword)__builtin_ctz(running);
+            dword count = (CHIP8_CYCLES_PER_FRAME << (scattered - 1))
+                          - (dword)((lanes->cycles[first] + steps) % CHIP8_CYCLES_PER_FRAME);
+            if (count > limit - steps)
+                count = limit - steps;
+            lanes_run_each(lanes, &running, &faulted, steps, count);
+            steps += count - 1;
+            spread = scattered;
+            scattered = 0;
+            continue;
+        }
+        lane_words pcs, opcodes, live;
+        LANES_LOAD(pcs, lanes->pc);
+        live = (lane_words)((bits & (word)running) != 0);
+        dword first = (dword)__builtin_ctz(running);
+        word pc = lanes->pc[first];
+        word opcode = (word)(lanes->memory[first][pc & (CHIP8_MEMORY_SIZE - 1)] << 8
+                             | lanes->memory[first][(pc + 1) & (CHIP8_MEMORY_SIZE - 1)]);
+
+        lane_words differ = (pcs ^ pc) & live;
+        dword split;
+        LANES_REDUCE(split, differ);
+        if (split == 0 && lanes->shared_memory
+            && !lanes->diverged[(pc & (CHIP8_MEMORY_SIZE - 1)) >> 1]
+            && !lanes->diverged[((pc + 1) & (CHIP8_MEMORY_SIZE - 1)) >> 1])
+        {
+            // 所有运行中的通道执行同一条指令
+            LANES_LOAD(opcodes, lanes->opcode);
+            opcodes ^= (opcodes ^ opcode) & live;
+            LANES_STORE(lanes->opcode, opcodes);
+            faulted |= lanes_execute(lanes, opcode, running, steps);
+            lanes->groups++;
+        }
+        else
+        {
+            // 取指，地址按 4 KB 绕回
+            LANES_FOR_EACH(l, running)
+            {
+                word lpc = lanes->pc[l];
+                lanes->opcode[l] = (word)(lanes->memory[l][lpc & (CHIP8_MEMORY_SIZE - 1)] << 8
+                                          | lanes->memory[l][(lpc + 1) & (CHIP8_MEMORY_SIZE - 1)]);
+            }
+            // 每次取剩余通道中最低的一条，与它操作码相同的通道组成一组
+            LANES_LOAD(opcodes, lanes->opcode);
+            dword remaining = running;
+            dword groups = 0;
+            while (remaining)
+            {
+                opcode = lanes->opcode[__builtin_ctz(remaining)];
+                lane_words hit = (lane_words)(opcodes == opcode) & bits;
+                dword group;
+                LANES_REDUCE(group, hit);
+                group &= remaining;
+                remaining &= ~group;
+                faulted |= lanes_execute(lanes, opcode, group, steps);
+                groups++;
+            }
+            lanes->groups += groups;
+            if (groups * 2 > (dword)__builtin_popcount(running))
+                scattered = spread < 4 ? spread + 1 : 4;
+        }
+        lanes->lane_cycles += (dword)__builtin_popcount(running);
+        if (!scattered)
+            spread = 0;
+
+        // 与 chip8_emulate_cycles 相同：故障后执行完所在帧段再停机
+        LANES_FOR_EACH(l, faulted & running)
+        {
+            if ((lanes->cycles[l] + steps + 1) % CHIP8_CYCLES_PER_FRAME == 0)
+            {
+                lanes->cycles[l] += steps + 1;
+                lanes->halted |= 1u << l;
+                running &= ~(1u << l);
+            }
+        }
+    }
+
+    LANES_FOR_EACH(l, running)
+    {
+        lanes->cycles[l] += steps;
+        // 到达 stop 时仍处于故障中的通道同样停机，之后延长 stop 也不再执行
+        if ((faulted >> l & 1) && lanes->cycles[l] >= lanes->stop[l])
+            lanes->halted |= 1u << l;
+    }
+    lanes->steps += steps;
+    return steps;
+}
+
+static dword lanes_run_default(CHIP8_LANES *lanes, dword cycles)
+{
+    return lanes_run_body(lanes, cycles);
+}
+
+#if CHIP8_LANES_X86
+// 与默认版本相同的代码以 AVX2 编译，字向量（pc、I、操作码）一条指令处理全部通道
+__attribute__((target("avx2")))
+static dword lanes_run_avx2(CHIP8_LANES *lanes, dword cycles)
+{
+    return lanes_run_body(lanes, cycles);
+}
+#endif
+
+// 生成译码表，按 CPU 能力选择内核，可用环境变量 CHIP8_LANES_KERNEL=sse2|avx2 强制指定
+static void lanes_select_kernel(void)
+{
+    const char *force = getenv("CHIP8_LANES_KERNEL");
+    for (dword opcode = 0; opcode < 0x10000; opcode++)
+        lanes_decode[opcode] = (byte)chip8_decode((word)opcode);
+#if CHIP8_LANES_X86
+    lanes_kernel = lanes_run_default;
+    lanes_kernel_name = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && !(force && strcmp(force, "sse2") == 0))
+    {
+        lanes_kernel = lanes_run_avx2;
+        lanes_kernel_name = "avx2";
+    }
+#else
+    (void)force;
+    lanes_kernel = lanes_run_default;
+    lanes_kernel_name = "generic";
+#endif
+}
+
+/**
+ * chip8_lanes_setup 初始化全部通道，前 count 条参与运行。
+ *
+ * 每条通道的状态与 chip8_setup 之后相同：pc 为 0x200、已加载字体、默认随机数种子；
+ * stop 为 UINT64_MAX，即一直执行到 chip8_lanes_run 的步数用完。
+ *
+ * @param lanes 调用者拥有的通道结构体
+ * @param count 参与运行的通道数，不超过 CHIP8_LANE_COUNT
+ */
+void chip8_lanes_setup(CHIP8_LANES *lanes, int count)
+{
+    memset(lanes, 0, sizeof(*lanes));
+    if (count > CHIP8_LANE_COUNT)
+        count = CHIP8_LANE_COUNT;
+    qword rng = chip8_seed_state(CHIP8_DEFAULT_SEED);
+    for (int l = 0; l < CHIP8_LANE_COUNT; l++)
+    {
+        lanes->pc[l] = CHIP8_MEMORY_START_ADDR;
+        lanes->stop[l] = UINT64_MAX;
+        lanes->rng[l] = rng;
+        memcpy(lanes->memory[l] + CHIP8_FONTSET_MEM_START_ADDR, chip8_fontset, CHIP8_FONTSET_SIZE);
+    }
+    lanes->active = count > 0 ? (dword)((1ULL << count) - 1) : 0;
+    lanes->shared_memory = 1;
+}
+
+/**
+ * chip8_lanes_load_buffer 把程序复制到每条通道的内存 0x200 处。
+ *
+ * @param lanes 通道
+ * @param data 程序数据
+ * @param size 程序大小，不能超过 CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR
+ * @return 成功返回 CHIP8_OK，程序过大返回 CHIP8_ERROR_ROM_TOO_LARGE
+ */
+int chip8_lanes_load_buffer(CHIP8_LANES *lanes, const byte *data, size_t size)
+{
+    if (size > CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR)
+        return CHIP8_ERROR_ROM_TOO_LARGE;
+    for (int l = 0; l < CHIP8_LANE_COUNT; l++)
+        memcpy(lanes->memory[l] + CHIP8_MEMORY_START_ADDR, data, size);
+    return CHIP8_OK;
+}
+
+void chip8_lanes_seed(CHIP8_LANES *lanes, int lane, qword seed)
+{
+    lanes->rng[lane] = chip8_seed_state(seed);
+}
+
+/**
+ * chip8_lanes_insert 把一个实例的完整状态放入一条通道，例如从快照恢复的实例。
+ *
+ * 兼容性选项所有通道共用，取这个实例的。实例已经故障时通道直接处于停机状态。
+ * 各通道的内存从此可能不同，之后每一步都逐通道取指。
+ *
+ * @param lanes 通道
+ * @param lane 通道号
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
+void chip8_lanes_insert(CHIP8_LANES *lanes, int lane, const CHIP8 *chip8)
+{
+    memcpy(lanes->memory[lane], chip8->memory, CHIP8_MEMORY_SIZE);
+    for (int r = 0; r < 16; r++)
+    {
+        lanes->registers[r][lane] = chip8->registers[r];
+        lanes->stack[r][lane] = chip8->stack[r];
+    }
+    lanes->index_register[lane] = chip8->index_register;
+    lanes->pc[lane] = chip8->pc;
+    lanes->opcode[lane] = chip8->opcode;
+    lanes->sp[lane] = chip8->sp;
+    lanes->delay_deadline[lane] = chip8->delay_deadline;
+    lanes->sound_deadline[lane] = chip8->sound_deadline;
+    memcpy(lanes->display[lane], chip8->display, sizeof(chip8->display));
+    memcpy(lanes->keys[lane], chip8->keys, CHIP8_KEY_SIZE);
+    lanes->display_dirty_rows[lane] = chip8->display_dirty_rows;
+    lanes->cycles[lane] = chip8->cycles;
+    lanes->rng[lane] = chip8->rng;
+    lanes->error[lane] = chip8->error;
+    lanes->quirks = chip8->quirks;
+    lanes->shared_memory = 0;
+    if (chip8->error != CHIP8_OK)
+        lanes->halted |= 1u << lane;
+    else
+        lanes->halted &= ~(1u << lane);
+}
+
+/**
+ * chip8_lanes_extract 把一条通道的状态写回实例，用于比较、显示或保存快照。
+ *
+ * 实例的引擎、空转检测等设置不变，内存被整体替换，译码缓存随之失效。
+ *
+ * @param lanes 通道
+ * @param lane 通道号
+ * @param chip8 指向已初始化的 CHIP8 结构体的指针
+ */
+void chip8_lanes_extract(const CHIP8_LANES *lanes, int lane, CHIP8 *chip8)
+{
+    memcpy(chip8->memory, lanes->memory[lane], CHIP8_MEMORY_SIZE);
+    for (int r = 0; r < 16; r++)
+    {
+        chip8->registers[r] = lanes->registers[r][lane];
+        chip8->stack[r] = lanes->stack[r][lane];
+    }
+    chip8->index_register = lanes->index_register[lane];
+    chip8->pc = lanes->pc[lane];
+    chip8->opcode = lanes->opcode[lane];
+    chip8->sp = lanes->sp[lane];
+    chip8->delay_deadline = lanes->delay_deadline[lane];
+    chip8->sound_deadline = lanes->sound_deadline[lane];
+    memcpy(chip8->display, lanes->display[lane], sizeof(chip8->display));
+    memcpy(chip8->keys, lanes->keys[lane], CHIP8_KEY_SIZE);
+    chip8->display_dirty_rows = lanes->display_dirty_rows[lane];
+    chip8->cycles = lanes->cycles[lane];
+    chip8->rng = lanes->rng[lane];
+    chip8->error = lanes->error[lane];
+    chip8->quirks = lanes->quirks;
+    chip8_invalidate_code(chip8, 0, CHIP8_MEMORY_SIZE);
+}
+
+/**
+ * chip8_lanes_run 锁步执行参与运行、未停机且未到达 stop 的通道。
+ *
+ * 执行 cycles 步、没有通道可以执行或者有通道到达 stop 时返回。到达 stop 的通道
+ * 在调用者应用它的输入事件并设置新的 stop（或从 active 中移除）之前不再执行，
+ * 其余通道不受影响，所以每条通道可以有各自的输入和指令预算。
+ *
+ * @param lanes 通道
+ * @param cycles 最多执行的步数
+ * @return 执行的步数，每条运行中的通道各执行同样多的指令（故障停机的除外）
+ */
+dword chip8_lanes_run(CHIP8_LANES *lanes, dword cycles)
+{
+    pthread_once(&lanes_once, lanes_select_kernel);
+    return lanes_kernel(lanes, cycles);
+}
+
+const char *chip8_lanes_backend(void)
+{
+    pthread_once(&lanes_once, lanes_select_kernel);
+    return lanes_kernel_name;
+}
+/// ****************************************************************************** ///
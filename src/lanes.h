@@ -0,0 +1,63 @@
+#ifndef __LANES_H__
+#define __LANES_H__
+#include "chip8.h"
+
+/// ******************************SIMD 锁步通道*********************************** ///
+// 同一 ROM 的 CHIP8_LANE_COUNT 个实例按结构数组（SoA）存放：V0-VF、pc、I、操作码、
+// 调用栈和定时器都是以通道为下标的向量，所有通道每一步各执行一条指令（锁步）。
+//
+// 每一步先为每条通道取指，执行同一操作码的通道组成一组，整组用向量指令执行
+// （算术、比较跳过、跳转、设置 I 等都是对整条向量的运算再按组掩码合并），
+// 访问各自内存或显示的指令在组内逐通道执行。控制流分叉后通道自然分成多组，
+// 操作码重新一致时又合并为一组，不需要显式的分裂/汇合栈。所有通道 pc 相同且这里的
+// 指令没有被任何通道改写过时只取一次指令；平均每组不到两条通道时逐通道执行到帧边界。
+// 向量内核以 GCC/Clang 向量扩展编写，x86-64 上运行时选择 AVX2 或 SSE2 版本。
+//
+// 每条通道的结果与对应实例关闭空转检测后 chip8_emulate_cycles(chip8, stop - cycles)
+// 逐位一致：执行到 stop 停止；发生故障后像 chip8_emulate_cycles 一样执行完所在帧段
+// （到帧边界或 stop）后停机，不再执行。不支持译码缓存、JIT、剖析和日志。
+#define CHIP8_LANE_COUNT 16          // 通道数，8 或 16
+
+typedef struct chip8_lanes
+{
+    // 每一步都访问的状态，registers[r][lane] 等为一条通道向量
+    byte registers[16][CHIP8_LANE_COUNT];
+    word pc[CHIP8_LANE_COUNT];
+    word index_register[CHIP8_LANE_COUNT];
+    word opcode[CHIP8_LANE_COUNT];
+    qword cycles[CHIP8_LANE_COUNT];  // 各通道已执行的指令数
+    qword stop[CHIP8_LANE_COUNT];    // 各通道执行到此周期为止，chip8_lanes_setup 设为 UINT64_MAX
+    dword active;                    // 参与运行的通道，调用者可以清除某位让通道退出
+    dword halted;                    // 故障后已停机的通道
+    byte quirks;                     // 兼容性选项（CHIP8_QUIRK_*），所有通道相同
+    byte shared_memory;              // 各通道内存除 diverged 标记的字外完全相同，insert 之后为 0
+    byte diverged[CHIP8_MEMORY_SIZE / 2]; // 有通道写过的字（偶地址对齐），各通道在此可能不同
+
+    // 只由逐通道执行的指令访问
+    word stack[16][CHIP8_LANE_COUNT];
+    byte sp[CHIP8_LANE_COUNT];
+    qword delay_deadline[CHIP8_LANE_COUNT];
+    qword sound_deadline[CHIP8_LANE_COUNT];
+    qword rng[CHIP8_LANE_COUNT];
+    enum chip8_error error[CHIP8_LANE_COUNT];
+    dword display_dirty_rows[CHIP8_LANE_COUNT];
+    byte keys[CHIP8_LANE_COUNT][CHIP8_KEY_SIZE];
+    qword display[CHIP8_LANE_COUNT][CHIP8_DISPLAY_HEIGHT];
+    byte memory[CHIP8_LANE_COUNT][CHIP8_MEMORY_SIZE];
+
+    // 统计
+    qword steps;                     // 锁步执行的步数
+    qword groups;                    // 各步的分组数之和，除以 steps 为平均分叉程度
+    qword lane_cycles;               // 所有通道执行的指令数之和
+} CHIP8_LANES;
+
+void chip8_lanes_setup(CHIP8_LANES *lanes, int count);  // 初始化前 count 条通道，状态与 chip8_setup 相同
+int chip8_lanes_load_buffer(CHIP8_LANES *lanes, const byte *data, size_t size); // 向所有通道加载程序
+void chip8_lanes_seed(CHIP8_LANES *lanes, int lane, qword seed);        // 设置一条通道的随机数种子
+void chip8_lanes_insert(CHIP8_LANES *lanes, int lane, const CHIP8 *chip8); // 把实例的状态放入一条通道
+void chip8_lanes_extract(const CHIP8_LANES *lanes, int lane, CHIP8 *chip8); // 把一条通道的状态写回实例
+dword chip8_lanes_run(CHIP8_LANES *lanes, dword cycles); // 锁步执行，有通道到达 stop 时返回
+const char *chip8_lanes_backend(void);                   // 当前使用的内核："avx2"、"sse2" 或 "generic"
+/// ****************************************************************************** ///
+
+#endif
@@ -1,16 +1,427 @@
 #include "chip8.h"
 #include "sdl.h"
+#include "audio.h"
+#include "snapshot.h"
+#include "input.h"
+#include "sched.h"
+#include "rom.h"
+#include "profile.h"
+#include "trace.h"
+#include "frames.h"
+#include <getopt.h>
+#include <pthread.h>
 
+// 窗口放大倍数
+#define CHIP8_DEFAULT_SCALE 10
+// 回退缓冲区：最多 10 分钟（60 帧/秒），4 MB，每秒一个关键帧
+#define CHIP8_REWIND_FRAMES (10 * 60 * 60)
+#define CHIP8_REWIND_BYTES (4 * 1024 * 1024)
+#define CHIP8_REWIND_KEYFRAME 60
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-s scale] [-p on,off] [-l] [-g] [-S seed] [-x speed] [-i index] [-r log | -R log] [-P profile] [-T trace] [-a samples] <rom> [scale]\n"
+                    "  -s scale   window scale factor (default %d)\n"
+                    "  -p on,off  palette as two RRGGBB colors, e.g. -p 33ff66,001100\n"
+                    "  -l         scanline effect\n"
+                    "  -g         pixel grid effect\n"
+                    "  -S seed    random seed (default: current time)\n"
+                    "  -x speed   speed multiplier, 0 = uncapped turbo (default 1)\n"
+                    "  -i index   ROM library index with per-ROM quirks and speed\n"
+                    "             (default $CHIP8_ROM_INDEX)\n"
+                    "  -r log     record keyboard input and seed to log\n"
+                    "  -R log     replay keyboard input and seed from log\n"
+                    "  -P file    write a profile report on exit (build with CHIP8_ENABLE_PROFILE)\n"
+                    "  -T file    write a Chrome trace of frame stages and print frame-time and input latency percentiles\n"
+                    "  -a samples audio callback buffer in samples, 0 = no sound (default %d)\n"
+                    "hold Backspace to rewind, hold Tab for turbo, F1/F2/F3 = 1x/2x/4x, F4 = turbo\n",
+            prog, CHIP8_DEFAULT_SCALE, CHIP8_AUDIO_SAMPLES);
+}
+
+// 模拟线程的状态。请求字段由主线程写、模拟线程读；其余字段只由模拟线程访问，
+// 主线程在创建线程之前设置、在线程结束之后读取
+static struct
+{
+    CHIP8 *chip8;
+    CHIP8_FRAMES frames;             // 完成的帧，模拟线程写、主线程读
+    CHIP8_INPUT_QUEUE queue;         // 按键事件，主线程写、模拟线程读
+    CHIP8_REWIND *rewind;
+    CHIP8_INPUT_LOG *log;            // 非 NULL 时录制
+    CHIP8_INPUT_REPLAY *replay;      // 非 NULL 时回放
+    CHIP8_SCHED sched;
+    CHIP8_TRACE *trace;              // 模拟线程的追踪轨道
+    CHIP8_HIST frame_hist;           // 模拟帧周期
+    CHIP8_HIST work_hist;            // 模拟帧中忙碌（非睡眠）的时间
+
+    _Atomic byte quit;               // 请求退出
+    _Atomic byte rewinding;          // 回退键按住
+    _Atomic byte turbo;              // 加速键按住
+    _Atomic int speed;               // 倍速，0 为不限速
+    _Atomic dword pauses;            // 累计的暂停/继续请求次数
+} emu;
+
+// 在当前周期边界应用排队的按键事件，并记下事件时刻用于测量输入延迟
+static void apply_input(CHIP8 *chip8)
+{
+    qword ts;
+    if (chip8_input_queue_apply(&emu.queue, chip8, &ts))
+        chip8_frames_input(&emu.frames, ts);
+}
+
+/**
+ * emulate_main 模拟线程：按调度器的节奏执行模拟帧，每个主机帧结束时发布有变化的画面。
+ *
+ * 计时只取决于单调时钟和调度器，与主线程的显示和垂直同步无关。
+ *
+ * @param arg 未使用
+ * @return NULL
+ */
+static void *emulate_main(void *arg)
+{
+    (void)arg;
+    CHIP8 *chip8 = emu.chip8;
+    CHIP8_TRACE *trace = emu.trace;
+    dword pauses = 0;
+    while (!atomic_load_explicit(&emu.quit, memory_order_acquire))
+    {
+        qword frame_begin = chip8_sched_now();
+        int speed = atomic_load_explicit(&emu.speed, memory_order_relaxed);
+        if (atomic_load_explicit(&emu.turbo, memory_order_relaxed) || speed <= 0)
+            chip8_sched_set_speed(&emu.sched, CHIP8_SPEED_TURBO, 0);
+        else
+            chip8_sched_set_speed(&emu.sched, speed == 1 ? CHIP8_SPEED_EXACT : CHIP8_SPEED_MULTI, (dword)speed);
+        dword requested = atomic_load_explicit(&emu.pauses, memory_order_relaxed);
+        if ((requested - pauses) & 1)
+            chip8->state = chip8->state == CHIP8_SYS_STATE_PAUSE ? CHIP8_SYS_STATE_RUNNING : CHIP8_SYS_STATE_PAUSE;
+        pauses = requested;
+        if (chip8->state != CHIP8_SYS_STATE_RUNNING && !emu.replay)
+            apply_input(chip8);
+
+        if (emu.rewind && atomic_load_explicit(&emu.rewinding, memory_order_relaxed))
+        {
+            chip8_rewind_pop(emu.rewind, chip8);
+            update_audio(chip8);
+            if (emu.log)
+                chip8_input_log_truncate(emu.log, chip8->cycles);
+        }
+        else if (chip8->state == CHIP8_SYS_STATE_RUNNING)
+        {
+            // 一个主机帧内连续执行调度器给出的模拟帧数，定时器随 cycles 自动前进
+            for (dword done = 0; chip8_sched_more(&emu.sched, done); done++)
+            {
+                if (emu.replay)
+                    chip8_input_replay_apply(emu.replay, chip8);
+                else
+                {
+                    apply_input(chip8);
+                    if (emu.log)
+                        chip8_input_record(emu.log, chip8);
+                }
+                qword begin = chip8_sched_now();
+                dword cycles = chip8_emulate_cycles(chip8, CHIP8_CYCLES_PER_FRAME);
+                qword emulated = chip8_sched_now();
+                chip8_trace_span_arg(trace, "emulate", begin, emulated, "cycles", cycles);
+                update_audio(chip8);
+                if (emu.rewind)
+                {
+                    chip8_rewind_push(emu.rewind, chip8);
+                    chip8_trace_span(trace, "rewind", emulated, chip8_sched_now());
+                }
+                // ROM 出错时暂停，可以回退到出错之前继续
+                if (chip8->error != CHIP8_OK)
+                {
+                    chip8->state = CHIP8_SYS_STATE_PAUSE;
+                    break;
+                }
+            }
+        }
+        if (chip8->display_dirty_rows)
+        {
+            chip8_frames_publish(&emu.frames, chip8, chip8_sched_now());
+            chip8->display_dirty_rows = 0;
+        }
+        qword work_end = chip8_sched_now();
+        chip8_sched_wait(&emu.sched);
+        qword frame_end = chip8_sched_now();
+        chip8_trace_span(trace, "wait", work_end, frame_end);
+        chip8_trace_span(trace, "frame", frame_begin, frame_end);
+        chip8_hist_add(&emu.work_hist, work_end - frame_begin);
+        chip8_hist_add(&emu.frame_hist, frame_end - frame_begin);
+    }
+    return NULL;
+}
+
+// 核心的日志输出到 stderr
+static void log_stderr(void *user, enum chip8_log_level level, const char *message)
+{
+    (void)user;
+    if (level >= CHIP8_LOG_WARN)
+        fprintf(stderr, "%s\n", message);
+}
 
 int main(int argc, char *argv[])
 {
+    int scale = CHIP8_DEFAULT_SCALE;
+    CHIP8_PALETTE palette = CHIP8_PALETTE_DEFAULT;
+    int effects = 0;
+    qword seed = (qword)time(NULL);
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    int speed = 1;
+    byte speed_set = 0;
+    const char *index_path = getenv("CHIP8_ROM_INDEX");
+    const char *profile_path = NULL;
+    const char *trace_path = NULL;
+    int audio_samples = CHIP8_AUDIO_SAMPLES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:p:lgS:x:i:r:R:P:T:a:h")) != -1)
+    {
+        switch (opt) {
+            case 's':
+                scale = atoi(optarg);
+                break;
+            case 'p':
+            {
+                unsigned on, off;
+                if (sscanf(optarg, "%x,%x", &on, &off) != 2)
+                {
+                    usage(argv[0]);
+                    return -1;
+                }
+                palette.on = 0xFF000000u | on;
+                palette.off = 0xFF000000u | off;
+                break;
+            }
+            case 'l':
+                effects |= CHIP8_SCALE_SCANLINES;
+                break;
+            case 'g':
+                effects |= CHIP8_SCALE_GRID;
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'x':
+                speed = atoi(optarg);
+                speed_set = 1;
+                break;
+            case 'i':
+                index_path = optarg;
+                break;
+            case 'r':
+                record_path = optarg;
+                break;
+            case 'R':
+                replay_path = optarg;
+                break;
+            case 'P':
+                profile_path = optarg;
+                break;
+            case 'T':
+                trace_path = optarg;
+                break;
+            case 'a':
+                audio_samples = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : -1;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+    if (optind + 1 < argc)
+        scale = atoi(argv[optind + 1]);
+    if (scale < 1)
+        scale = CHIP8_DEFAULT_SCALE;
+
+    // 回放时使用日志中的种子，录制时把种子写入日志
+    CHIP8_INPUT_LOG log;
+    CHIP8_INPUT_REPLAY replay;
+    chip8_input_log_init(&log, seed);
+    if (replay_path)
+    {
+        if (chip8_input_log_load(&log, replay_path) != 0)
+        {
+            fprintf(stderr, "cannot read input log %s\n", replay_path);
+            return -1;
+        }
+        chip8_input_replay_init(&replay, &log);
+    }
+
     CHIP8 *chip8 = chip8_init();
     if (!chip8)
         return -1;
+    chip8_set_log(chip8, log_stderr, NULL);
+    static CHIP8_PROFILE profile;
+    if (profile_path)
+        chip8_profile_attach(chip8, &profile);
+    chip8_seed(chip8, log.seed);
     printf("Chip-8 Emulator\n");
-    free(chip8);
-    return 0;
-}
+    CHIP8_ROM rom;
+    int error = chip8_rom_open(&rom, argv[optind]);
+    if (error != CHIP8_OK)
+    {
+        fprintf(stderr, "cannot load ROM file %s: %s\n", argv[optind], chip8_error_string((enum chip8_error)error));
+        chip8_free(chip8);
+        return -1;
+    }
+    qword hash = chip8_rom_hash(rom.data, rom.size);
+    printf("ROM %s: %zu bytes, hash %016llx\n", argv[optind], rom.size, (unsigned long long)hash);
+    chip8_load_buffer(chip8, rom.data, rom.size);
+    chip8_rom_close(&rom);
+
+    // ROM 库索引中的偏好设置，命令行的 -x 优先
+    CHIP8_ROM_INDEX index;
+    chip8_rom_index_init(&index);
+    if (index_path && chip8_rom_index_load(&index, index_path) == 0)
+    {
+        const CHIP8_ROM_INFO *info = chip8_rom_index_find(&index, hash);
+        if (info)
+        {
+            printf("ROM library: %s (quirks %02x, speed %u)\n", info->name, info->quirks, info->speed);
+            chip8->quirks = info->quirks;
+            if (!speed_set)
+                speed = (int)info->speed;
+        }
+    }
+    chip8_rom_index_free(&index);
+    if (init_display("Chip-8", scale, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT) != 0)
+    {
+        chip8_free(chip8);
+        return -1;
+    }
+    set_display_style(&palette, effects);
+    // 没有声音时照常运行
+    byte audio_open = audio_samples > 0 && init_audio(audio_samples) == 0;
+    emu.chip8 = chip8;
+    emu.rewind = chip8_rewind_create(CHIP8_REWIND_BYTES, CHIP8_REWIND_FRAMES, CHIP8_REWIND_KEYFRAME);
+    emu.log = record_path ? &log : NULL;
+    emu.replay = replay_path ? &replay : NULL;
+    chip8_sched_init(&emu.sched, CHIP8_SPEED_EXACT, 1);
+    atomic_store(&emu.speed, speed);
+
+    // 帧时序：trace 的主轨道记录输入和显示，另一条轨道记录模拟线程；
+    // 直方图统计模拟帧的周期和其中忙碌（非睡眠）的时间、实际显示的间隔，
+    // 以及从按键到显示出第一个响应画面的延迟
+    CHIP8_TRACE *trace = NULL;
+    if (trace_path && (trace = chip8_trace_open(trace_path, CHIP8_TRACE_EVENTS)) == NULL)
+        fprintf(stderr, "cannot write trace %s\n", trace_path);
+    set_display_trace(trace);
+    emu.trace = chip8_trace_track(trace, "emulation", CHIP8_TRACE_EVENTS);
+    CHIP8_HIST present_hist, latency_hist;
+    chip8_hist_init(&emu.frame_hist);
+    chip8_hist_init(&emu.work_hist);
+    chip8_hist_init(&present_hist);
+    chip8_hist_init(&latency_hist);
 
+    // 先发布初始画面，主线程总有一帧可以显示
+    chip8_frames_init(&emu.frames);
+    chip8_input_queue_init(&emu.queue);
+    // 回放时忽略键盘
+    set_input_queue(replay_path ? NULL : &emu.queue);
+    chip8_frames_publish(&emu.frames, chip8, chip8_sched_now());
+    chip8->display_dirty_rows = 0;
+    const CHIP8_FRAME *frame = chip8_frames_acquire(&emu.frames);
+    pthread_t thread;
+    byte started = pthread_create(&thread, NULL, emulate_main, NULL) == 0;
+    if (!started)
+        fprintf(stderr, "cannot start emulation thread\n");
 
+    // 主线程：处理输入，取最新帧显示。垂直同步下 present 会阻塞到下一次刷新，
+    // 没有新帧时等待事件，最多 1 ms 后再查看
+    qword last_present = 0;
+    qword last_input = 0;
+    while (started && !quit_requested())
+    {
+        qword begin = chip8_sched_now();
+        word keys = input_keys();
+        poll_input();
+        qword polled = chip8_sched_now();
+        chip8_trace_span(trace, "input", begin, polled);
+        word changed = keys ^ input_keys();
+        for (int k = 0; k < CHIP8_KEY_SIZE; k++)
+            if (changed & (1u << k))
+                chip8_trace_instant(trace, (input_keys() >> k) & 1 ? "key down" : "key up", polled, "key", (qword)k);
+        int hotkey = speed_hotkey();
+        if (hotkey)
+            atomic_store_explicit(&emu.speed, hotkey == 4 ? 0 : 1 << (hotkey - 1), memory_order_relaxed);
+        atomic_store_explicit(&emu.turbo, turbo_requested(), memory_order_relaxed);
+        atomic_store_explicit(&emu.rewinding, rewind_requested(), memory_order_relaxed);
+        atomic_fetch_add_explicit(&emu.pauses, (dword)pause_requested(), memory_order_relaxed);
 
+        const CHIP8_FRAME *next = chip8_frames_acquire(&emu.frames);
+        if (next)
+            frame = next;
+        qword present = chip8_sched_now();
+        if (present_display(frame->display, next ? next->dirty_rows : 0))
+        {
+            qword presented = chip8_sched_now();
+            chip8_trace_span_arg(trace, "display", present, presented, "frame", frame->sequence);
+            if (last_present)
+                chip8_hist_add(&present_hist, presented - last_present);
+            last_present = presented;
+            // 同一个按键时刻可能带在多个帧上，只在第一次显示时计入
+            if (next && frame->input && frame->input != last_input)
+            {
+                chip8_hist_add(&latency_hist, presented - frame->input);
+                chip8_trace_span(trace, "input to photon", frame->input, presented);
+                last_input = frame->input;
+            }
+        }
+        else
+            wait_input(1);
+    }
+    atomic_store_explicit(&emu.quit, 1, memory_order_release);
+    if (started)
+        pthread_join(thread, NULL);
+
+    if (audio_open)
+    {
+        CHIP8_AUDIO_STATS stats;
+        close_audio();
+        get_audio_stats(&stats);
+        if (stats.underruns || stats.dropped)
+            fprintf(stderr, "audio: %llu callbacks, %llu underruns, %llu dropped gate events, %llu resyncs\n",
+                    (unsigned long long)stats.callbacks, (unsigned long long)stats.underruns,
+                    (unsigned long long)stats.dropped, (unsigned long long)stats.resyncs);
+    }
+    close_display();
+    if (record_path && chip8_input_log_save(&log, record_path) != 0)
+        fprintf(stderr, "cannot write input log %s\n", record_path);
+    chip8_input_log_free(&log);
+    if (profile_path)
+    {
+        FILE *fp = fopen(profile_path, "w");
+        if (fp != NULL)
+        {
+            chip8_profile_report(chip8, argv[optind], fp);
+            fclose(fp);
+        }
+        else
+            fprintf(stderr, "cannot write profile %s\n", profile_path);
+    }
+    if (trace_path)
+    {
+        chip8_hist_print(&emu.frame_hist, "frame period", stderr);
+        chip8_hist_print(&emu.work_hist, "frame work", stderr);
+        chip8_hist_print(&present_hist, "present interval", stderr);
+        chip8_hist_print(&latency_hist, "input to photon", stderr);
+        fprintf(stderr, "input events dropped: %llu, without visible response: %llu\n",
+                (unsigned long long)atomic_load(&emu.queue.dropped),
+                (unsigned long long)emu.frames.input_timeouts);
+        fprintf(stderr, "late frames: %llu, resyncs: %llu, frames published: %llu, presented: %llu, skipped: %llu, "
+                        "trace events dropped: %llu\n",
+                (unsigned long long)emu.sched.late, (unsigned long long)emu.sched.resyncs,
+                (unsigned long long)emu.frames.sequence, (unsigned long long)emu.frames.acquired,
+                (unsigned long long)emu.frames.skipped, (unsigned long long)chip8_trace_dropped(trace));
+        chip8_trace_close(trace);
+    }
+    chip8_rewind_free(emu.rewind);
+    chip8_free(chip8);
+    return 0;
+}
@@ -1,9 +1,16 @@
 #include "chip8.h"
+#include "profile.h"
 
 // 清屏
 void opcode_00E0(CHIP8 *chip8)
 {
-    memset(chip8->display, CHIP8_DISPLAY_BLACK, sizeof(chip8->display));
+    // 只有原本非空的行才需要重新显示
+    for (byte y = 0; y < CHIP8_DISPLAY_HEIGHT; y++)
+    {
+        if (chip8->display[y])
+            chip8->display_dirty_rows |= 1u << y;
+        chip8->display[y] = 0;
+    }
 }
 
 // 子程序返回  调用栈中弹出返回地址
@@ -11,11 +18,8 @@ void opcode_00EE(CHIP8 *chip8)
 {
     if (chip8->sp > 0)
         chip8->pc = chip8->stack[--(chip8->sp)];
-    else 
-    {
-        printf("stack underflow\n");
-        exit(1);
-    }
+    else
+        chip8_fault(chip8, CHIP8_ERROR_STACK_UNDERFLOW);
 }
 
 // 无条件跳转
@@ -27,6 +31,11 @@ void opcode_1NNN(CHIP8 *chip8)
 // 调用子程序 压入调用栈中
 void opcode_2NNN(CHIP8 *chip8)
 {
+    if (chip8->sp >= sizeof(chip8->stack) / sizeof(chip8->stack[0]))
+    {
+        chip8_fault(chip8, CHIP8_ERROR_STACK_OVERFLOW);
+        return;
+    }
     chip8->stack[chip8->sp++] = chip8->pc;
     chip8->pc = NNN(_OPCODE);
 }
@@ -153,54 +162,45 @@ void opcode_BNNN(CHIP8 *chip8)
 // 用于生成随机数
 void opcode_CXNN(CHIP8 *chip8)
 {
-    VX(_OPCODE) = NN(_OPCODE) & (byte)(rand() % 256);
+    VX(_OPCODE) = NN(_OPCODE) & chip8_random(chip8);
 }
 
-// 绘制
+// 绘制：每个精灵行移位到目标位置后与帧缓冲行异或，按位与检测碰撞
 void opcode_DXYN(CHIP8 *chip8)
 {  
-    // 绘制
-    chip8->registers[0xF] = 0;
-
-    // 获取坐标
-    int x = X(_OPCODE);
-    int y = Y(_OPCODE);
-    int n = NN(_OPCODE); 
-    byte start_x = chip8->registers[x] & (CHIP8_DISPLAY_WIDTH - 1);
-    byte start_y = chip8->registers[y] & (CHIP8_DISPLAY_HEIGHT - 1);
+    // 获取坐标（先读取坐标再清 VF，X/Y 可能就是 VF）
+    byte start_x = VX(_OPCODE) & (CHIP8_DISPLAY_WIDTH - 1);
+    byte start_y = VY(_OPCODE) & (CHIP8_DISPLAY_HEIGHT - 1);
+    byte n = N(_OPCODE);
+    byte wrap = chip8->quirks & CHIP8_QUIRK_WRAP_SPRITES;
     word index = chip8->index_register;
+    qword collision = 0;
+    byte height = 0;
 
-    // 循环绘制
-    for (byte height = 0; height < n; height++)
+    for (; height < n; height++)
     {
-        for (byte width = 0; width < 8; width++)
+        byte y = start_y + height;
+        if (y >= CHIP8_DISPLAY_HEIGHT)
         {
-            // 获取当前像素值
-            byte pixel = chip8->memory[index] & (0x80 >> width);
-            // 获取当前位置的像素值
-            byte current_x = start_x + width;
-            byte current_y = start_y + height;
-
-            if(current_x >= CHIP8_DISPLAY_WIDTH || current_y >= CHIP8_DISPLAY_HEIGHT)
-                continue;
-            if(pixel)
-            {
-                if (chip8->display[current_y][current_x] == CHIP8_DISPLAY_WHITE)
-                {
-                   chip8->registers[0xF] = 1;
-                   chip8->display[current_y][current_x] = CHIP8_DISPLAY_BLACK;
-                }
-                else
-                {
-                    chip8->display[current_y][current_x] = CHIP8_DISPLAY_WHITE;
-                }
-                chip8->display_refresh_flags = 1;
-                
-            }
-            
+            if (!wrap)
+                break;
+            y -= CHIP8_DISPLAY_HEIGHT;
+        }
+        // 精灵字节放到最高 8 位，右移 start_x 位；裁剪时移出右边缘的位直接丢弃，
+        // 绕回时循环右移
+        qword sprite = (qword)chip8->memory[(index + height) & (CHIP8_MEMORY_SIZE - 1)] << 56;
+        qword line = sprite >> start_x;
+        if (wrap && start_x)
+            line |= sprite << (64 - start_x);
+        if (line)
+        {
+            collision |= chip8->display[y] & line;
+            chip8->display[y] ^= line;
+            chip8->display_dirty_rows |= 1u << y;
         }
-        index++;
     }
+    _VF = collision != 0;
+    CHIP8_PROFILE_DRAW(chip8, height);
 }
 
 // 用于按键检测--如果键被按下，则跳转
@@ -224,7 +224,7 @@ void opcode_EXA1(CHIP8 *chip8)
 // 获取当前时间
 void opcode_FX07(CHIP8 *chip8)
 {
-    VX(_OPCODE) = chip8->delay_timer;
+    VX(_OPCODE) = chip8_delay_timer(chip8);
 }
 
 // 等待按键按下
@@ -240,19 +240,22 @@ void opcode_FX0A(CHIP8 *chip8)
         }
     }
     if (!key_pressed)
+    {
         chip8->pc -= 2;
+        CHIP8_PROFILE_KEY_WAIT(chip8, 1);
+    }
 }
 
 // 设置延时定时器
 void opcode_FX15(CHIP8 *chip8)
 {
-    chip8->delay_timer = VX(_OPCODE);
+    chip8->delay_deadline = chip8_frame(chip8) + VX(_OPCODE);
 }
 
 // 设置声音定时器
 void opcode_FX18(CHIP8 *chip8)
 {
-    chip8->sound_timer = VX(_OPCODE);
+    chip8->sound_deadline = chip8_frame(chip8) + VX(_OPCODE);
 }
 
 // 延时定时器加1
@@ -274,22 +277,30 @@ void opcode_FX33(CHIP8 *chip8)
     byte one = x % 10;
     byte ten = x / 10u % 10u;
     byte hundred = x / 100u % 10u;
-    chip8->memory[_I] = one;
-    chip8->memory[_I + 1] = ten;
-    chip8->memory[_I + 2] = hundred;
+    chip8->memory[_I & (CHIP8_MEMORY_SIZE - 1)] = one;
+    chip8->memory[(_I + 1) & (CHIP8_MEMORY_SIZE - 1)] = ten;
+    chip8->memory[(_I + 2) & (CHIP8_MEMORY_SIZE - 1)] = hundred;
+    chip8_invalidate_code(chip8, _I, 3);
 }
 
-// 将V0到VX的值存储到内存I中
+// 将V0到VX的值存储到内存I中，地址按 4 KB 绕回
 void opcode_FX55(CHIP8 *chip8)
 {
     for (int i = 0; i <= X(_OPCODE); i++) {
-        chip8->memory[_I + i] = chip8->registers[i];
+        chip8->memory[(_I + i) & (CHIP8_MEMORY_SIZE - 1)] = chip8->registers[i];
     }
+    chip8_invalidate_code(chip8, _I, X(_OPCODE) + 1);
 }
 
 // 从内存I中加载值到寄存器V0到VX中
 void opcode_FX65(CHIP8 *chip8)
 {
     for(int i = 0; i <= X(_OPCODE); i++)
-        chip8->registers[i] = chip8->memory[_I + i];
+        chip8->registers[i] = chip8->memory[(_I + i) & (CHIP8_MEMORY_SIZE - 1)];
+}
+
+// 未知操作码
+void opcode_unknown(CHIP8 *chip8)
+{
+    chip8_log(chip8, CHIP8_LOG_WARN, "unknown opcode 0x%04X at pc 0x%03X", _OPCODE, (word)(chip8->pc - 2));
 }
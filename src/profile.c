@@ -0,0 +1,102 @@
+#include "profile.h"
+
+/// ********************************执行剖析************************************ ///
+#define CHIP8_PROFILE_OP_NAME(N) #N,
+static const char *chip8_profile_op_names[CHIP8_OP_COUNT] = { CHIP8_OPCODE_LIST(CHIP8_PROFILE_OP_NAME) };
+#undef CHIP8_PROFILE_OP_NAME
+#define CHIP8_PROFILE_FUSION_NAME(N) #N,
+static const char *chip8_profile_fusion_names[CHIP8_FUSION_COUNT] = { "none", CHIP8_FUSION_LIST(CHIP8_PROFILE_FUSION_NAME) };
+#undef CHIP8_PROFILE_FUSION_NAME
+
+/**
+ * chip8_profile_attach 清零计数器并挂到实例上，之后该实例执行的指令都会被统计。
+ *
+ * 计数器的内存由调用者提供，不分配内存；未以 CHIP8_ENABLE_PROFILE=1 构建时计数器保持为 0。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param profile 计数器，NULL 表示停止统计
+ */
+void chip8_profile_attach(CHIP8 *chip8, CHIP8_PROFILE *profile)
+{
+    if (profile != NULL)
+    {
+        memset(profile, 0, sizeof(*profile));
+        profile->sample_countdown = CHIP8_PROFILE_SAMPLE_PERIOD;
+    }
+    chip8->profile = profile;
+}
+
+/**
+ * chip8_profile_hot 找出采样次数最多的 pc，按次数降序排列。
+ *
+ * @param profile 计数器
+ * @param hot 输出数组，至少 count 项
+ * @param count 最多输出的项数
+ * @return 实际输出的项数（被采样到的地址可能少于 count 个）
+ */
+dword chip8_profile_hot(const CHIP8_PROFILE *profile, CHIP8_PROFILE_HOT *hot, dword count)
+{
+    dword n = 0;
+    for (dword pc = 0; pc < CHIP8_MEMORY_SIZE; pc++)
+    {
+        dword samples = profile->pc_samples[pc];
+        if (samples == 0 || (n == count && samples <= hot[n - 1].samples))
+            continue;
+        // 插入排序：count 很小，地址只扫描一遍
+        dword i = n < count ? n++ : n - 1;
+        while (i > 0 && hot[i - 1].samples < samples)
+        {
+            hot[i] = hot[i - 1];
+            i--;
+        }
+        hot[i].pc = (word)pc;
+        hot[i].samples = samples;
+    }
+    return n;
+}
+
+/**
+ * chip8_profile_report 以一行 JSON 输出实例的剖析报告：指令总数、操作码直方图、
+ * 绘制和等待按键的统计以及热点 pc（附带该地址当前的操作码）。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针，没有挂计数器时不输出
+ * @param name 报告名称（如 ROM 路径）
+ * @param fp 输出文件
+ */
+void chip8_profile_report(const CHIP8 *chip8, const char *name, FILE *fp)
+{
+    const CHIP8_PROFILE *profile = chip8->profile;
+    if (profile == NULL)
+        return;
+
+    fprintf(fp, "{\"name\": \"");
+    for (const char *p = name; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fputc('\\', fp);
+        fputc(*p, fp);
+    }
+    fprintf(fp, "\", \"enabled\": %d, \"cycles\": %llu, \"skipped\": %llu, \"fused\": %llu, \"ops\": {",
+            CHIP8_ENABLE_PROFILE, (unsigned long long)chip8->cycles, (unsigned long long)chip8->skipped_cycles,
+            (unsigned long long)chip8->fused_cycles);
+    for (int op = 0; op < CHIP8_OP_COUNT; op++)
+        fprintf(fp, "%s\"%s\": %llu", op ? ", " : "", chip8_profile_op_names[op], (unsigned long long)profile->ops[op]);
+    fprintf(fp, "}, \"draws\": %llu, \"draw_rows\": %llu, \"key_wait_cycles\": %llu, \"fusions\": {",
+            (unsigned long long)profile->draws, (unsigned long long)profile->draw_rows,
+            (unsigned long long)profile->key_wait_cycles);
+    for (int f = 0; f < CHIP8_FUSION_COUNT; f++)
+        fprintf(fp, "%s\"%s\": %llu", f ? ", " : "", chip8_profile_fusion_names[f], (unsigned long long)profile->fusions[f]);
+    fprintf(fp, "}, \"hot\": [");
+
+    CHIP8_PROFILE_HOT hot[CHIP8_PROFILE_HOT_PCS];
+    dword count = chip8_profile_hot(profile, hot, CHIP8_PROFILE_HOT_PCS);
+    for (dword i = 0; i < count; i++)
+    {
+        word pc = hot[i].pc;
+        word opcode = (word)((chip8->memory[pc] << 8) | chip8->memory[(pc + 1) & (CHIP8_MEMORY_SIZE - 1)]);
+        fprintf(fp, "%s{\"pc\": \"0x%03X\", \"opcode\": \"0x%04X\", \"samples\": %u}",
+                i ? ", " : "", pc, opcode, hot[i].samples);
+    }
+    fprintf(fp, "]}\n");
+}
+/// ****************************************************************************** ///
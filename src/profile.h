@@ -0,0 +1,82 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+#include "chip8.h"
+
+/// ********************************执行剖析************************************ ///
+// 编译期开关：构建时定义 CHIP8_ENABLE_PROFILE=1（CMake 选项 -DCHIP8_ENABLE_PROFILE=ON）才会在分派循环、
+// DXYN 和 FX0A 中插入计数，默认关闭时所有钩子展开为空，热路径上没有任何代价。
+// 打开后仍然只统计通过 chip8_profile_attach 挂上计数器的实例：
+//   ops            ：每类操作码（enum chip8_op）实际执行的次数，不含空转检测跳过的指令
+//   pc_samples     ：每 CHIP8_PROFILE_SAMPLE_PERIOD 条指令对当前 pc 采样一次
+//   draws/draw_rows：DXYN 次数，以及其中实际落在屏幕上的精灵行数
+//   key_wait_cycles：FX0A 等待按键空转的指令数（包括被空转检测跳过的）
+//   fusions        ：CACHE 引擎每种超级指令（enum chip8_fusion）的执行次数，[0] 为未融合的分派次数
+// JIT 和 AOT 的本地代码无法逐条计数，剖析构建中这两个引擎按 CACHE 引擎执行。
+// 计数器由调用者提供，运行中可以随时直接读取（实时查询），运行结束后用
+// chip8_profile_report 输出报告。
+#ifndef CHIP8_ENABLE_PROFILE
+#define CHIP8_ENABLE_PROFILE 0
+#endif
+
+// pc 采样间隔，取质数以免与循环长度同步而总是采到同一条指令
+#define CHIP8_PROFILE_SAMPLE_PERIOD 61
+// 报告中列出的热点 pc 数
+#define CHIP8_PROFILE_HOT_PCS 16
+
+typedef struct chip8_profile
+{
+    qword ops[CHIP8_OP_COUNT];       // 每类操作码的执行次数
+    dword pc_samples[CHIP8_MEMORY_SIZE]; // 每个地址被采样到的次数
+    dword sample_countdown;          // 距下一次采样的指令数
+    qword draws;                     // DXYN 执行次数
+    qword draw_rows;                 // DXYN 实际绘制的精灵行数
+    qword key_wait_cycles;           // FX0A 等待按键的指令数
+    qword fusions[CHIP8_FUSION_COUNT]; // 每种超级指令的执行次数
+} CHIP8_PROFILE;
+
+// 热点 pc
+typedef struct chip8_profile_hot
+{
+    word pc;
+    dword samples;
+} CHIP8_PROFILE_HOT;
+
+void chip8_profile_attach(CHIP8 *chip8, CHIP8_PROFILE *profile); // 清零计数器并挂到实例上，NULL 为取下
+dword chip8_profile_hot(const CHIP8_PROFILE *profile, CHIP8_PROFILE_HOT *hot, dword count); // 采样最多的 count 个 pc
+void chip8_profile_report(const CHIP8 *chip8, const char *name, FILE *fp); // 以一行 JSON 输出报告
+/// ****************************************************************************** ///
+
+
+/// ********************************剖析钩子************************************ ///
+#if CHIP8_ENABLE_PROFILE
+static inline void chip8_profile_insn(CHIP8_PROFILE *profile, word pc, byte op)
+{
+    profile->ops[op]++;
+    if (--profile->sample_countdown == 0)
+    {
+        profile->sample_countdown = CHIP8_PROFILE_SAMPLE_PERIOD;
+        profile->pc_samples[pc & (CHIP8_MEMORY_SIZE - 1)]++;
+    }
+}
+
+// 执行一条指令：pc 为指令地址，op 为 enum chip8_op
+#define CHIP8_PROFILE_INSN(chip8, pc, op) \
+    do { if ((chip8)->profile) chip8_profile_insn((chip8)->profile, (word)(pc), (byte)(op)); } while (0)
+// DXYN 绘制了 rows 个精灵行
+#define CHIP8_PROFILE_DRAW(chip8, rows) \
+    do { if ((chip8)->profile) { (chip8)->profile->draws++; (chip8)->profile->draw_rows += (rows); } } while (0)
+// FX0A 空转等待了 cycles 条指令
+#define CHIP8_PROFILE_KEY_WAIT(chip8, cycles) \
+    do { if ((chip8)->profile) (chip8)->profile->key_wait_cycles += (cycles); } while (0)
+// CACHE 引擎分派了一次 fusion 种类的超级指令（enum chip8_fusion）
+#define CHIP8_PROFILE_FUSION(chip8, fusion) \
+    do { if ((chip8)->profile) (chip8)->profile->fusions[(fusion)]++; } while (0)
+#else
+#define CHIP8_PROFILE_INSN(chip8, pc, op) ((void)0)
+#define CHIP8_PROFILE_DRAW(chip8, rows) ((void)0)
+#define CHIP8_PROFILE_KEY_WAIT(chip8, cycles) ((void)0)
+#define CHIP8_PROFILE_FUSION(chip8, fusion) ((void)0)
+#endif
+/// ****************************************************************************** ///
+
+#endif
@@ -0,0 +1,179 @@
+#include "rom.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// ********************************ROM 文件************************************ ///
+/**
+ * chip8_rom_open 以只读方式映射 ROM 文件。
+ *
+ * @param rom 输出的 ROM 映射
+ * @param path 文件路径
+ * @return 成功返回 CHIP8_OK，文件无法打开、不是普通文件或无法映射返回 CHIP8_ERROR_ROM_OPEN，
+ *         超过 CHIP8_ROM_MAX_SIZE 返回 CHIP8_ERROR_ROM_TOO_LARGE
+ */
+int chip8_rom_open(CHIP8_ROM *rom, const char *path)
+{
+    rom->data = NULL;
+    rom->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return CHIP8_ERROR_ROM_OPEN;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return CHIP8_ERROR_ROM_OPEN;
+    }
+    if (st.st_size > CHIP8_ROM_MAX_SIZE)
+    {
+        close(fd);
+        return CHIP8_ERROR_ROM_TOO_LARGE;
+    }
+    if (st.st_size > 0)
+    {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return CHIP8_ERROR_ROM_OPEN;
+        }
+        rom->data = (const byte *)data;
+        rom->size = (size_t)st.st_size;
+    }
+    // 映射建立后文件描述符不再需要
+    close(fd);
+    return CHIP8_OK;
+}
+
+void chip8_rom_close(CHIP8_ROM *rom)
+{
+    if (rom->data != NULL)
+        munmap((void *)rom->data, rom->size);
+    rom->data = NULL;
+    rom->size = 0;
+}
+
+qword chip8_rom_hash(const byte *data, size_t size)
+{
+    qword hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+/// ****************************************************************************** ///
+
+
+/// *********************************ROM 库索引********************************** ///
+void chip8_rom_index_init(CHIP8_ROM_INDEX *index)
+{
+    memset(index, 0, sizeof(*index));
+}
+
+void chip8_rom_index_free(CHIP8_ROM_INDEX *index)
+{
+    free(index->entries);
+    chip8_rom_index_init(index);
+}
+
+// 第一个 hash 不小于给定值的位置
+static size_t chip8_rom_index_lower_bound(const CHIP8_ROM_INDEX *index, qword hash)
+{
+    size_t lo = 0, hi = index->count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+const CHIP8_ROM_INFO *chip8_rom_index_find(const CHIP8_ROM_INDEX *index, qword hash)
+{
+    size_t i = chip8_rom_index_lower_bound(index, hash);
+    if (i < index->count && index->entries[i].hash == hash)
+        return &index->entries[i];
+    return NULL;
+}
+
+/**
+ * chip8_rom_index_put 添加一项，同一哈希已存在时替换。
+ *
+ * @param index ROM 库索引
+ * @param info 要添加的项
+ * @return 成功返回 0，内存不足返回 -1
+ */
+int chip8_rom_index_put(CHIP8_ROM_INDEX *index, const CHIP8_ROM_INFO *info)
+{
+    size_t i = chip8_rom_index_lower_bound(index, info->hash);
+    if (i < index->count && index->entries[i].hash == info->hash)
+    {
+        index->entries[i] = *info;
+        return 0;
+    }
+    if (index->count == index->capacity)
+    {
+        size_t capacity = index->capacity ? index->capacity * 2 : 64;
+        CHIP8_ROM_INFO *entries = (CHIP8_ROM_INFO *)realloc(index->entries, capacity * sizeof(CHIP8_ROM_INFO));
+        if (entries == NULL)
+            return -1;
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    memmove(&index->entries[i + 1], &index->entries[i], (index->count - i) * sizeof(CHIP8_ROM_INFO));
+    index->entries[i] = *info;
+    index->count++;
+    return 0;
+}
+
+/**
+ * chip8_rom_index_load 读取索引文件并合并到 index 中，格式错误的行被忽略。
+ *
+ * @param index 已初始化的 ROM 库索引
+ * @param path 索引文件路径
+ * @return 成功返回 0，文件无法打开或内存不足返回 -1
+ */
+int chip8_rom_index_load(CHIP8_ROM_INDEX *index, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    char line[256];
+    int error = 0;
+    while (!error && fgets(line, sizeof(line), fp))
+    {
+        unsigned long long hash;
+        unsigned quirks, speed;
+        int name_at = 0;
+        if (line[0] == '#' || sscanf(line, "%llx %x %u %n", &hash, &quirks, &speed, &name_at) != 3)
+            continue;
+        CHIP8_ROM_INFO info = { (qword)hash, (byte)quirks, speed, "" };
+        snprintf(info.name, sizeof(info.name), "%s", line + name_at);
+        info.name[strcspn(info.name, "\r\n")] = '\0';
+        error = chip8_rom_index_put(index, &info) != 0;
+    }
+    fclose(fp);
+    return error ? -1 : 0;
+}
+
+int chip8_rom_index_save(const CHIP8_ROM_INDEX *index, const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+    fprintf(fp, "# hash quirks speed name\n");
+    for (size_t i = 0; i < index->count; i++)
+    {
+        const CHIP8_ROM_INFO *info = &index->entries[i];
+        fprintf(fp, "%016llx %02x %u %s\n", (unsigned long long)info->hash, info->quirks, info->speed, info->name);
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
+/// ****************************************************************************** ///
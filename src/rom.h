@@ -0,0 +1,53 @@
+#ifndef __ROM_H__
+#define __ROM_H__
+#include "chip8.h"
+
+/// ********************************ROM 文件************************************ ///
+// ROM 以只读方式 mmap 映射，不复制、不解析；同一个映射可以被任意多个实例
+// 通过 chip8_load_buffer 并发加载。空文件不映射，data 为 NULL、size 为 0。
+#define CHIP8_ROM_MAX_SIZE (CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START_ADDR)
+
+typedef struct chip8_rom
+{
+    const byte *data;                // 映射的文件内容
+    size_t size;                     // 文件大小（字节）
+} CHIP8_ROM;
+
+int chip8_rom_open(CHIP8_ROM *rom, const char *path);   // 映射 ROM，失败返回 CHIP8_ERROR_ROM_OPEN 或 CHIP8_ERROR_ROM_TOO_LARGE
+void chip8_rom_close(CHIP8_ROM *rom);                   // 解除映射
+qword chip8_rom_hash(const byte *data, size_t size);    // ROM 内容的 FNV-1a 64 位哈希
+/// ****************************************************************************** ///
+
+
+/// *********************************ROM 库索引********************************** ///
+// 以 ROM 内容哈希为键保存每个 ROM 的偏好设置，与文件名和路径无关，
+// 改名或复制到别处的 ROM 仍能找到。磁盘上是文本文件，可以直接编辑：
+//   # 注释
+//   <16 位十六进制哈希> <quirks 十六进制> <倍速，0 为不限速> <名称，可含空格>
+// 载入后按哈希排序，查找为二分查找。
+#define CHIP8_ROM_NAME_MAX 64
+
+typedef struct chip8_rom_info
+{
+    qword hash;                      // chip8_rom_hash 的结果
+    byte quirks;                     // 偏好的兼容性选项（CHIP8_QUIRK_*）
+    dword speed;                     // 偏好的倍速（sched.h），0 为不限速
+    char name[CHIP8_ROM_NAME_MAX];   // 显示名称
+} CHIP8_ROM_INFO;
+
+typedef struct chip8_rom_index
+{
+    CHIP8_ROM_INFO *entries;         // 按 hash 升序排列
+    size_t count;
+    size_t capacity;
+} CHIP8_ROM_INDEX;
+
+void chip8_rom_index_init(CHIP8_ROM_INDEX *index);
+void chip8_rom_index_free(CHIP8_ROM_INDEX *index);
+int chip8_rom_index_load(CHIP8_ROM_INDEX *index, const char *path);     // 读取索引文件，失败返回 -1
+int chip8_rom_index_save(const CHIP8_ROM_INDEX *index, const char *path); // 写入索引文件，失败返回 -1
+const CHIP8_ROM_INFO *chip8_rom_index_find(const CHIP8_ROM_INDEX *index, qword hash); // 没有时返回 NULL
+int chip8_rom_index_put(CHIP8_ROM_INDEX *index, const CHIP8_ROM_INFO *info); // 添加或替换，内存不足返回 -1
+/// ****************************************************************************** ///
+
+#endif
@@ -0,0 +1,193 @@
+#include "scale.h"
+#include <pthread.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CHIP8_SCALE_X86 1
+#include <immintrin.h>
+#else
+#define CHIP8_SCALE_X86 0
+#endif
+
+// 一组内核：展开一行 64 像素、水平放大、整行变暗
+struct scale_kernel
+{
+    void (*expand)(qword row, dword on, dword off, dword *out);
+    void (*stretch)(const dword *src, int scale, dword *line);
+    void (*darken)(const dword *src, dword *dst, int count);
+    const char *name;
+};
+
+static struct scale_kernel kernel;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+// 颜色变暗：RGB 各通道减半，保留 alpha
+static inline dword darken_color(dword color)
+{
+    return (color & 0xFF000000u) | ((color >> 1) & 0x007F7F7Fu);
+}
+
+/// *********************************标量实现************************************* ///
+static void expand_scalar(qword row, dword on, dword off, dword *out)
+{
+    for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x++)
+        out[x] = (row & CHIP8_DISPLAY_ROW_BIT(x)) ? on : off;
+}
+
+static void stretch_scalar(const dword *src, int scale, dword *line)
+{
+    for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x++)
+        for (int i = 0; i < scale; i++)
+            *line++ = src[x];
+}
+
+static void darken_scalar(const dword *src, dword *dst, int count)
+{
+    for (int i = 0; i < count; i++)
+        dst[i] = darken_color(src[i]);
+}
+/// ****************************************************************************** ///
+
+#if CHIP8_SCALE_X86
+/// *********************************SSE2 实现************************************* ///
+// 每次展开 4 个像素：广播对应的 4 位，与 {8,4,2,1} 比较得到掩码，再在两种颜色间选择
+static void expand_sse2(qword row, dword on, dword off, dword *out)
+{
+    const __m128i bits = _mm_set_epi32(1, 2, 4, 8);
+    const __m128i voff = _mm_set1_epi32((int)off);
+    const __m128i vdiff = _mm_set1_epi32((int)(on ^ off));
+    for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x += 4)
+    {
+        __m128i nibble = _mm_set1_epi32((int)((row >> (60 - x)) & 0xF));
+        __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(nibble, bits), bits);
+        _mm_storeu_si128((__m128i *)(out + x), _mm_xor_si128(voff, _mm_and_si128(mask, vdiff)));
+    }
+}
+
+// 每个源像素用 4 宽的广播写入 scale 个输出像素。除最后一个像素外允许写过界，
+// 多写的部分随后会被下一个像素覆盖，因此不需要处理尾部
+static void stretch_sse2(const dword *src, int scale, dword *line)
+{
+    for (int x = 0; x < CHIP8_DISPLAY_WIDTH - 1; x++)
+    {
+        __m128i color = _mm_set1_epi32((int)src[x]);
+        for (int i = 0; i < scale; i += 4)
+            _mm_storeu_si128((__m128i *)(line + i), color);
+        line += scale;
+    }
+    for (int i = 0; i < scale; i++)
+        line[i] = src[CHIP8_DISPLAY_WIDTH - 1];
+}
+
+// 输出行长度为 64 * scale，总是 4 的倍数
+static void darken_sse2(const dword *src, dword *dst, int count)
+{
+    const __m128i rgb = _mm_set1_epi32(0x007F7F7F);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+    for (int i = 0; i < count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        v = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 1), rgb), _mm_and_si128(v, alpha));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+}
+/// ****************************************************************************** ///
+
+/// *********************************AVX2 实现************************************* ///
+// 与 SSE2 相同的做法，每次处理 8 个像素
+__attribute__((target("avx2")))
+static void expand_avx2(qword row, dword on, dword off, dword *out)
+{
+    const __m256i bits = _mm256_set_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i voff = _mm256_set1_epi32((int)off);
+    const __m256i vdiff = _mm256_set1_epi32((int)(on ^ off));
+    for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x += 8)
+    {
+        __m256i octet = _mm256_set1_epi32((int)((row >> (56 - x)) & 0xFF));
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(octet, bits), bits);
+        _mm256_storeu_si256((__m256i *)(out + x), _mm256_xor_si256(voff, _mm256_and_si256(mask, vdiff)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void stretch_avx2(const dword *src, int scale, dword *line)
+{
+    for (int x = 0; x < CHIP8_DISPLAY_WIDTH - 1; x++)
+    {
+        __m256i color = _mm256_set1_epi32((int)src[x]);
+        for (int i = 0; i < scale; i += 8)
+            _mm256_storeu_si256((__m256i *)(line + i), color);
+        line += scale;
+    }
+    for (int i = 0; i < scale; i++)
+        line[i] = src[CHIP8_DISPLAY_WIDTH - 1];
+}
+
+// 输出行长度为 64 * scale，总是 8 的倍数
+__attribute__((target("avx2")))
+static void darken_avx2(const dword *src, dword *dst, int count)
+{
+    const __m256i rgb = _mm256_set1_epi32(0x007F7F7F);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+    for (int i = 0; i < count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        v = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 1), rgb), _mm256_and_si256(v, alpha));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+}
+/// ****************************************************************************** ///
+#endif
+
+// 按 CPU 能力选择内核，可用环境变量 CHIP8_SCALE_KERNEL=scalar|sse2|avx2 强制指定
+static void select_kernel(void)
+{
+    const char *force = getenv("CHIP8_SCALE_KERNEL");
+    kernel = (struct scale_kernel){ expand_scalar, stretch_scalar, darken_scalar, "scalar" };
+#if CHIP8_SCALE_X86
+    if (force && strcmp(force, "scalar") == 0)
+        return;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && !(force && strcmp(force, "sse2") == 0))
+        kernel = (struct scale_kernel){ expand_avx2, stretch_avx2, darken_avx2, "avx2" };
+    else
+        kernel = (struct scale_kernel){ expand_sse2, stretch_sse2, darken_sse2, "sse2" };
+#else
+    (void)force;
+#endif
+}
+
+void chip8_scale_rows(const qword *rows, int first, int last, int scale,
+                      const CHIP8_PALETTE *palette, int effects, void *out, int pitch)
+{
+    pthread_once(&kernel_once, select_kernel);
+
+    int width = CHIP8_DISPLAY_WIDTH * scale;
+    byte scanlines = (effects & CHIP8_SCALE_SCANLINES) && scale > 1;
+    byte grid = (effects & CHIP8_SCALE_GRID) && scale > 1;
+    dword expanded[CHIP8_DISPLAY_WIDTH];
+    byte *dst = (byte *)out;
+
+    for (int y = first; y <= last; y++)
+    {
+        dword *line = (dword *)dst;
+        kernel.expand(rows[y], palette->on, palette->off, expanded);
+        kernel.stretch(expanded, scale, line);
+        if (grid)
+        {
+            for (int x = scale - 1; x < width; x += scale)
+                line[x] = darken_color(line[x]);
+        }
+        // 同一源行的其余扫描线直接复制，启用扫描线效果时最后一条变暗
+        for (int i = 1; i < scale - scanlines; i++)
+            memcpy(dst + i * pitch, line, width * sizeof(dword));
+        if (scanlines)
+            kernel.darken(line, (dword *)(dst + (scale - 1) * pitch), width);
+        dst += scale * pitch;
+    }
+}
+
+const char *chip8_scale_backend(void)
+{
+    pthread_once(&kernel_once, select_kernel);
+    return kernel.name;
+}
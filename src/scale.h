@@ -0,0 +1,41 @@
+#ifndef __SCALE_H__
+#define __SCALE_H__
+#include "chip8.h"
+
+/// ******************************显示缩放与调色板********************************* ///
+// 把 1bpp 帧缓冲行展开为按整数倍放大的 ARGB 像素，供窗口显示和缩略图使用。
+// 内核在运行时按 CPU 能力选择 AVX2 / SSE2 / 标量实现，结果逐像素一致。
+
+// 双色调色板
+typedef struct chip8_palette
+{
+    dword on;                        // 点亮像素颜色
+    dword off;                       // 熄灭像素颜色
+} CHIP8_PALETTE;
+
+// 显示效果（可组合）
+#define CHIP8_SCALE_SCANLINES 0x01   // 每个放大像素的最后一条扫描线变暗
+#define CHIP8_SCALE_GRID      0x02   // 每个放大像素的最后一列变暗，形成像素网格
+
+// 默认调色板：白色前景、黑色背景
+#define CHIP8_PALETTE_DEFAULT { CHIP8_DISPLAY_WHITE, CHIP8_DISPLAY_BLACK }
+
+/**
+ * 把帧缓冲的 [first, last] 行展开为放大 scale 倍的 ARGB 像素。
+ *
+ * @param rows 1bpp 帧缓冲（CHIP8::display）
+ * @param first 起始行
+ * @param last 结束行（包含）
+ * @param scale 放大倍数
+ * @param palette 调色板
+ * @param effects 显示效果（CHIP8_SCALE_*）
+ * @param out 输出的第一个像素，对应第 first 行的左上角
+ * @param pitch 输出每行的字节数，至少为 CHIP8_DISPLAY_WIDTH * scale * 4
+ */
+void chip8_scale_rows(const qword *rows, int first, int last, int scale,
+                      const CHIP8_PALETTE *palette, int effects, void *out, int pitch);
+
+const char *chip8_scale_backend(void);  // 当前使用的内核："avx2"、"sse2" 或 "scalar"
+/// ****************************************************************************** ///
+
+#endif
@@ -0,0 +1,89 @@
+#include "sched.h"
+#include <errno.h>
+
+/// ********************************帧调度器************************************ ///
+qword chip8_sched_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qword)ts.tv_sec * 1000000000ULL + (qword)ts.tv_nsec;
+}
+
+/**
+ * chip8_sched_init 初始化调度器，第一帧的截止时间为当前时间加一帧。
+ *
+ * @param sched 调度器
+ * @param mode 速度模式
+ * @param multiplier MULTI 模式下每个主机帧的模拟帧数，其他模式忽略
+ */
+void chip8_sched_init(CHIP8_SCHED *sched, enum chip8_speed mode, dword multiplier)
+{
+    memset(sched, 0, sizeof(*sched));
+    chip8_sched_set_speed(sched, mode, multiplier);
+    sched->deadline = chip8_sched_now() + CHIP8_FRAME_NS;
+}
+
+void chip8_sched_set_speed(CHIP8_SCHED *sched, enum chip8_speed mode, dword multiplier)
+{
+    sched->mode = mode;
+    sched->multiplier = multiplier ? multiplier : 1;
+}
+
+/**
+ * chip8_sched_more 判断本主机帧内是否还要再执行一个模拟帧。
+ *
+ * @param sched 调度器
+ * @param done 本主机帧内已执行的模拟帧数
+ * @return 需要继续返回 1，否则返回 0
+ */
+byte chip8_sched_more(const CHIP8_SCHED *sched, dword done)
+{
+    switch (sched->mode) {
+        case CHIP8_SPEED_MULTI:
+            return done < sched->multiplier;
+        case CHIP8_SPEED_TURBO:
+            // 至少执行一帧，之后一直执行到截止时间前的保留时间
+            return done == 0 || chip8_sched_now() + CHIP8_SCHED_TURBO_RESERVE < sched->deadline;
+        case CHIP8_SPEED_EXACT:
+        default:
+            return done < 1;
+    }
+}
+
+/**
+ * chip8_sched_wait 睡眠到本主机帧的截止时间，然后把截止时间推进一帧。
+ *
+ * 使用绝对截止时间睡眠，被信号打断后继续睡眠到同一时刻；
+ * 已经超过截止时间时不睡眠，落后过多时以当前时间重新对齐。
+ *
+ * @param sched 调度器
+ */
+void chip8_sched_wait(CHIP8_SCHED *sched)
+{
+    qword now = chip8_sched_now();
+    if (now < sched->deadline)
+    {
+#if defined(TIMER_ABSTIME) && !defined(__APPLE__)
+        struct timespec ts = { (time_t)(sched->deadline / 1000000000ULL), (long)(sched->deadline % 1000000000ULL) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+#else
+        qword remaining = sched->deadline - now;
+        struct timespec ts = { (time_t)(remaining / 1000000000ULL), (long)(remaining % 1000000000ULL) };
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+            ;
+#endif
+    }
+    else
+    {
+        sched->late++;
+        if (now - sched->deadline > CHIP8_SCHED_MAX_LAG * CHIP8_FRAME_NS)
+        {
+            sched->deadline = now;
+            sched->resyncs++;
+        }
+    }
+    sched->deadline += CHIP8_FRAME_NS;
+    sched->frames++;
+}
+/// ****************************************************************************** ///
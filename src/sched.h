@@ -0,0 +1,45 @@
+#ifndef __SCHED_H__
+#define __SCHED_H__
+#include "chip8.h"
+
+/// ********************************帧调度器************************************ ///
+// 以 60 Hz 的主机帧为单位调度：每个主机帧内连续执行若干个模拟帧
+// （每个模拟帧 CHIP8_CYCLES_PER_FRAME 条指令，定时器随之前进一帧），显示一次，
+// 然后按单调时钟睡眠到下一帧的绝对截止时间。截止时间每帧累加 CHIP8_FRAME_NS，
+// 睡眠误差不会累积；落后超过 CHIP8_SCHED_MAX_LAG 帧时（如窗口被拖动）直接重新对齐，
+// 不追赶丢失的时间。
+//
+// 速度模式：
+//   EXACT ：每个主机帧一个模拟帧，即原速
+//   MULTI ：每个主机帧 multiplier 个模拟帧
+//   TURBO ：不限速，在主机帧内尽可能多地执行模拟帧，留出显示时间
+enum chip8_speed
+{
+    CHIP8_SPEED_EXACT,
+    CHIP8_SPEED_MULTI,
+    CHIP8_SPEED_TURBO
+};
+
+// 落后超过这么多帧时重新对齐截止时间
+#define CHIP8_SCHED_MAX_LAG 4
+// TURBO 模式为显示和事件处理保留的时间（纳秒）
+#define CHIP8_SCHED_TURBO_RESERVE (CHIP8_FRAME_NS / 4)
+
+typedef struct chip8_sched
+{
+    enum chip8_speed mode;
+    dword multiplier;                // MULTI 模式下每个主机帧的模拟帧数
+    qword deadline;                  // 当前主机帧的截止时间（单调时钟，纳秒）
+    qword frames;                    // 已调度的主机帧数
+    qword late;                      // 超过截止时间才结束的主机帧数
+    qword resyncs;                   // 因落后过多而重新对齐的次数
+} CHIP8_SCHED;
+
+void chip8_sched_init(CHIP8_SCHED *sched, enum chip8_speed mode, dword multiplier);
+void chip8_sched_set_speed(CHIP8_SCHED *sched, enum chip8_speed mode, dword multiplier); // 运行中切换速度模式
+byte chip8_sched_more(const CHIP8_SCHED *sched, dword done);  // 本主机帧已执行 done 个模拟帧，是否继续
+void chip8_sched_wait(CHIP8_SCHED *sched);                    // 睡眠到本主机帧的截止时间，进入下一帧
+qword chip8_sched_now(void);                                  // 单调时钟（纳秒）
+/// ****************************************************************************** ///
+
+#endif
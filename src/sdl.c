@@ -1,3 +1,328 @@
 #include "sdl.h"
 #include "chip8.h"
+#include "sched.h"
 
+/// ******************************SDL 显示后端************************************ ///
+// 窗口使用一张与窗口同尺寸（已按 scale 放大）的流式纹理，放大和调色由 scale.c 的内核完成。
+// 每次显示只把脏行位图中标记的连续行段重新展开并上传，
+// 没有脏行且窗口不需要重绘时完全跳过渲染和 SDL_RenderPresent。
+// 显示和事件处理在主线程中进行，不直接访问 CHIP8：画面来自模拟线程发布的帧（frames.h），
+// 按键事件带着发生时刻写入输入队列（input.h），由模拟线程在指令周期边界应用，
+// 其余请求以标志的形式由主线程转交模拟线程。渲染器开启垂直同步，
+// SDL_RenderPresent 等待刷新只阻塞主线程。
+// 设置了追踪器（trace.h）时记录纹理上传、像素展开和显示三个阶段。
+static struct
+{
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int scale;                       // 放大倍数
+    int width;                       // CHIP-8 显示宽度（像素）
+    int height;                      // CHIP-8 显示高度（像素）
+    byte redraw;                     // 窗口需要整体重绘（初次显示或被遮挡后）
+    CHIP8_PALETTE palette;           // 调色板
+    int effects;                     // 显示效果（CHIP8_SCALE_*）
+    word keys;                       // CHIP-8 按键位图，第 i 位表示按键 i 按下
+    byte quit;                       // 请求退出（Esc 或关闭窗口）
+    byte pause;                      // 按下暂停键（P）的次数，读取后清除
+    byte rewind;                     // 回退键（Backspace）是否按住
+    byte turbo;                      // 加速键（Tab）是否按住
+    int speed_key;                   // 最近按下的速度键 F1-F4（1-4），0 表示没有
+    CHIP8_TRACE *trace;              // 帧时序追踪，NULL 表示不记录
+    CHIP8_INPUT_QUEUE *queue;        // 按键事件队列，NULL 表示不转发
+} display = { .palette = CHIP8_PALETTE_DEFAULT };
+
+// 键盘到 CHIP-8 十六进制键盘的映射
+// 1 2 3 4      1 2 3 C
+// Q W E R  ->  4 5 6 D
+// A S D F      7 8 9 E
+// Z X C V      A 0 B F
+static const SDL_Keycode keymap[CHIP8_KEY_SIZE] = {
+    SDLK_x, SDLK_1, SDLK_2, SDLK_3,
+    SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+    SDLK_s, SDLK_d, SDLK_z, SDLK_c,
+    SDLK_4, SDLK_r, SDLK_f, SDLK_v
+};
+
+/**
+ * init_display 创建窗口、渲染器和流式纹理。
+ *
+ * @param title 窗口标题
+ * @param scale 放大倍数
+ * @param width CHIP-8 显示宽度
+ * @param height CHIP-8 显示高度
+ * @return 成功返回 0，失败返回 1
+ */
+byte init_display(const char *title, int scale, int width, int height)
+{
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0)
+    {
+        fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    display.scale = scale;
+    display.width = width;
+    display.height = height;
+    display.window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                      width * scale, height * scale, SDL_WINDOW_SHOWN);
+    if (display.window == NULL)
+    {
+        fprintf(stderr, "SDL_CreateWindow failed: %s\n", SDL_GetError());
+        close_display();
+        return 1;
+    }
+    display.renderer = SDL_CreateRenderer(display.window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (display.renderer == NULL)
+    {
+        fprintf(stderr, "SDL_CreateRenderer failed: %s\n", SDL_GetError());
+        close_display();
+        return 1;
+    }
+    display.texture = SDL_CreateTexture(display.renderer, SDL_PIXELFORMAT_ARGB8888,
+                                        SDL_TEXTUREACCESS_STREAMING, width * scale, height * scale);
+    if (display.texture == NULL)
+    {
+        fprintf(stderr, "SDL_CreateTexture failed: %s\n", SDL_GetError());
+        close_display();
+        return 1;
+    }
+    display.redraw = 1;
+    return 0;
+}
+
+/**
+ * close_display 销毁纹理、渲染器和窗口。
+ *
+ * @return 总是返回 0
+ */
+int close_display()
+{
+    if (display.texture)
+        SDL_DestroyTexture(display.texture);
+    if (display.renderer)
+        SDL_DestroyRenderer(display.renderer);
+    if (display.window)
+        SDL_DestroyWindow(display.window);
+    display.window = NULL;
+    display.renderer = NULL;
+    display.texture = NULL;
+    SDL_Quit();
+    return 0;
+}
+
+// 把 [first, last] 行展开为放大后的 ARGB 并上传到纹理对应区域
+static void upload_rows(const qword *bitmap, int first, int last)
+{
+    int scale = display.scale;
+    SDL_Rect rect = { 0, first * scale, display.width * scale, (last - first + 1) * scale };
+    void *pixels;
+    int pitch;
+    qword begin = display.trace ? chip8_sched_now() : 0;
+    if (SDL_LockTexture(display.texture, &rect, &pixels, &pitch) != 0)
+        return;
+    qword convert = display.trace ? chip8_sched_now() : 0;
+    chip8_scale_rows(bitmap, first, last, scale, &display.palette, display.effects, pixels, pitch);
+    qword converted = display.trace ? chip8_sched_now() : 0;
+    SDL_UnlockTexture(display.texture);
+    if (display.trace)
+    {
+        chip8_trace_span_arg(display.trace, "upload", begin, chip8_sched_now(), "rows", (qword)(last - first + 1));
+        chip8_trace_span(display.trace, "convert", convert, converted);
+    }
+}
+
+/**
+ * set_display_style 设置调色板和显示效果，下一帧整体重绘。
+ *
+ * @param palette 调色板
+ * @param effects 显示效果（CHIP8_SCALE_*）
+ */
+void set_display_style(const CHIP8_PALETTE *palette, int effects)
+{
+    display.palette = *palette;
+    display.effects = effects;
+    display.redraw = 1;
+}
+
+void set_display_trace(CHIP8_TRACE *trace)
+{
+    display.trace = trace;
+}
+
+/**
+ * present_display 上传脏行并显示一帧。
+ *
+ * 脏行按连续行段分组，每段只锁定并上传纹理中对应的区域。
+ * 既没有脏行也不需要重绘时直接返回，不调用 SDL_RenderPresent。
+ *
+ * @param pixels 1bpp 显示缓冲区，每行一个 64 位字
+ * @param dirty 脏行位图：第 y 位表示第 y 行自上次显示后有变化
+ * @return 显示了一帧返回 1，什么也没做返回 0
+ */
+byte present_display(const qword *pixels, dword dirty)
+{
+    if (display.redraw)
+        dirty = 0xFFFFFFFFu >> (32 - display.height);
+    if (dirty == 0)
+        return 0;
+
+    int y = 0;
+    while (y < display.height)
+    {
+        if (!(dirty & (1u << y)))
+        {
+            y++;
+            continue;
+        }
+        int first = y;
+        while (y < display.height && (dirty & (1u << y)))
+            y++;
+        upload_rows(pixels, first, y - 1);
+    }
+
+    qword present = display.trace ? chip8_sched_now() : 0;
+    SDL_RenderCopy(display.renderer, display.texture, NULL, NULL);
+    SDL_RenderPresent(display.renderer);
+    if (display.trace)
+        chip8_trace_span(display.trace, "present", present, chip8_sched_now());
+    display.redraw = 0;
+    return 1;
+}
+
+void set_input_queue(CHIP8_INPUT_QUEUE *queue)
+{
+    display.queue = queue;
+}
+
+// SDL 事件时间戳（毫秒，SDL_GetTicks 时基）换算为单调时钟，
+// 这样事件在 SDL 队列中等待（例如主线程阻塞在垂直同步上）的时间也计入延迟
+static qword event_time(Uint32 timestamp, qword now)
+{
+    qword age = (qword)(Uint32)(SDL_GetTicks() - timestamp) * 1000000ULL;
+    return age < now ? now - age : now;
+}
+
+/**
+ * poll_input 处理所有待处理的 SDL 事件。
+ *
+ * Esc 或关闭窗口请求退出，P 请求暂停/继续，按住 Backspace 回退，按住 Tab 加速，
+ * F1-F4 切换速度，其余按键按 keymap 映射到按键位图，并把变化写入输入队列（按住的自动重复不写入）。
+ */
+void poll_input()
+{
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        switch (event.type) {
+            case SDL_QUIT:
+                display.quit = 1;
+                break;
+            case SDL_WINDOWEVENT:
+                if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                    display.redraw = 1;
+                break;
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+            {
+                SDL_Keycode sym = event.key.keysym.sym;
+                byte down = event.type == SDL_KEYDOWN;
+                if (down && sym == SDLK_ESCAPE)
+                    display.quit = 1;
+                else if (sym == SDLK_BACKSPACE)
+                    display.rewind = down;
+                else if (sym == SDLK_TAB)
+                    display.turbo = down;
+                else if (down && sym >= SDLK_F1 && sym <= SDLK_F4)
+                    display.speed_key = sym - SDLK_F1 + 1;
+                else if (down && sym == SDLK_p && !event.key.repeat)
+                    display.pause++;
+                for (int i = 0; i < CHIP8_KEY_SIZE; i++)
+                    if (keymap[i] == sym && !event.key.repeat)
+                    {
+                        display.keys = down ? display.keys | (word)(1u << i) : display.keys & (word)~(1u << i);
+                        if (display.queue)
+                            chip8_input_queue_push(display.queue, (byte)i, down,
+                                                   event_time(event.key.timestamp, chip8_sched_now()));
+                    }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * wait_input 等待下一个事件，最多等待 ms 毫秒，不取出事件。
+ *
+ * @param ms 最长等待时间（毫秒）
+ */
+void wait_input(int ms)
+{
+    SDL_WaitEventTimeout(NULL, ms);
+}
+
+/**
+ * input_keys 返回当前的 CHIP-8 按键位图。
+ *
+ * @return 第 i 位表示按键 i 按下
+ */
+word input_keys()
+{
+    return display.keys;
+}
+
+/**
+ * quit_requested 返回是否请求退出。
+ *
+ * @return 请求退出返回 1，否则返回 0
+ */
+byte quit_requested()
+{
+    return display.quit;
+}
+
+/**
+ * pause_requested 返回并清除自上次调用以来按下暂停键的次数。
+ *
+ * @return 按下次数，奇数表示需要切换暂停状态
+ */
+int pause_requested()
+{
+    int count = display.pause;
+    display.pause = 0;
+    return count;
+}
+
+/**
+ * rewind_requested 返回回退键是否按住。
+ *
+ * @return 按住返回 1，否则返回 0
+ */
+byte rewind_requested()
+{
+    return display.rewind;
+}
+
+/**
+ * turbo_requested 返回加速键是否按住。
+ *
+ * @return 按住返回 1，否则返回 0
+ */
+byte turbo_requested()
+{
+    return display.turbo;
+}
+
+/**
+ * speed_hotkey 返回并清除最近按下的速度键。
+ *
+ * @return F1-F4 对应 1-4，没有按下返回 0
+ */
+int speed_hotkey()
+{
+    int key = display.speed_key;
+    display.speed_key = 0;
+    return key;
+}
+/// ****************************************************************************** ///
@@ -1,10 +1,31 @@
 #ifndef __SDL_H__
 #define __SDL_H__
 #include "chip8.h"
+#include "scale.h"
+#include "trace.h"
+#include "input.h"
 #include <SDL2/SDL.h>
 
 byte init_display(const char *title, int scale, int width, int height);
 
 int close_display();
 
+void set_display_style(const CHIP8_PALETTE *palette, int effects); // 设置调色板和显示效果
+
+void set_display_trace(CHIP8_TRACE *trace); // 记录上传和显示阶段的追踪器，NULL 关闭
+
+void set_input_queue(CHIP8_INPUT_QUEUE *queue); // 按键事件写入的队列，NULL 不写入
+
+byte present_display(const qword *pixels, dword dirty); // 上传脏行并显示，画面没有变化时什么也不做并返回 0
+
+void poll_input();                    // 处理窗口事件和键盘输入
+void wait_input(int ms);              // 等待事件，最多 ms 毫秒
+
+word input_keys();                    // CHIP-8 按键位图
+byte quit_requested();                // 是否请求退出
+int pause_requested();                // 按下暂停键的次数，读取后清除
+byte rewind_requested();              // 回退键是否按住
+byte turbo_requested();               // 加速键是否按住
+int speed_hotkey();                   // 最近按下的速度键（F1-F4 为 1-4），读取后清除
+
 #endif
@@ -0,0 +1,363 @@
+#include "snapshot.h"
+
+/**
+ * chip8_snapshot 保存实例的全部机器状态。
+ *
+ * 快照先整体清零再填充，填充字节也是确定的，回退缓冲区可以直接对整个结构体做差分。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param snapshot 输出的快照
+ */
+void chip8_snapshot(const CHIP8 *chip8, CHIP8_SNAPSHOT *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->version = CHIP8_SNAPSHOT_VERSION;
+    memcpy(snapshot->memory, chip8->memory, sizeof(snapshot->memory));
+    memcpy(snapshot->display, chip8->display, sizeof(snapshot->display));
+    memcpy(snapshot->registers, chip8->registers, sizeof(snapshot->registers));
+    snapshot->index_register = chip8->index_register;
+    snapshot->pc = chip8->pc;
+    snapshot->opcode = chip8->opcode;
+    memcpy(snapshot->stack, chip8->stack, sizeof(snapshot->stack));
+    snapshot->sp = chip8->sp;
+    snapshot->delay_deadline = chip8->delay_deadline;
+    snapshot->sound_deadline = chip8->sound_deadline;
+    memcpy(snapshot->keys, chip8->keys, sizeof(snapshot->keys));
+    snapshot->quirks = chip8->quirks;
+    snapshot->cycles = chip8->cycles;
+    snapshot->rng = chip8->rng;
+}
+
+/**
+ * chip8_restore 把快照恢复到实例中。
+ *
+ * 内存整体被替换，译码缓存和 JIT 代码全部失效；整个画面标记为脏，下一帧完整重绘。
+ *
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @param snapshot 要恢复的快照
+ * @return 成功返回 0，快照版本不符或调用栈指针越界返回 -1
+ *
+ * 恢复后清除执行故障（chip8->error），可以从故障前的状态继续执行。
+ */
+int chip8_restore(CHIP8 *chip8, const CHIP8_SNAPSHOT *snapshot)
+{
+    // 快照可能来自不可信的文件，越界的栈指针会让 00EE/2NNN 访问栈外的内存
+    if (snapshot->version != CHIP8_SNAPSHOT_VERSION || snapshot->sp > sizeof(chip8->stack) / sizeof(chip8->stack[0]))
+        return -1;
+    memcpy(chip8->memory, snapshot->memory, sizeof(chip8->memory));
+    memcpy(chip8->display, snapshot->display, sizeof(chip8->display));
+    memcpy(chip8->registers, snapshot->registers, sizeof(chip8->registers));
+    chip8->index_register = snapshot->index_register;
+    chip8->pc = snapshot->pc;
+    chip8->opcode = snapshot->opcode;
+    memcpy(chip8->stack, snapshot->stack, sizeof(chip8->stack));
+    chip8->sp = snapshot->sp;
+    chip8->delay_deadline = snapshot->delay_deadline;
+    chip8->sound_deadline = snapshot->sound_deadline;
+    memcpy(chip8->keys, snapshot->keys, sizeof(chip8->keys));
+    chip8->quirks = snapshot->quirks;
+    chip8->cycles = snapshot->cycles;
+    chip8->rng = snapshot->rng;
+    chip8->display_dirty_rows = 0xFFFFFFFFu;
+    chip8->error = CHIP8_OK;
+    chip8_invalidate_code(chip8, 0, CHIP8_MEMORY_SIZE);
+    return 0;
+}
+
+/// *******************************回退环形缓冲区********************************* ///
+// 记录编码：与基准（关键帧为全零，差分帧为上一帧快照）逐字节异或后做游程编码，
+// 格式为若干个 [零字节数 varint][字面量长度 varint][字面量] 组成的段。
+// 少于 CHIP8_RLE_MIN_ZEROS 个的零字节并入字面量，避免碎段。
+#define CHIP8_RLE_MIN_ZEROS 3
+// 编码结果的最大长度
+#define CHIP8_RLE_BOUND(n) (2 * (n) + 16)
+
+// 一条记录
+struct chip8_rewind_record
+{
+    size_t offset;                   // 在数据区中的偏移
+    size_t size;                     // 编码后的字节数
+    byte keyframe;                   // 是否为关键帧
+};
+
+struct chip8_rewind
+{
+    byte *data;                      // 数据区
+    size_t capacity;                 // 数据区大小
+    size_t write;                    // 下一条记录的写入位置
+    size_t used;                     // 所有记录占用的字节数
+
+    struct chip8_rewind_record *records; // 记录描述符环
+    dword max_frames;                // 描述符环大小
+    dword head;                      // 最旧记录的下标
+    dword count;                     // 记录数
+
+    dword keyframe_interval;         // 关键帧间隔
+    dword since_keyframe;            // 距上一个关键帧的帧数
+    CHIP8_SNAPSHOT last;             // 最新记录对应的完整快照
+    CHIP8_SNAPSHOT scratch;          // 解码用的临时快照
+    byte *encode;                    // 编码用的临时缓冲区
+};
+
+static size_t put_varint(byte *out, size_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = (byte)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (byte)value;
+    return n;
+}
+
+// 读取不超过 size 字节的 varint，越过末尾或超出 size_t 的位数时返回 0
+static size_t get_varint(const byte *in, size_t size, size_t *value)
+{
+    size_t n = 0, shift = 0;
+    *value = 0;
+    do {
+        if (n == size || shift >= 8 * sizeof(size_t))
+            return 0;
+        *value |= (size_t)(in[n] & 0x7F) << shift;
+        shift += 7;
+    } while (in[n++] & 0x80);
+    return n;
+}
+
+// 编码 cur 与 base 的异或差分，base 为 NULL 表示与全零比较
+static size_t rle_encode(const byte *cur, const byte *base, size_t n, byte *out)
+{
+    size_t pos = 0, size = 0;
+#define DIFF(i) (base ? (byte)(cur[i] ^ base[i]) : cur[i])
+    while (pos < n)
+    {
+        size_t zeros = 0;
+        while (pos + zeros < n && DIFF(pos + zeros) == 0)
+            zeros++;
+        size_t start = pos + zeros;
+        size_t end = start;
+        // 字面量一直延伸到下一段足够长的零字节
+        while (end < n)
+        {
+            size_t run = 0;
+            while (end + run < n && DIFF(end + run) == 0 && run < CHIP8_RLE_MIN_ZEROS)
+                run++;
+            if (run == CHIP8_RLE_MIN_ZEROS || end + run == n)
+                break;
+            end += run + 1;
+        }
+        size += put_varint(out + size, zeros);
+        size += put_varint(out + size, end - start);
+        for (size_t i = start; i < end; i++)
+            out[size++] = DIFF(i);
+        pos = end;
+    }
+#undef DIFF
+    return size;
+}
+
+// 把编码的差分异或到 n 字节的 target 上。段越过记录末尾或 target 末尾时返回 -1，
+// 损坏的记录不会写到 target 之外
+static int rle_apply(const byte *in, size_t size, byte *target, size_t n)
+{
+    size_t i = 0, pos = 0;
+    while (i < size)
+    {
+        size_t zeros, literal, len;
+        if ((len = get_varint(in + i, size - i, &zeros)) == 0)
+            return -1;
+        i += len;
+        if ((len = get_varint(in + i, size - i, &literal)) == 0)
+            return -1;
+        i += len;
+        if (zeros > n - pos || literal > n - pos - zeros || literal > size - i)
+            return -1;
+        pos += zeros;
+        for (size_t k = 0; k < literal; k++)
+            target[pos++] ^= in[i++];
+    }
+    return 0;
+}
+
+static struct chip8_rewind_record *rewind_record(CHIP8_REWIND *rewind, dword index)
+{
+    return &rewind->records[(rewind->head + index) % rewind->max_frames];
+}
+
+// 丢弃最旧的一组记录（一个关键帧及其后的差分帧）
+static void rewind_drop_oldest_group(CHIP8_REWIND *rewind)
+{
+    do {
+        rewind->used -= rewind_record(rewind, 0)->size;
+        rewind->head = (rewind->head + 1) % rewind->max_frames;
+        rewind->count--;
+    } while (rewind->count > 0 && !rewind_record(rewind, 0)->keyframe);
+    if (rewind->count == 0)
+    {
+        rewind->write = 0;
+        rewind->used = 0;
+    }
+}
+
+// 为 size 字节的新记录腾出连续空间，返回写入位置。
+// 记录按写入顺序在数据区中首尾相接，最多绕回一次：最旧的记录在 write 之前时，记录占用
+// [最旧记录, write)，空闲的是 [write, capacity) 和 [0, 最旧记录)；否则已经绕回，记录占用
+// [最旧记录, capacity) 和 [0, write)，空闲的只有 [write, 最旧记录)。放不下时丢弃最旧的组，
+// 绕回时末尾的记录全部丢弃之后才会回到前一种情况，新记录不会覆盖任何还在使用的记录
+static size_t rewind_reserve(CHIP8_REWIND *rewind, size_t size)
+{
+    while (rewind->count == rewind->max_frames)
+        rewind_drop_oldest_group(rewind);
+    for (;;)
+    {
+        if (rewind->count == 0)
+            return 0;
+        size_t oldest = rewind_record(rewind, 0)->offset;
+        if (oldest < rewind->write)
+        {
+            if (rewind->write + size <= rewind->capacity)
+                return rewind->write;
+            if (size <= oldest)
+                return 0;
+        }
+        else if (rewind->write + size <= oldest)
+            return rewind->write;
+        rewind_drop_oldest_group(rewind);
+    }
+}
+
+// 把第 index 条记录对应的完整快照解码到 out，记录损坏时返回 -1
+static int rewind_decode(CHIP8_REWIND *rewind, dword index, CHIP8_SNAPSHOT *out)
+{
+    dword key = index;
+    while (!rewind_record(rewind, key)->keyframe)
+        key--;
+    memset(out, 0, sizeof(*out));
+    for (dword i = key; i <= index; i++)
+    {
+        struct chip8_rewind_record *record = rewind_record(rewind, i);
+        if (rle_apply(rewind->data + record->offset, record->size, (byte *)out, sizeof(*out)) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * chip8_rewind_create 创建回退缓冲区。
+ *
+ * @param capacity 记录数据区的字节数，至少要能放下一个关键帧
+ * @param max_frames 最多保存的帧数
+ * @param keyframe_interval 关键帧间隔（帧）
+ * @return 回退缓冲区，失败返回 NULL
+ */
+CHIP8_REWIND *chip8_rewind_create(size_t capacity, dword max_frames, dword keyframe_interval)
+{
+    if (max_frames == 0 || capacity < CHIP8_RLE_BOUND(sizeof(CHIP8_SNAPSHOT)))
+        return NULL;
+    CHIP8_REWIND *rewind = (CHIP8_REWIND *)calloc(1, sizeof(CHIP8_REWIND));
+    if (rewind == NULL)
+        return NULL;
+    rewind->data = (byte *)malloc(capacity);
+    rewind->records = (struct chip8_rewind_record *)malloc(max_frames * sizeof(struct chip8_rewind_record));
+    rewind->encode = (byte *)malloc(CHIP8_RLE_BOUND(sizeof(CHIP8_SNAPSHOT)));
+    if (rewind->data == NULL || rewind->records == NULL || rewind->encode == NULL)
+    {
+        chip8_rewind_free(rewind);
+        return NULL;
+    }
+    rewind->capacity = capacity;
+    rewind->max_frames = max_frames;
+    rewind->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+    return rewind;
+}
+
+void chip8_rewind_free(CHIP8_REWIND *rewind)
+{
+    if (rewind == NULL)
+        return;
+    free(rewind->data);
+    free(rewind->records);
+    free(rewind->encode);
+    free(rewind);
+}
+
+/**
+ * chip8_rewind_push 记录实例的当前状态。
+ *
+ * 每 keyframe_interval 帧写一个关键帧，其余帧只写与上一帧的差分。
+ * 空间不足把当前组的关键帧也挤掉时，本帧改写为关键帧。
+ *
+ * @param rewind 回退缓冲区
+ * @param chip8 指向 CHIP8 结构体的指针
+ */
+void chip8_rewind_push(CHIP8_REWIND *rewind, const CHIP8 *chip8)
+{
+    chip8_snapshot(chip8, &rewind->scratch);
+
+    byte keyframe = rewind->count == 0 || rewind->since_keyframe + 1 >= rewind->keyframe_interval;
+    for (;;)
+    {
+        size_t size = rle_encode((const byte *)&rewind->scratch,
+                                 keyframe ? NULL : (const byte *)&rewind->last,
+                                 sizeof(CHIP8_SNAPSHOT), rewind->encode);
+        size_t at = rewind_reserve(rewind, size);
+        if (!keyframe && rewind->count == 0)
+        {
+            keyframe = 1;
+            continue;
+        }
+        memcpy(rewind->data + at, rewind->encode, size);
+        struct chip8_rewind_record *record = rewind_record(rewind, rewind->count);
+        record->offset = at;
+        record->size = size;
+        record->keyframe = keyframe;
+        rewind->count++;
+        rewind->write = at + size;
+        rewind->used += size;
+        break;
+    }
+    rewind->since_keyframe = keyframe ? 0 : rewind->since_keyframe + 1;
+    rewind->last = rewind->scratch;
+}
+
+/**
+ * chip8_rewind_pop 回退一帧：丢弃最新的记录，把实例恢复到它之前的一帧。
+ *
+ * 最早的一帧不会被丢弃，重复回退会停留在最早的状态。
+ *
+ * @param rewind 回退缓冲区
+ * @param chip8 指向 CHIP8 结构体的指针
+ * @return 成功返回 0，没有更早的帧或记录损坏时返回 -1
+ */
+int chip8_rewind_pop(CHIP8_REWIND *rewind, CHIP8 *chip8)
+{
+    if (rewind->count < 2)
+        return -1;
+    struct chip8_rewind_record *newest = rewind_record(rewind, rewind->count - 1);
+    rewind->count--;
+    rewind->used -= newest->size;
+    // 下一条记录接在剩下的最新记录之后，弹出绕回到开头的记录时末尾的空间也一并收回
+    newest = rewind_record(rewind, rewind->count - 1);
+    rewind->write = newest->offset + newest->size;
+
+    if (rewind_decode(rewind, rewind->count - 1, &rewind->last) != 0)
+        return -1;
+    // 重新计算距离关键帧的帧数
+    dword since = 0;
+    for (dword i = rewind->count - 1; !rewind_record(rewind, i)->keyframe; i--)
+        since++;
+    rewind->since_keyframe = since;
+    return chip8_restore(chip8, &rewind->last);
+}
+
+dword chip8_rewind_frames(const CHIP8_REWIND *rewind)
+{
+    return rewind->count;
+}
+
+size_t chip8_rewind_bytes(const CHIP8_REWIND *rewind)
+{
+    return rewind->used;
+}
+/// ****************************************************************************** ///
@@ -0,0 +1,45 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+#include "chip8.h"
+
+/// *******************************快照与回退************************************* ///
+// 快照保存一个实例的全部机器状态，可以恢复到同一个或另一个实例中。
+// 布局变化时递增 CHIP8_SNAPSHOT_VERSION，版本不一致的快照拒绝恢复。
+#define CHIP8_SNAPSHOT_VERSION 3
+
+typedef struct chip8_snapshot
+{
+    dword version;                   // CHIP8_SNAPSHOT_VERSION
+    byte memory[CHIP8_MEMORY_SIZE];
+    qword display[CHIP8_DISPLAY_HEIGHT];
+    byte registers[16];
+    word index_register;
+    word pc;
+    word opcode;
+    word stack[16];
+    byte sp;
+    qword delay_deadline;
+    qword sound_deadline;
+    byte keys[CHIP8_KEY_SIZE];
+    byte quirks;
+    qword cycles;
+    qword rng;
+} CHIP8_SNAPSHOT;
+
+void chip8_snapshot(const CHIP8 *chip8, CHIP8_SNAPSHOT *snapshot);      // 保存快照
+int chip8_restore(CHIP8 *chip8, const CHIP8_SNAPSHOT *snapshot);        // 恢复快照并清除故障，版本不符或栈指针越界返回 -1
+
+// 回退环形缓冲区：固定大小的内存中每 keyframe_interval 帧保存一个完整关键帧，
+// 其余帧只保存与上一帧快照异或后的游程编码（RLE）差分。空间不足时按关键帧组
+// 丢弃最旧的记录。
+typedef struct chip8_rewind CHIP8_REWIND;
+
+CHIP8_REWIND *chip8_rewind_create(size_t capacity, dword max_frames, dword keyframe_interval);
+void chip8_rewind_free(CHIP8_REWIND *rewind);
+void chip8_rewind_push(CHIP8_REWIND *rewind, const CHIP8 *chip8);       // 每帧调用一次，记录当前状态
+int chip8_rewind_pop(CHIP8_REWIND *rewind, CHIP8 *chip8);               // 回退一帧，没有更早的帧时返回 -1
+dword chip8_rewind_frames(const CHIP8_REWIND *rewind);                  // 当前保存的帧数
+size_t chip8_rewind_bytes(const CHIP8_REWIND *rewind);                  // 当前记录占用的字节数
+/// ****************************************************************************** ///
+
+#endif
@@ -0,0 +1,259 @@
+#include "trace.h"
+#include "sched.h"
+
+/// ********************************帧时序追踪********************************** ///
+// 把一条轨道 [tail, head) 中的事件写入文件，只由后台线程（或关闭时的调用者）执行
+static void chip8_trace_drain_track(CHIP8_TRACE *root, CHIP8_TRACE *trace)
+{
+    if (!trace->named)
+    {
+        fprintf(root->fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                trace->tid, trace->name);
+        trace->named = 1;
+    }
+    dword tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+    dword head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    for (; tail != head; tail++)
+    {
+        const CHIP8_TRACE_EVENT *e = &trace->events[tail & trace->mask];
+        qword ts = e->ts > root->origin ? e->ts - root->origin : 0;
+        fprintf(root->fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03llu",
+                e->name, e->phase, trace->tid, (unsigned long long)(ts / 1000), (unsigned long long)(ts % 1000));
+        if (e->phase == 'X')
+            fprintf(root->fp, ",\"dur\":%llu.%03llu", (unsigned long long)(e->dur / 1000), (unsigned long long)(e->dur % 1000));
+        else
+            fprintf(root->fp, ",\"s\":\"t\"");
+        if (e->arg_name != NULL)
+            fprintf(root->fp, ",\"args\":{\"%s\":%llu}", e->arg_name, (unsigned long long)e->arg);
+        fputc('}', root->fp);
+        root->written++;
+    }
+    atomic_store_explicit(&trace->tail, tail, memory_order_release);
+}
+
+static void chip8_trace_drain(CHIP8_TRACE *root)
+{
+    for (CHIP8_TRACE *t = root; t != NULL; t = atomic_load_explicit(&t->next, memory_order_acquire))
+        chip8_trace_drain_track(root, t);
+}
+
+static void *chip8_trace_main(void *arg)
+{
+    CHIP8_TRACE *trace = (CHIP8_TRACE *)arg;
+    struct timespec ts = { 0, (long)CHIP8_TRACE_FLUSH_NS };
+    while (atomic_load_explicit(&trace->running, memory_order_acquire))
+    {
+        chip8_trace_drain(trace);
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+// 分配一条轨道，capacity 向上取整到 2 的幂，0 使用 CHIP8_TRACE_EVENTS
+static CHIP8_TRACE *chip8_trace_alloc(dword capacity, const char *name)
+{
+    dword size = 1;
+    while (size < (capacity ? capacity : CHIP8_TRACE_EVENTS))
+        size <<= 1;
+    CHIP8_TRACE *trace = (CHIP8_TRACE *)calloc(1, sizeof(CHIP8_TRACE));
+    if (trace == NULL)
+        return NULL;
+    trace->events = (CHIP8_TRACE_EVENT *)malloc(size * sizeof(CHIP8_TRACE_EVENT));
+    if (trace->events == NULL)
+    {
+        free(trace);
+        return NULL;
+    }
+    trace->mask = size - 1;
+    trace->name = name;
+    trace->tid = 1;
+    trace->root = trace;
+    return trace;
+}
+
+/**
+ * chip8_trace_open 创建追踪文件并启动后台写入线程。
+ *
+ * @param path 输出文件路径
+ * @param capacity 环形缓冲区容量（事件数），向上取整到 2 的幂，0 使用 CHIP8_TRACE_EVENTS
+ * @return 主轨道，文件无法创建或内存不足时返回 NULL
+ */
+CHIP8_TRACE *chip8_trace_open(const char *path, dword capacity)
+{
+    CHIP8_TRACE *trace = chip8_trace_alloc(capacity, "main");
+    if (trace == NULL)
+        return NULL;
+    trace->fp = fopen(path, "w");
+    if (trace->fp == NULL)
+    {
+        free(trace->events);
+        free(trace);
+        return NULL;
+    }
+    trace->origin = chip8_sched_now();
+    // 第一项是主轨道的线程名元数据，之后每个事件以 ",\n" 开头
+    fprintf(trace->fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                       "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}");
+    trace->named = 1;
+    atomic_store(&trace->running, 1);
+    if (pthread_create(&trace->thread, NULL, chip8_trace_main, trace) != 0)
+    {
+        fclose(trace->fp);
+        free(trace->events);
+        free(trace);
+        return NULL;
+    }
+    return trace;
+}
+
+/**
+ * chip8_trace_track 为另一个记录线程创建一条轨道。
+ *
+ * 轨道与主轨道共用文件和后台线程，随 chip8_trace_close 一起释放。
+ * 应在开始记录之前由同一个线程依次创建。
+ *
+ * @param trace 主轨道，可以为 NULL
+ * @param name 轨道名（静态字符串），显示为线程名
+ * @param capacity 环形缓冲区容量，含义同 chip8_trace_open
+ * @return 新轨道；trace 为 NULL 或内存不足时返回 NULL，记录函数照常接受
+ */
+CHIP8_TRACE *chip8_trace_track(CHIP8_TRACE *trace, const char *name, dword capacity)
+{
+    if (trace == NULL)
+        return NULL;
+    CHIP8_TRACE *root = trace->root;
+    CHIP8_TRACE *track = chip8_trace_alloc(capacity, name);
+    if (track == NULL)
+        return NULL;
+    CHIP8_TRACE *last = root;
+    while (atomic_load(&last->next) != NULL)
+        last = atomic_load(&last->next);
+    track->tid = last->tid + 1;
+    track->root = root;
+    atomic_store_explicit(&last->next, track, memory_order_release);
+    return track;
+}
+
+/**
+ * chip8_trace_close 停止后台线程，写出所有轨道剩余的事件和丢弃计数后关闭文件。
+ *
+ * @param trace 主轨道，可以为 NULL
+ */
+void chip8_trace_close(CHIP8_TRACE *trace)
+{
+    if (trace == NULL)
+        return;
+    atomic_store_explicit(&trace->running, 0, memory_order_release);
+    pthread_join(trace->thread, NULL);
+    chip8_trace_drain(trace);
+    fprintf(trace->fp, "\n],\"otherData\":{\"events\":%llu,\"dropped\":%llu}}\n",
+            (unsigned long long)trace->written, (unsigned long long)chip8_trace_dropped(trace));
+    fclose(trace->fp);
+    CHIP8_TRACE *next;
+    for (CHIP8_TRACE *t = trace; t != NULL; t = next)
+    {
+        next = atomic_load(&t->next);
+        free(t->events);
+        free(t);
+    }
+}
+
+// 写入一个事件，缓冲区满时丢弃
+static void chip8_trace_push(CHIP8_TRACE *trace, char phase, const char *name, qword ts, qword dur,
+                             const char *arg_name, qword arg)
+{
+    dword head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&trace->tail, memory_order_acquire) > trace->mask)
+    {
+        atomic_fetch_add_explicit(&trace->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    CHIP8_TRACE_EVENT *e = &trace->events[head & trace->mask];
+    e->ts = ts;
+    e->dur = dur;
+    e->name = name;
+    e->arg_name = arg_name;
+    e->arg = arg;
+    e->phase = phase;
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+void chip8_trace_span(CHIP8_TRACE *trace, const char *name, qword begin, qword end)
+{
+    if (trace != NULL)
+        chip8_trace_push(trace, 'X', name, begin, end > begin ? end - begin : 0, NULL, 0);
+}
+
+void chip8_trace_span_arg(CHIP8_TRACE *trace, const char *name, qword begin, qword end,
+                          const char *arg_name, qword arg)
+{
+    if (trace != NULL)
+        chip8_trace_push(trace, 'X', name, begin, end > begin ? end - begin : 0, arg_name, arg);
+}
+
+void chip8_trace_instant(CHIP8_TRACE *trace, const char *name, qword ts, const char *arg_name, qword arg)
+{
+    if (trace != NULL)
+        chip8_trace_push(trace, 'i', name, ts, 0, arg_name, arg);
+}
+
+qword chip8_trace_dropped(const CHIP8_TRACE *trace)
+{
+    qword dropped = 0;
+    for (CHIP8_TRACE *t = trace ? trace->root : NULL; t != NULL; t = atomic_load(&t->next))
+        dropped += atomic_load(&t->dropped);
+    return dropped;
+}
+/// ****************************************************************************** ///
+
+
+/// *********************************时长直方图********************************** ///
+void chip8_hist_init(CHIP8_HIST *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+void chip8_hist_add(CHIP8_HIST *hist, qword ns)
+{
+    qword bucket = ns / CHIP8_HIST_BUCKET_NS;
+    hist->buckets[bucket < CHIP8_HIST_BUCKETS ? bucket : CHIP8_HIST_BUCKETS - 1]++;
+    hist->count++;
+    hist->total += ns;
+    if (ns > hist->max)
+        hist->max = ns;
+}
+
+/**
+ * chip8_hist_percentile 估计第 p 百分位的时长。
+ *
+ * @param hist 直方图
+ * @param p 百分位（0-100）
+ * @return 所在桶的上沿（纳秒），不超过最大样本；没有样本时返回 0
+ */
+qword chip8_hist_percentile(const CHIP8_HIST *hist, double p)
+{
+    if (hist->count == 0)
+        return 0;
+    qword rank = (qword)(p / 100.0 * (double)hist->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    qword seen = 0;
+    for (dword i = 0; i < CHIP8_HIST_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+        {
+            qword upper = (qword)(i + 1) * CHIP8_HIST_BUCKET_NS;
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void chip8_hist_print(const CHIP8_HIST *hist, const char *name, FILE *fp)
+{
+    fprintf(fp, "%s: n=%llu mean=%.2fms p50=%.2fms p99=%.2fms max=%.2fms\n", name,
+            (unsigned long long)hist->count, hist->count ? hist->total / 1e6 / (double)hist->count : 0.0,
+            chip8_hist_percentile(hist, 50) / 1e6, chip8_hist_percentile(hist, 99) / 1e6, hist->max / 1e6);
+}
+/// ****************************************************************************** ///
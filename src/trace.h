@@ -0,0 +1,87 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+#include "chip8.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/// ********************************帧时序追踪********************************** ///
+// 以 Chrome trace-event 格式（chrome://tracing、ui.perfetto.dev 可直接打开）记录
+// 每个主机帧的各个阶段（区间事件 "X"）和输入到达等时刻（瞬时事件 "i"）。
+//
+// 记录线程只把事件写入单生产者单消费者环形缓冲区（几次普通存储和一次原子发布），
+// 不格式化、不做 I/O；后台线程每 CHIP8_TRACE_FLUSH_NS 把缓冲区中的事件写入文件。
+// 缓冲区满时丢弃新事件并计数，从不阻塞记录线程。时间取自单调时钟（纳秒），
+// 输出时换算为相对打开时刻的微秒。事件名和参数名必须是静态字符串。
+// 所有记录函数都接受 NULL，未开启追踪时调用者不需要判断。
+//
+// 每个环形缓冲区只允许一个记录线程。其他线程用 chip8_trace_track 创建自己的轨道
+// （独立的环形缓冲区，在查看器中显示为单独的一行），由同一个后台线程写入同一个文件。
+
+// 环形缓冲区默认容量（事件数，必须是 2 的幂）
+#define CHIP8_TRACE_EVENTS 65536
+// 后台线程写文件的间隔
+#define CHIP8_TRACE_FLUSH_NS 50000000ULL
+
+typedef struct chip8_trace_event
+{
+    qword ts;                        // 开始时刻（单调时钟，纳秒）
+    qword dur;                       // 持续时间（纳秒），瞬时事件为 0
+    const char *name;                // 事件名
+    const char *arg_name;            // 参数名，NULL 表示没有参数
+    qword arg;                       // 参数值
+    char phase;                      // 'X' 区间，'i' 瞬时
+} CHIP8_TRACE_EVENT;
+
+typedef struct chip8_trace
+{
+    CHIP8_TRACE_EVENT *events;       // 环形缓冲区
+    const char *name;                // 轨道（线程）名
+    dword tid;                       // 轨道编号，chip8_trace_open 返回的主轨道为 1
+    byte named;                      // 轨道名元数据是否已写入文件
+    struct chip8_trace *root;        // 主轨道，主轨道指向自己
+    struct chip8_trace *_Atomic next; // 下一条轨道，由主轨道串起
+    dword mask;                      // 容量 - 1
+    _Atomic dword head;              // 下一个写入位置（记录线程）
+    _Atomic dword tail;              // 下一个读取位置（后台线程）
+    _Atomic qword dropped;           // 缓冲区满时丢弃的事件数
+    _Atomic byte running;            // 后台线程是否继续
+    // 以下只在主轨道中使用
+    qword origin;                    // 打开时刻，输出的 ts 相对于它
+    qword written;                   // 已写入文件的事件数
+    FILE *fp;
+    pthread_t thread;
+} CHIP8_TRACE;
+
+CHIP8_TRACE *chip8_trace_open(const char *path, dword capacity); // 打开追踪文件并启动后台线程，失败返回 NULL
+void chip8_trace_close(CHIP8_TRACE *trace);                      // 写出剩余事件、结束文件并释放所有轨道
+CHIP8_TRACE *chip8_trace_track(CHIP8_TRACE *trace, const char *name, dword capacity); // 为另一个线程创建轨道
+void chip8_trace_span(CHIP8_TRACE *trace, const char *name, qword begin, qword end); // 记录 [begin, end) 区间
+void chip8_trace_span_arg(CHIP8_TRACE *trace, const char *name, qword begin, qword end,
+                          const char *arg_name, qword arg);     // 带一个整数参数的区间
+void chip8_trace_instant(CHIP8_TRACE *trace, const char *name, qword ts,
+                         const char *arg_name, qword arg);      // 记录瞬时事件
+qword chip8_trace_dropped(const CHIP8_TRACE *trace);             // 所有轨道丢弃的事件数
+/// ****************************************************************************** ///
+
+
+/// *********************************时长直方图********************************** ///
+// 固定宽度的桶统计时长分布，记录为 O(1)，百分位按桶的上沿估计，精度为一个桶宽。
+// 超出范围的样本计入最后一个桶，最大值另外精确记录。
+#define CHIP8_HIST_BUCKET_NS 100000ULL  // 桶宽 0.1 ms
+#define CHIP8_HIST_BUCKETS 1000         // 覆盖 0-100 ms
+
+typedef struct chip8_hist
+{
+    dword buckets[CHIP8_HIST_BUCKETS];
+    qword count;
+    qword total;                     // 样本总和（纳秒）
+    qword max;                       // 最大样本（纳秒）
+} CHIP8_HIST;
+
+void chip8_hist_init(CHIP8_HIST *hist);
+void chip8_hist_add(CHIP8_HIST *hist, qword ns);                 // 记录一个样本
+qword chip8_hist_percentile(const CHIP8_HIST *hist, double p);   // 第 p 百分位（0-100），纳秒
+void chip8_hist_print(const CHIP8_HIST *hist, const char *name, FILE *fp); // 输出 p50/p99/max 摘要
+/// ****************************************************************************** ///
+
+#endif
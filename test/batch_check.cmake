@@ -0,0 +1,18 @@
+# 用 chip8_batch 执行任务清单，结果与预期文件逐行比较（去掉随引擎和运行而变的 skipped/fused/time_ms 和汇总行）
+#   cmake -DBATCH=<chip8_batch> -DENGINE=<引擎> -DMANIFEST=<清单> -DEXPECTED=<预期结果> [-DOPTIONS=-n;-L] -P batch_check.cmake
+# 在清单所在目录中执行，输出的 ROM 路径与预期文件一样是相对路径
+get_filename_component(manifest_dir ${MANIFEST} DIRECTORY)
+get_filename_component(manifest_name ${MANIFEST} NAME)
+execute_process(COMMAND ${BATCH} -j 2 -e ${ENGINE} ${OPTIONS} ${manifest_name}
+                WORKING_DIRECTORY ${manifest_dir}
+                OUTPUT_VARIABLE output
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "chip8_batch -e ${ENGINE} ${OPTIONS} exited with ${result}:\n${output}")
+endif()
+string(REGEX REPLACE " skipped=[0-9]+ fused=[0-9]+ time_ms=[0-9.]+" "" output "${output}")
+string(REGEX REPLACE "jobs=[^\n]*\n" "" output "${output}")
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "chip8_batch -e ${ENGINE} ${OPTIONS} differs from ${EXPECTED}:\n${output}")
+endif()
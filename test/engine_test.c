@@ -0,0 +1,169 @@
+#include "test.h"
+
+/// ******************************自修改代码测试*********************************** ///
+// 程序用 FX33/FX55 改写已经译码、编译或融合过的指令后再执行它们。每个用例在每个引擎上
+// 分别以每次一条指令和一次整段两种方式执行，完整状态必须与参考实现逐位一致，
+// VA 还要等于按改写后的代码手算的结果（读到过期代码时得到的是改写前的结果）。
+
+struct test_case
+{
+    const char *name;
+    const byte *rom;
+    size_t size;
+    byte expected;                   // 停机时 VA 的值
+};
+
+// 循环体中的 7A01 每一轮被 FX55 改写为 7A02、7A03：VA = 4 * (1 + 2 + 3)
+static const byte test_loop_body[] = {
+    0x6A, 0x00,                      // 200: VA = 0
+    0x6B, 0x03,                      // 202: VB = 3          轮数
+    0x6D, 0x01,                      // 204: VD = 1          当前立即数
+    0x6C, 0x04,                      // 206: VC = 4          每轮循环次数
+    0x7A, 0x01,                      // 208: VA += 1         被改写的指令
+    0x7C, 0xFF,                      // 20A: VC -= 1
+    0x3C, 0x00,                      // 20C: VC == 0 时跳过
+    0x12, 0x08,                      // 20E: jp 208
+    0x7B, 0xFF,                      // 210: VB -= 1
+    0x3B, 0x00,                      // 212: VB == 0 时跳过
+    0x12, 0x18,                      // 214: jp 218
+    0x12, 0x16,                      // 216: 停机
+    0x7D, 0x01,                      // 218: VD += 1
+    0x60, 0x7A,                      // 21A: V0 = 0x7A
+    0x81, 0xD0,                      // 21C: V1 = VD
+    0xA2, 0x08,                      // 21E: I = 0x208
+    0xF1, 0x55,                      // 220: [208] = 7A VD
+    0x12, 0x06,                      // 222: jp 206
+};
+
+// FX33 把 VC 的个位写到 6000 的立即数上（十位、百位把后面的空操作写成 0000）：VA = 0 + 2 + 3
+static const byte test_bcd_immediate[] = {
+    0x6A, 0x00,                      // 200: VA = 0
+    0x6B, 0x03,                      // 202: VB = 3
+    0x6C, 0x01,                      // 204: VC = 1
+    0x60, 0x00,                      // 206: V0 = NN         被改写的立即数
+    0x00, 0x00,                      // 208: 空操作（FX33 的十位、百位）
+    0x8A, 0x04,                      // 20A: VA += V0
+    0x7B, 0xFF,                      // 20C: VB -= 1
+    0x3B, 0x00,                      // 20E: VB == 0 时跳过
+    0x12, 0x14,                      // 210: jp 214
+    0x12, 0x12,                      // 212: 停机
+    0x7C, 0x01,                      // 214: VC += 1
+    0xA2, 0x07,                      // 216: I = 0x207
+    0xFC, 0x33,                      // 218: [207..209] = BCD(VC)
+    0x12, 0x06,                      // 21A: jp 206
+};
+
+// 同一个基本块中，FX55 改写块内后面的一条指令：VA = 5
+static const byte test_same_block[] = {
+    0x6A, 0x00,                      // 200: VA = 0
+    0x60, 0x7A,                      // 202: V0 = 0x7A
+    0x61, 0x05,                      // 204: V1 = 5
+    0xA2, 0x0C,                      // 206: I = 0x20C
+    0xF1, 0x55,                      // 208: [20C] = 7A 05
+    0x6B, 0x00,                      // 20A: VB = 0
+    0x7A, 0x01,                      // 20C: VA += 1         执行前已被改写为 VA += 5
+    0x12, 0x0E,                      // 20E: 停机
+};
+
+// 把融合成超级指令的连续 6XNN 中的第三条改写为 7XNN，超级指令不能再按 6XNN 执行它：
+// VA = (1 + 2 + 3) + (1 + 2 + 3 + 0x10)
+static const byte test_fused_run[] = {
+    0x6A, 0x00,                      // 200: VA = 0
+    0x7B, 0x02,                      // 202: VB += 2         不是 6XNN，超级指令从 204 开始
+    0x60, 0x01,                      // 204: V0 = 1          超级指令的首条
+    0x61, 0x02,                      // 206: V1 = 2
+    0x62, 0x03,                      // 208: V2 = 3          被改写为 V2 += 0x10
+    0x8A, 0x04,                      // 20A: VA += V0
+    0x8A, 0x14,                      // 20C: VA += V1
+    0x8A, 0x24,                      // 20E: VA += V2
+    0x7B, 0xFF,                      // 210: VB -= 1
+    0x3B, 0x00,                      // 212: VB == 0 时跳过
+    0x12, 0x18,                      // 214: jp 218
+    0x12, 0x16,                      // 216: 停机
+    0x60, 0x72,                      // 218: V0 = 0x72
+    0x61, 0x10,                      // 21A: V1 = 0x10
+    0xA2, 0x08,                      // 21C: I = 0x208
+    0xF1, 0x55,                      // 21E: [208] = 72 10
+    0x12, 0x04,                      // 220: jp 204
+};
+
+static const struct test_case test_cases[] = {
+    { "loop body", test_loop_body, sizeof(test_loop_body), 24 },
+    { "bcd immediate", test_bcd_immediate, sizeof(test_bcd_immediate), 5 },
+    { "same block", test_same_block, sizeof(test_same_block), 5 },
+    { "fused run", test_fused_run, sizeof(test_fused_run), 28 },
+};
+
+static const char *const test_engine_names[CHIP8_ENGINE_COUNT] = { "switch", "table", "goto", "cache", "jit", "aot" };
+
+// 比较两个实例的完整机器状态
+static int test_same_state(const CHIP8 *a, const CHIP8 *b)
+{
+    TEST_CHECK(memcmp(a->memory, b->memory, sizeof(a->memory)) == 0);
+    TEST_CHECK(memcmp(a->display, b->display, sizeof(a->display)) == 0);
+    TEST_CHECK(memcmp(a->registers, b->registers, sizeof(a->registers)) == 0);
+    TEST_CHECK(memcmp(a->stack, b->stack, sizeof(a->stack)) == 0);
+    TEST_CHECK(a->index_register == b->index_register && a->pc == b->pc && a->sp == b->sp);
+    TEST_CHECK(a->cycles == b->cycles && a->error == b->error);
+    return 0;
+}
+
+/**
+ * test_self_modifying 在一个引擎上执行用例并与参考实现比较。
+ *
+ * @param test 用例
+ * @param engine 被测引擎
+ * @param burst 每次 chip8_emulate_cycles 的指令数
+ * @return 通过返回 0
+ */
+static int test_self_modifying(const struct test_case *test, enum chip8_engine engine, dword burst)
+{
+    enum { CYCLES = 400 };
+    CHIP8 *chip8 = chip8_init();
+    CHIP8 *ref = chip8_init();
+    TEST_CHECK(chip8 != NULL && ref != NULL);
+    TEST_CHECK(chip8_load_buffer(chip8, test->rom, test->size) == CHIP8_OK);
+    TEST_CHECK(chip8_load_buffer(ref, test->rom, test->size) == CHIP8_OK);
+    chip8->engine = engine;
+    ref->engine = CHIP8_ENGINE_SWITCH;
+    ref->idle_skip = 0;
+
+    for (dword done = 0; done < CYCLES; done += burst)
+    {
+        chip8_emulate_cycles(chip8, burst);
+        chip8_emulate_cycles(ref, burst);
+        if (test_same_state(chip8, ref) != 0)
+        {
+            fprintf(stderr, "%s: %s diverges at cycle %llu (burst %u)\n", test->name,
+                    test_engine_names[engine], (unsigned long long)ref->cycles, burst);
+            return 1;
+        }
+    }
+    TEST_CHECK(ref->registers[0xA] == test->expected);
+    chip8_free(chip8);
+    chip8_free(ref);
+    return 0;
+}
+
+// 每个用例在每个引擎上逐条和整段各执行一次
+static int test_all_engines(const struct test_case *test)
+{
+    int failed = 0;
+    for (int engine = 0; engine < CHIP8_ENGINE_COUNT; engine++)
+    {
+        failed |= test_self_modifying(test, (enum chip8_engine)engine, 1);
+        failed |= test_self_modifying(test, (enum chip8_engine)engine, 400);
+    }
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+    TEST_RUN(failed, test_all_engines(&test_cases[0]));
+    TEST_RUN(failed, test_all_engines(&test_cases[1]));
+    TEST_RUN(failed, test_all_engines(&test_cases[2]));
+    TEST_RUN(failed, test_all_engines(&test_cases[3]));
+    return failed ? 1 : 0;
+}
+/// ****************************************************************************** ///
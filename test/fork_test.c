@@ -0,0 +1,162 @@
+#include "fork.h"
+#include "test.h"
+#include <stdlib.h>
+
+/// ******************************写时复制分支测试******************************** ///
+// 用法：fork_test <rom>
+
+// 设置 I = 0xE00，V0 = 0x2A，V1 加一，FX55 把 V0 写入 0xE00，然后原地循环。
+// 执行 4 条指令恰好只写内存页 0xE00 / CHIP8_MEMORY_PAGE_SIZE
+static const byte test_program[] = {
+    0xAE, 0x00, 0x60, 0x2A, 0x71, 0x01, 0xF0, 0x55, 0x12, 0x08,
+};
+#define TEST_PAGE (0xE00 / CHIP8_MEMORY_PAGE_SIZE)
+
+// 工作实例的内存、寄存器和显示与节点一致
+static int test_matches(const CHIP8 *chip8, const CHIP8_FORK *node)
+{
+    for (int k = 0; k < CHIP8_MEMORY_PAGES; k++)
+        TEST_CHECK(memcmp(chip8->memory + k * CHIP8_MEMORY_PAGE_SIZE, node->memory->pages[k]->data,
+                          CHIP8_MEMORY_PAGE_SIZE) == 0);
+    TEST_CHECK(memcmp(chip8->display, node->display->rows, sizeof(chip8->display)) == 0);
+    TEST_CHECK(memcmp(chip8->registers, node->registers, sizeof(chip8->registers)) == 0);
+    TEST_CHECK(chip8->index_register == node->index_register && chip8->pc == node->pc);
+    TEST_CHECK(chip8->cycles == node->cycles && chip8->rng == node->rng);
+    return 0;
+}
+
+// 保存时只复制 FX55 写过的页，其余页、页表（没有写时）和显示缓冲区在节点之间共享
+static int test_capture_shares_pages(void)
+{
+    CHIP8 *chip8 = chip8_init();
+    CHIP8_FORK_POOL *pool = chip8_fork_pool_create();
+    TEST_CHECK(chip8 != NULL && pool != NULL);
+    TEST_CHECK(chip8_load_buffer(chip8, test_program, sizeof(test_program)) == CHIP8_OK);
+
+    CHIP8_FORK *root = chip8_fork_capture(pool, chip8);
+    TEST_CHECK(root != NULL);
+    TEST_CHECK(chip8_fork_pool_pages(pool) == CHIP8_MEMORY_PAGES);
+
+    TEST_CHECK(chip8_emulate_cycles(chip8, 4) == 4);
+    TEST_CHECK(chip8->memory[0xE00] == 0x2A);
+    CHIP8_FORK *a = chip8_fork_capture(pool, chip8);
+    TEST_CHECK(a != NULL);
+    TEST_CHECK(chip8_fork_pool_pages(pool) == CHIP8_MEMORY_PAGES + 1);
+    for (int k = 0; k < CHIP8_MEMORY_PAGES; k++)
+        TEST_CHECK((a->memory->pages[k] == root->memory->pages[k]) == (k != TEST_PAGE));
+    TEST_CHECK(root->memory->pages[TEST_PAGE]->data[0] == 0 && a->memory->pages[TEST_PAGE]->data[0] == 0x2A);
+    TEST_CHECK(a->display == root->display);
+    TEST_CHECK(test_matches(chip8, a) == 0);
+
+    // 没有再写内存时保存，连页表一起共享
+    CHIP8_FORK *same = chip8_fork_capture(pool, chip8);
+    TEST_CHECK(same != NULL && same->memory == a->memory);
+    TEST_CHECK(chip8_fork_pool_pages(pool) == CHIP8_MEMORY_PAGES + 1);
+
+    // 复制节点只增加引用
+    CHIP8_FORK *copy = chip8_fork(pool, a);
+    TEST_CHECK(copy != NULL && copy->memory == a->memory && copy->display == a->display);
+    TEST_CHECK(chip8_fork_pool_pages(pool) == CHIP8_MEMORY_PAGES + 1);
+
+    // 装回根节点，写过的页恢复原样；再执行一次得到内容相同的另一份页
+    chip8_fork_restore(pool, root, chip8);
+    TEST_CHECK(test_matches(chip8, root) == 0);
+    TEST_CHECK(chip8->memory[0xE00] == 0);
+    TEST_CHECK(chip8_emulate_cycles(chip8, 4) == 4);
+    CHIP8_FORK *b = chip8_fork_capture(pool, chip8);
+    TEST_CHECK(b != NULL);
+    TEST_CHECK(chip8_fork_pool_pages(pool) == CHIP8_MEMORY_PAGES + 2);
+    TEST_CHECK(b->memory->pages[TEST_PAGE] != a->memory->pages[TEST_PAGE]);
+    TEST_CHECK(memcmp(b->memory->pages[TEST_PAGE]->data, a->memory->pages[TEST_PAGE]->data, CHIP8_MEMORY_PAGE_SIZE) == 0);
+    TEST_CHECK(b->memory->pages[0] == root->memory->pages[0]);
+
+    // a 的页在最后一个引用释放后回到池中
+    chip8_fork_release(pool, a);
+    chip8_fork_release(pool, same);
+    TEST_CHECK(chip8_fork_pool_pages(pool) == CHIP8_MEMORY_PAGES + 2);
+    chip8_fork_release(pool, copy);
+    TEST_CHECK(chip8_fork_pool_pages(pool) == CHIP8_MEMORY_PAGES + 1);
+
+    chip8_fork_release(pool, root);
+    chip8_fork_release(pool, b);
+    chip8_fork_pool_free(pool);
+    chip8_free(chip8);
+    return 0;
+}
+
+/**
+ * test_branches 从同一个节点分出多个分支，各按不同按键执行，再装回每个分支继续执行，
+ * 结果与从头逐条执行同样输入的独立实例一致。
+ *
+ * @param rom ROM 路径
+ * @param engine 工作实例使用的引擎
+ * @return 通过返回 0
+ */
+static int test_branches(const char *rom, enum chip8_engine engine)
+{
+    enum { BRANCHES = 4, FRAMES = 120 };
+    CHIP8 *work = test_load(rom);
+    CHIP8_FORK_POOL *pool = chip8_fork_pool_create();
+    TEST_CHECK(work != NULL && pool != NULL);
+    work->engine = engine;
+    chip8_emulate_cycles(work, FRAMES * CHIP8_CYCLES_PER_FRAME);
+    CHIP8_FORK *root = chip8_fork_capture(pool, work);
+    TEST_CHECK(root != NULL);
+
+    CHIP8_FORK *branch[BRANCHES];
+    for (int i = 0; i < BRANCHES; i++)
+    {
+        chip8_fork_restore(pool, root, work);
+        work->keys[4 + i] = 1;
+        chip8_emulate_cycles(work, FRAMES * CHIP8_CYCLES_PER_FRAME);
+        work->keys[4 + i] = 0;
+        branch[i] = chip8_fork_capture(pool, work);
+        TEST_CHECK(branch[i] != NULL);
+    }
+    // 不同的按键让分支真正分叉
+    TEST_CHECK(memcmp(branch[0]->display->rows, branch[1]->display->rows, sizeof(branch[0]->display->rows)) != 0);
+    for (int i = 0; i < BRANCHES; i++)
+    {
+        chip8_fork_restore(pool, branch[i], work);
+        TEST_CHECK(test_matches(work, branch[i]) == 0);
+        chip8_emulate_cycles(work, FRAMES * CHIP8_CYCLES_PER_FRAME);
+
+        CHIP8 *ref = test_load(rom);
+        TEST_CHECK(ref != NULL);
+        ref->engine = CHIP8_ENGINE_SWITCH;
+        ref->idle_skip = 0;
+        chip8_emulate_cycles(ref, FRAMES * CHIP8_CYCLES_PER_FRAME);
+        ref->keys[4 + i] = 1;
+        chip8_emulate_cycles(ref, FRAMES * CHIP8_CYCLES_PER_FRAME);
+        ref->keys[4 + i] = 0;
+        chip8_emulate_cycles(ref, FRAMES * CHIP8_CYCLES_PER_FRAME);
+        TEST_CHECK(memcmp(work->memory, ref->memory, sizeof(work->memory)) == 0);
+        TEST_CHECK(memcmp(work->display, ref->display, sizeof(work->display)) == 0);
+        TEST_CHECK(memcmp(work->registers, ref->registers, sizeof(work->registers)) == 0);
+        TEST_CHECK(work->pc == ref->pc && work->index_register == ref->index_register);
+        TEST_CHECK(work->cycles == ref->cycles && work->rng == ref->rng);
+        chip8_free(ref);
+    }
+
+    for (int i = 0; i < BRANCHES; i++)
+        chip8_fork_release(pool, branch[i]);
+    chip8_fork_release(pool, root);
+    chip8_fork_pool_free(pool);
+    chip8_free(work);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s rom\n", argv[0]);
+        return 2;
+    }
+    int failed = 0;
+    TEST_RUN(failed, test_capture_shares_pages());
+    TEST_RUN(failed, test_branches(argv[1], CHIP8_ENGINE_CACHE));
+    TEST_RUN(failed, test_branches(argv[1], CHIP8_ENGINE_JIT));
+    return failed ? 1 : 0;
+}
+/// ****************************************************************************** ///
@@ -0,0 +1,139 @@
+#include "snapshot.h"
+#include "test.h"
+#include <stdlib.h>
+
+/// ****************************快照与回退缓冲区测试****************************** ///
+// 用法：snapshot_test <rom>
+
+// 把 [0xA00, 0x1000) 清零后写入长度变化很大的伪随机内容，让关键帧和差分帧的大小参差不齐，
+// 大记录经常跟在小记录后面，数据区绕回时末尾剩余的空间放不下新记录
+static void test_scribble(CHIP8 *chip8, dword frame)
+{
+    word len = (word)((frame * 397) % 0x600);
+    memset(chip8->memory + 0xA00, 0, 0x600);
+    for (word i = 0; i < len; i++)
+        chip8->memory[0xA00 + i] = (byte)(frame * 131 + i * 7) | 1;
+    chip8_invalidate_code(chip8, 0xA00, 0x600);
+}
+
+// 快照恢复到另一个实例后继续执行，结果与原实例逐位一致；非法快照被拒绝
+static int test_round_trip(const char *rom)
+{
+    CHIP8 *a = test_load(rom);
+    CHIP8 *b = test_load(rom);
+    TEST_CHECK(a != NULL && b != NULL);
+    CHIP8_SNAPSHOT *saved = (CHIP8_SNAPSHOT *)malloc(3 * sizeof(CHIP8_SNAPSHOT));
+    TEST_CHECK(saved != NULL);
+
+    chip8_emulate_cycles(a, 50000);
+    chip8_snapshot(a, &saved[0]);
+    chip8_emulate_cycles(a, 50000);
+    chip8_snapshot(a, &saved[1]);
+
+    TEST_CHECK(chip8_restore(b, &saved[0]) == 0);
+    chip8_snapshot(b, &saved[2]);
+    TEST_CHECK(memcmp(&saved[0], &saved[2], sizeof(CHIP8_SNAPSHOT)) == 0);
+    chip8_emulate_cycles(b, 50000);
+    chip8_snapshot(b, &saved[2]);
+    TEST_CHECK(memcmp(&saved[1], &saved[2], sizeof(CHIP8_SNAPSHOT)) == 0);
+    TEST_CHECK(chip8_display_hash(a) == chip8_display_hash(b));
+
+    saved[2] = saved[0];
+    saved[2].version++;
+    TEST_CHECK(chip8_restore(b, &saved[2]) == -1);
+    saved[2] = saved[0];
+    saved[2].sp = 17;
+    TEST_CHECK(chip8_restore(b, &saved[2]) == -1);
+
+    free(saved);
+    chip8_free(a);
+    chip8_free(b);
+    return 0;
+}
+
+/**
+ * test_rewind 逐帧记录并不时回退，最后回退到最早保存的一帧，每次回退的结果都与当时的快照一致。
+ *
+ * @param rom ROM 路径
+ * @param capacity 回退缓冲区数据区字节数
+ * @param max_frames 最多保存的帧数
+ * @param interval 关键帧间隔
+ * @param frames 记录的帧数
+ * @param wraps 数据区至少要绕回的次数
+ * @return 通过返回 0
+ */
+static int test_rewind(const char *rom, size_t capacity, dword max_frames, dword interval, dword frames, dword wraps)
+{
+    CHIP8 *chip8 = test_load(rom);
+    TEST_CHECK(chip8 != NULL);
+    CHIP8_REWIND *rewind = chip8_rewind_create(capacity, max_frames, interval);
+    TEST_CHECK(rewind != NULL);
+    // history[0..len) 为按顺序记录的各帧，回退时从末尾弹出
+    CHIP8_SNAPSHOT *history = (CHIP8_SNAPSHOT *)malloc((frames + 1) * sizeof(CHIP8_SNAPSHOT));
+    TEST_CHECK(history != NULL);
+    dword len = 0;
+    size_t pushed = 0;
+
+    for (dword f = 0; f < frames; f++)
+    {
+        chip8_emulate_cycles(chip8, CHIP8_CYCLES_PER_FRAME);
+        test_scribble(chip8, f);
+        size_t before = chip8_rewind_bytes(rewind);
+        dword count = chip8_rewind_frames(rewind);
+        chip8_rewind_push(rewind, chip8);
+        chip8_snapshot(chip8, &history[len++]);
+        if (chip8_rewind_frames(rewind) == count + 1)
+            pushed += chip8_rewind_bytes(rewind) - before;
+        TEST_CHECK(chip8_rewind_bytes(rewind) <= capacity);
+        TEST_CHECK(chip8_rewind_frames(rewind) >= 1 && chip8_rewind_frames(rewind) <= max_frames);
+        // 每 5 帧回退一帧，之后的记录写在被回收的位置上
+        if (f % 5 == 4 && chip8_rewind_frames(rewind) >= 2)
+        {
+            TEST_CHECK(chip8_rewind_pop(rewind, chip8) == 0);
+            len--;
+            chip8_snapshot(chip8, &history[len]);
+            TEST_CHECK(memcmp(&history[len], &history[len - 1], sizeof(CHIP8_SNAPSHOT)) == 0);
+        }
+    }
+    // 数据区确实绕回了多次（只统计没有丢弃旧记录的那些帧，是下限）
+    TEST_CHECK(pushed > wraps * capacity);
+
+    // 保存的是最近的 n 帧，逐帧回退到最早的一帧
+    dword n = chip8_rewind_frames(rewind);
+    TEST_CHECK(n >= 1 && n <= len);
+    CHIP8_SNAPSHOT current;
+    for (dword i = n - 1; i > 0; i--)
+    {
+        TEST_CHECK(chip8_rewind_pop(rewind, chip8) == 0);
+        chip8_snapshot(chip8, &current);
+        TEST_CHECK(memcmp(&current, &history[len - n + i - 1], sizeof(CHIP8_SNAPSHOT)) == 0);
+    }
+    TEST_CHECK(chip8_rewind_pop(rewind, chip8) == -1);
+    TEST_CHECK(chip8_rewind_frames(rewind) == 1);
+
+    free(history);
+    chip8_rewind_free(rewind);
+    chip8_free(chip8);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s rom\n", argv[0]);
+        return 2;
+    }
+    const char *rom = argv[1];
+    size_t min_capacity = 2 * sizeof(CHIP8_SNAPSHOT) + 16;
+    int failed = 0;
+    TEST_RUN(failed, test_round_trip(rom));
+    // 最小的数据区只放得下一个关键帧和少量差分，每帧都要回收空间
+    TEST_RUN(failed, test_rewind(rom, min_capacity, 64, 1, 300, 3));
+    TEST_RUN(failed, test_rewind(rom, min_capacity, 64, 2, 300, 3));
+    TEST_RUN(failed, test_rewind(rom, min_capacity + 3000, 64, 4, 300, 3));
+    // 帧数先于数据区用完
+    TEST_RUN(failed, test_rewind(rom, 64 * 1024, 8, 3, 300, 0));
+    return failed ? 1 : 0;
+}
+/// ****************************************************************************** ///
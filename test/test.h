@@ -0,0 +1,44 @@
+#ifndef __TEST_H__
+#define __TEST_H__
+#include "chip8.h"
+#include <stdio.h>
+
+/// *********************************测试辅助************************************** ///
+// 每个测试程序由若干返回 0（通过）或 1（失败）的测试函数组成，main 依次运行并汇总，
+// 有失败时以非零状态退出，由 ctest 报告。
+
+// 条件不成立时输出位置并让当前测试函数失败
+#define TEST_CHECK(cond)                                                            \
+    do {                                                                            \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+// 运行一个测试函数，输出结果并累计失败数
+#define TEST_RUN(failed, call)                                                      \
+    do {                                                                            \
+        int test_result = (call);                                                   \
+        fprintf(stderr, "%-40s %s\n", #call, test_result ? "FAIL" : "ok");          \
+        (failed) += test_result;                                                    \
+    } while (0)
+
+// 创建装入 rom 的实例，种子固定，失败时返回 NULL
+static inline CHIP8 *test_load(const char *rom)
+{
+    CHIP8 *chip8 = chip8_init();
+    if (chip8 == NULL)
+        return NULL;
+    if (chip8_load_program(chip8, rom) != CHIP8_OK)
+    {
+        chip8_free(chip8);
+        return NULL;
+    }
+    chip8_seed(chip8, 1);
+    return chip8;
+}
+/// ****************************************************************************** ///
+
+#endif